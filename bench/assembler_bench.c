@@ -0,0 +1,163 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "arena.h"
+#include "lines.h"
+#include "binary_table.h"
+#include "pre_assembler.h"
+#include "first_pass.h"
+#include "second_pass.h"
+#include "utils.h"
+#include "error_handling.h"
+
+/*
+ * End-to-end benchmark of the assembler.
+ * Assembles each file with the same stages as assemble_file, timing the
+ * pre-assembler, first pass, second pass (encoding) and output writers
+ * separately, and prints one row per file with lines per second and the
+ * peak resident set size of the process.
+ * Usage: assembler_bench [--header] <file.as>...
+ */
+
+/* Seconds on the monotonic clock */
+static double now(void) {
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/* Peak resident set size of this process in kilobytes */
+static long peak_rss(void) {
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_maxrss;
+}
+
+/* Number of lines in a file, counting a last line without a newline */
+static long count_lines(const char *filename) {
+    FILE *file = fopen(filename, "r");
+    long lines = 0;
+    int previous = '\n';
+    int c;
+
+    if (file == NULL) {
+        return -1;
+    }
+    while ((c = getc(file)) != EOF) {
+        if (c == '\n') {
+            lines++;
+        }
+        previous = c;
+    }
+    if (previous != '\n') {
+        lines++;
+    }
+    fclose(file);
+    return lines;
+}
+
+static void print_header(void) {
+    printf("%-28s %9s %9s %9s %9s %9s %9s %12s %9s\n",
+           "file", "lines", "pre ms", "first ms", "second ms", "output ms", "total ms", "lines/s", "peak KB");
+}
+
+/* Assemble one file; returns 0 (NO_ERROR) or the status of the failing stage */
+static int bench_file(const char *filename) {
+    char *base_filename = remove_extension(filename);
+    long lines = count_lines(filename);
+    FirstPassResult pass;
+    BinaryTable table;
+    LineBuffer source;
+    Arena arena;
+    double start;
+    double pre_seconds;
+    double first_seconds;
+    double second_seconds;
+    double output_seconds;
+    double total;
+    int status;
+
+    if (base_filename == NULL || lines < 0) {
+        fprintf(stderr, "Cannot read %s\n", filename);
+        free(base_filename);
+        return ERR_FILE_ACCESS;
+    }
+    init_arena(&arena);
+    init_line_buffer(&source);
+
+    start = now();
+    status = pre_process(filename, &arena, &source, 0);
+    pre_seconds = now() - start;
+    if (status != NO_ERROR) {
+        fprintf(stderr, "%s: pre-assembler failed (error %d)\n", filename, status);
+        free_line_buffer(&source);
+        free_arena(&arena);
+        free(base_filename);
+        return status;
+    }
+
+    start = now();
+    pass = first_pass(&source, &arena);
+    first_seconds = now() - start;
+    free_line_buffer(&source);
+    status = pass.errorFlag;
+
+    if (status == NO_ERROR) {
+        if (!init_binary_table(&table)) {
+            status = ERR_MEMORY_ALLOCATION;
+        } else {
+            start = now();
+            status = encode_program(&pass.program, &pass.symbolTable, &table);
+            second_seconds = now() - start;
+
+            if (status == NO_ERROR) {
+                start = now();
+                write_output_files(&table, &pass.symbolTable, base_filename, 0);
+                output_seconds = now() - start;
+            }
+            free_binary_table(&table);
+        }
+    }
+
+    if (status == NO_ERROR) {
+        total = pre_seconds + first_seconds + second_seconds + output_seconds;
+        printf("%-28s %9ld %9.2f %9.2f %9.2f %9.2f %9.2f %12.0f %9ld\n",
+               filename, lines, pre_seconds * 1e3, first_seconds * 1e3, second_seconds * 1e3,
+               output_seconds * 1e3, total * 1e3, total > 0 ? lines / total : 0.0, peak_rss());
+    } else {
+        fprintf(stderr, "%s: assembly failed (error %d)\n", filename, status);
+    }
+
+    free_ir_program(&pass.program);
+    free_symbol_table(&pass.symbolTable);
+    free_arena(&arena);
+    free(base_filename);
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    int status = 0;
+    int i;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s [--header] <file.as>...\n", argv[0]);
+        return 1;
+    }
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--header") == 0) {
+            print_header();
+        } else if (bench_file(argv[i]) != NO_ERROR) {
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.h"
+#include "lines.h"
+#include "pre_assembler.h"
+
+/*
+ * Benchmark of comment and blank line stripping.
+ * Builds a comment-heavy source in memory (a large generated header before
+ * every block of code, as our generated sources have) and compares the former
+ * byte-by-byte filter with clean_buffer. Reports megabytes per second for each.
+ * Usage: clean_bench [block_count] [rounds]
+ */
+
+/* Lines of generated comment header before each block of code */
+#define HEADER_LINES 40
+
+/* Append a string to the synthetic source */
+static char *put(char *cursor, const char *text) {
+    size_t length = strlen(text);
+    memcpy(cursor, text, length);
+    return cursor + length;
+}
+
+/* Build block_count blocks of header comments, blank lines and indented code */
+static char *build_source(int block_count, size_t *length) {
+    static const char *header[] = {
+        ";;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;\n",
+        "; Generated file - do not edit. Regenerate with the table builder instead.\n",
+        ";   Section: dispatch tables, checksum 0x5f3759df, revision 1024\n",
+        "        ; indented note that follows the layout of the code below it\n",
+        "\t\t; tab indented note\n",
+        "\n",
+        "   \t   \n"
+    };
+    static const char *code[] = {
+        "MAIN: mov r3, LENGTH\n",
+        "        add #-5, r2\n",
+        "\tLOOP: cmp r1, #7\n",
+        "    jsr *r4\n",
+        "STR: .string \"abcdef\"\n",
+        "    stop\n"
+    };
+    size_t capacity = (size_t)block_count * (HEADER_LINES * 80 + 6 * 40) + 1;
+    char *source = malloc(capacity);
+    char *cursor = source;
+    int block;
+    int i;
+
+    if (source == NULL) {
+        return NULL;
+    }
+    for (block = 0; block < block_count; block++) {
+        for (i = 0; i < HEADER_LINES; i++) {
+            cursor = put(cursor, header[i % 7]);
+        }
+        for (i = 0; i < 6; i++) {
+            cursor = put(cursor, code[i]);
+        }
+    }
+    *length = (size_t)(cursor - source);
+    return source;
+}
+
+/* The former filter: bytes examined one at a time for the line end and the indent */
+static int legacy_clean(const char *source, size_t length, LineBuffer *output) {
+    const char *cursor = source;
+    const char *end = source + length;
+
+    while (cursor < end) {
+        const char *line = cursor;
+        int size;
+        int i = 0;
+
+        while (cursor < end && *cursor != '\n') {
+            cursor++;
+        }
+        if (cursor < end) {
+            cursor++;
+        }
+        size = (int)(cursor - line);
+        if (size > MAX_LINE_LENGTH - 1) {
+            size = MAX_LINE_LENGTH - 1;
+        }
+        while (i < size && (line[i] == ' ' || line[i] == '\t')) {
+            i++;
+        }
+        if ((i == size || (line[i] != ';' && line[i] != '\n')) && size > 2) {
+            if (!append_line_view(output, line + i, size - i)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Compare the lines kept by the two filters */
+static int same_lines(const LineBuffer *first, const LineBuffer *second) {
+    int i;
+
+    if (first->count != second->count) {
+        return 0;
+    }
+    for (i = 0; i < first->count; i++) {
+        if (strcmp(get_line(first, i), get_line(second, i)) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void report(const char *name, double seconds, double bytes, int lines) {
+    if (seconds <= 0) {
+        seconds = 1.0 / CLOCKS_PER_SEC;
+    }
+    printf("%-8s %10.3f s %10.1f MB/s %8d lines kept\n", name, seconds, bytes / seconds / 1e6, lines);
+}
+
+int main(int argc, char *argv[]) {
+    int block_count = argc > 1 ? atoi(argv[1]) : 20000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    LineBuffer legacy;
+    LineBuffer cleaned;
+    clock_t start;
+    double legacy_seconds;
+    double clean_seconds;
+    size_t length;
+    char *source;
+    int i;
+
+    if (block_count <= 0 || rounds <= 0) {
+        fprintf(stderr, "Usage: %s [block_count] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    source = build_source(block_count, &length);
+    if (source == NULL) {
+        return 1;
+    }
+
+    init_line_buffer(&legacy);
+    start = clock();
+    for (i = 0; i < rounds; i++) {
+        free_line_buffer(&legacy);
+        init_line_buffer(&legacy);
+        if (!legacy_clean(source, length, &legacy)) {
+            return 1;
+        }
+    }
+    legacy_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    init_line_buffer(&cleaned);
+    start = clock();
+    for (i = 0; i < rounds; i++) {
+        free_line_buffer(&cleaned);
+        init_line_buffer(&cleaned);
+        if (clean_buffer(source, length, &cleaned) != 0) {
+            return 1;
+        }
+    }
+    clean_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%lu bytes x %d rounds\n", (unsigned long)length, rounds);
+    report("bytewise", legacy_seconds, (double)length * rounds, legacy.count);
+    report("clean", clean_seconds, (double)length * rounds, cleaned.count);
+    printf("output %s\n", same_lines(&legacy, &cleaned) ? "identical" : "DIFFERS");
+
+    free_line_buffer(&legacy);
+    free_line_buffer(&cleaned);
+    free(source);
+    return 0;
+}
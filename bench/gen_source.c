@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Synthetic source generator for the benchmarks.
+ * Writes a valid .as program to standard output. Every label it references is
+ * defined or declared extern, operands use only the addressing modes their
+ * instruction allows, and the same options always produce the same program.
+ * Usage: gen_source [--lines=N] [--labels=N] [--macros=N] [--macro-body=N]
+ *                   [--externs=N] [--extern-ratio=P] [--entry-ratio=P]
+ *                   [--data-ratio=P] [--seed=N]
+ * Ratios are percentages: of direct operands that name an extern, of labels
+ * that are also declared .entry, and of statements that are .data or .string.
+ */
+
+/* Addressing modes, numbered as in the instruction word */
+#define MODE_IMMEDIATE 1
+#define MODE_DIRECT 2
+#define MODE_INDIRECT 4
+#define MODE_REGISTER 8
+#define MODE_ANY (MODE_IMMEDIATE | MODE_DIRECT | MODE_INDIRECT | MODE_REGISTER)
+#define MODE_WRITABLE (MODE_DIRECT | MODE_INDIRECT | MODE_REGISTER)
+#define MODE_JUMP (MODE_DIRECT | MODE_INDIRECT)
+
+/* One instruction and the addressing modes of its operands (0 if it has none) */
+typedef struct {
+    const char *name;
+    int source_modes;
+    int destination_modes;
+} Instruction;
+
+static const Instruction INSTRUCTIONS[] = {
+    {"mov", MODE_ANY, MODE_WRITABLE},
+    {"cmp", MODE_ANY, MODE_ANY},
+    {"add", MODE_ANY, MODE_WRITABLE},
+    {"sub", MODE_ANY, MODE_WRITABLE},
+    {"lea", MODE_DIRECT, MODE_WRITABLE},
+    {"clr", 0, MODE_WRITABLE},
+    {"not", 0, MODE_WRITABLE},
+    {"inc", 0, MODE_WRITABLE},
+    {"dec", 0, MODE_WRITABLE},
+    {"jmp", 0, MODE_JUMP},
+    {"bne", 0, MODE_JUMP},
+    {"red", 0, MODE_WRITABLE},
+    {"prn", 0, MODE_ANY},
+    {"jsr", 0, MODE_JUMP},
+    {"rts", 0, 0}
+};
+
+#define INSTRUCTION_COUNT (int)(sizeof(INSTRUCTIONS) / sizeof(INSTRUCTIONS[0]))
+
+/* Settings of one generated program */
+typedef struct {
+    long lines;          /* Approximate number of lines to write */
+    long labels;         /* Number of labels defined in the code */
+    int macros;          /* Number of macros defined and invoked */
+    int macro_body;      /* Number of lines in each macro body */
+    int externs;         /* Number of extern symbols declared */
+    int extern_ratio;    /* Percentage of direct operands naming an extern */
+    int entry_ratio;     /* Percentage of labels declared .entry */
+    int data_ratio;      /* Percentage of statements that are .data or .string */
+} Settings;
+
+/* Deterministic generator state, so programs do not depend on the C library's rand */
+static unsigned long seed = 1;
+
+static long next_random(long limit) {
+    seed = (seed * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+    return (long)((seed >> 8) % (unsigned long)limit);
+}
+
+/* Pick one of the modes set in a mask */
+static int pick_mode(int modes) {
+    int choices[4];
+    int count = 0;
+    int mode;
+
+    for (mode = MODE_IMMEDIATE; mode <= MODE_REGISTER; mode <<= 1) {
+        if (modes & mode) {
+            choices[count++] = mode;
+        }
+    }
+    return choices[next_random(count)];
+}
+
+/* Write one operand in the given mode */
+static void write_operand(const Settings *settings, int mode) {
+    switch (mode) {
+        case MODE_IMMEDIATE:
+            printf("#%ld", next_random(2001) - 1000);
+            break;
+        case MODE_DIRECT:
+            if (settings->externs > 0 && next_random(100) < settings->extern_ratio) {
+                printf("X%ld", next_random(settings->externs));
+            } else {
+                printf("L%ld", next_random(settings->labels));
+            }
+            break;
+        case MODE_INDIRECT:
+            printf("*r%ld", next_random(8));
+            break;
+        default:
+            printf("r%ld", next_random(8));
+            break;
+    }
+}
+
+/* Write a random instruction (without label or indentation) */
+static void write_instruction(const Settings *settings) {
+    const Instruction *instruction = &INSTRUCTIONS[next_random(INSTRUCTION_COUNT)];
+
+    printf("%s", instruction->name);
+    if (instruction->source_modes) {
+        putchar(' ');
+        write_operand(settings, pick_mode(instruction->source_modes));
+        putchar(',');
+    }
+    if (instruction->destination_modes) {
+        putchar(' ');
+        write_operand(settings, pick_mode(instruction->destination_modes));
+    }
+    putchar('\n');
+}
+
+/* Write a .data or .string directive */
+static void write_data(void) {
+    if (next_random(2)) {
+        long count = 1 + next_random(6);
+        long i;
+
+        printf(".data %ld", next_random(1001) - 500);
+        for (i = 1; i < count; i++) {
+            printf(", %ld", next_random(1001) - 500);
+        }
+        putchar('\n');
+    } else {
+        long length = 1 + next_random(20);
+        long i;
+
+        printf(".string \"");
+        for (i = 0; i < length; i++) {
+            putchar('a' + (int)next_random(26));
+        }
+        printf("\"\n");
+    }
+}
+
+/* Parse a --name=N option; returns 1 if arg is that option */
+static int numeric_option(const char *arg, const char *name, long *value) {
+    size_t length = strlen(name);
+
+    if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+        return 0;
+    }
+    *value = atol(arg + length + 1);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    Settings settings;
+    long statements;
+    long stride;
+    long label = 0;
+    long value;
+    long i;
+    int j;
+
+    settings.lines = 10000;
+    settings.labels = -1;
+    settings.macros = 20;
+    settings.macro_body = 4;
+    settings.externs = 8;
+    settings.extern_ratio = 10;
+    settings.entry_ratio = 5;
+    settings.data_ratio = 20;
+
+    for (j = 1; j < argc; j++) {
+        if (numeric_option(argv[j], "--lines", &value)) {
+            settings.lines = value;
+        } else if (numeric_option(argv[j], "--labels", &value)) {
+            settings.labels = value;
+        } else if (numeric_option(argv[j], "--macros", &value)) {
+            settings.macros = (int)value;
+        } else if (numeric_option(argv[j], "--macro-body", &value)) {
+            settings.macro_body = (int)value;
+        } else if (numeric_option(argv[j], "--externs", &value)) {
+            settings.externs = (int)value;
+        } else if (numeric_option(argv[j], "--extern-ratio", &value)) {
+            settings.extern_ratio = (int)value;
+        } else if (numeric_option(argv[j], "--entry-ratio", &value)) {
+            settings.entry_ratio = (int)value;
+        } else if (numeric_option(argv[j], "--data-ratio", &value)) {
+            settings.data_ratio = (int)value;
+        } else if (numeric_option(argv[j], "--seed", &value)) {
+            seed = (unsigned long)value;
+        } else {
+            fprintf(stderr, "Usage: %s [--lines=N] [--labels=N] [--macros=N] [--macro-body=N] "
+                    "[--externs=N] [--extern-ratio=P] [--entry-ratio=P] [--data-ratio=P] [--seed=N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    /* Whatever the declarations and macro definitions leave is spent on statements */
+    statements = settings.lines - settings.externs - (long)settings.macros * (settings.macro_body + 2) - 1;
+    if (settings.macros < 0 || settings.macro_body < 0 || settings.externs < 0) {
+        fprintf(stderr, "%s: counts must not be negative\n", argv[0]);
+        return 1;
+    }
+    if (statements < 1) {
+        statements = 1;
+    }
+    if (settings.labels < 0) {
+        settings.labels = statements / 10 + 1;
+    }
+    if (settings.labels < 1) {
+        settings.labels = 1;
+    }
+    if (settings.labels > statements) {
+        settings.labels = statements;
+    }
+    /* Entry declarations are part of the line budget too */
+    statements -= settings.labels * settings.entry_ratio / 100;
+    if (statements < settings.labels) {
+        statements = settings.labels;
+    }
+    stride = statements / settings.labels;
+
+    printf("; Generated by gen_source: %ld lines, %ld labels, %d macros of %d lines\n",
+           settings.lines, settings.labels, settings.macros, settings.macro_body);
+
+    for (j = 0; j < settings.externs; j++) {
+        printf(".extern X%d\n", j);
+    }
+
+    /* Macro bodies hold plain instructions; invocations are spread over the code */
+    for (j = 0; j < settings.macros; j++) {
+        int k;
+
+        printf("macr MC%d\n", j);
+        for (k = 0; k < settings.macro_body; k++) {
+            printf("    ");
+            write_instruction(&settings);
+        }
+        printf("endmacr\n");
+    }
+
+    for (i = 0; i < statements; i++) {
+        int labeled = label < settings.labels && i == label * stride;
+
+        /* Labels go on every stride-th statement until all are defined */
+        if (labeled) {
+            printf("L%ld: ", label++);
+        } else {
+            printf("    ");
+        }
+
+        /* A macro invocation must be alone on its line */
+        if (next_random(100) < settings.data_ratio) {
+            write_data();
+        } else if (!labeled && settings.macros > 0 && next_random(100) < 5) {
+            printf("MC%ld\n", next_random(settings.macros));
+        } else {
+            write_instruction(&settings);
+        }
+    }
+    printf("    stop\n");
+
+    for (i = 0; i < settings.labels; i++) {
+        if (next_random(100) < settings.entry_ratio) {
+            printf(".entry L%ld\n", i);
+        }
+    }
+
+    return 0;
+}
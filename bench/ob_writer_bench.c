@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "binary_table.h"
+
+/*
+ * Benchmark of the .ob writer.
+ * Compares the former per-word fprintf emitter with write_binary_table_to_file
+ * on a synthetic table and reports words per second for each.
+ * Usage: ob_writer_bench [word_count] [rounds]
+ */
+
+#define BENCH_FILE "ob_writer_bench.ob"
+
+/* The former conversion: octal digits accumulated into a decimal int */
+static int legacy_decimal_to_octal(int decimalNumber) {
+    int octalNumber = 0, placeValue = 1;
+
+    while (decimalNumber > 0) {
+        int remainder = decimalNumber % 8;
+        octalNumber += remainder * placeValue;
+        decimalNumber /= 8;
+        placeValue *= 10;
+    }
+
+    return octalNumber;
+}
+
+/* The former emitter: one fprintf per word */
+static int legacy_write(const BinaryTable *table, const char *filename) {
+    FILE *file = fopen(filename, "w");
+    int i;
+
+    if (file == NULL) {
+        return 0;
+    }
+    fprintf(file, "%d %d\n", table->size - table->data, table->data);
+    for (i = 0; i < table->size; i++) {
+        fprintf(file, "%04d %05d\n", table->words[i].address, legacy_decimal_to_octal(table->words[i].value));
+    }
+    fclose(file);
+    return 1;
+}
+
+/* Compare the two output files byte for byte */
+static int same_output(const char *first, const char *second) {
+    FILE *a = fopen(first, "r");
+    FILE *b = fopen(second, "r");
+    int ca;
+    int cb;
+    int same = (a != NULL && b != NULL);
+
+    while (same) {
+        ca = getc(a);
+        cb = getc(b);
+        if (ca != cb) {
+            same = 0;
+        } else if (ca == EOF) {
+            break;
+        }
+    }
+    if (a) {
+        fclose(a);
+    }
+    if (b) {
+        fclose(b);
+    }
+    return same;
+}
+
+static void report(const char *name, double seconds, long words) {
+    if (seconds <= 0) {
+        seconds = 1.0 / CLOCKS_PER_SEC;
+    }
+    printf("%-8s %10.3f s %14.0f words/s\n", name, seconds, words / seconds);
+}
+
+int main(int argc, char *argv[]) {
+    int word_count = argc > 1 ? atoi(argv[1]) : 1000000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    BinaryTable table;
+    clock_t start;
+    double legacy_seconds;
+    double table_seconds;
+    int i;
+
+    if (word_count <= 0 || rounds <= 0) {
+        fprintf(stderr, "Usage: %s [word_count] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    /* Addresses wrap inside the 4096-word memory; values cover all 15 bits */
+    if (!init_binary_table(&table)) {
+        return 1;
+    }
+    for (i = 0; i < word_count; i++) {
+        if (!add_binary_word(&table, 100 + i % 3996, (unsigned short)((i * 2654435761UL) >> 7))) {
+            return 1;
+        }
+    }
+    table.data = word_count / 4;
+
+    start = clock();
+    for (i = 0; i < rounds; i++) {
+        legacy_write(&table, BENCH_FILE ".legacy");
+    }
+    legacy_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (i = 0; i < rounds; i++) {
+        write_binary_table_to_file(&table, BENCH_FILE, 100, table.data);
+    }
+    table_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%d words x %d rounds\n", word_count, rounds);
+    report("fprintf", legacy_seconds, (long)word_count * rounds);
+    report("table", table_seconds, (long)word_count * rounds);
+    printf("output %s\n", same_output(BENCH_FILE ".legacy", BENCH_FILE) ? "identical" : "DIFFERS");
+
+    remove(BENCH_FILE ".legacy");
+    remove(BENCH_FILE);
+    free_binary_table(&table);
+    return 0;
+}
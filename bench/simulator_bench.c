@@ -0,0 +1,116 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "assembler.h"
+#include "simulator.h"
+
+/*
+ * Benchmark of the simulator.
+ * Assembles a program of nested loops that mixes register, memory, immediate
+ * and indirect operands, subroutine calls and branches, runs it to its stop
+ * the given number of times and reports simulated instructions per second.
+ * Usage: simulator_bench [outer_iterations] [rounds]
+ */
+
+/* The outer loop count is patched into the first line */
+static const char *PROGRAM =
+    "MAIN: mov #%d, r1\n"
+    "OUTER: mov #1000, r2\n"
+    "lea SUM, r4\n"
+    "INNER: add r2, r3\n"
+    "mov r3, *r4\n"
+    "inc COUNT\n"
+    "dec r2\n"
+    "cmp r2, #0\n"
+    "bne INNER\n"
+    "jsr STEP\n"
+    "cmp r1, #0\n"
+    "bne OUTER\n"
+    "stop\n"
+    "STEP: sub #1, r1\n"
+    "not r5\n"
+    "rts\n"
+    "SUM: .data 0\n"
+    "COUNT: .data 0\n";
+
+/* Seconds on the monotonic clock */
+static double now(void) {
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    int outer = argc > 1 ? atoi(argv[1]) : 1000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    char source[1024];
+    AssemblyResult result;
+    ObjectModule program;
+    Machine *machine;
+    unsigned long steps = 0;
+    double best = 0;
+    int status = 0;
+    int i;
+
+    if (outer <= 0 || outer > 2047 || rounds <= 0) {
+        printf("Usage: %s [outer_iterations (1-2047)] [rounds]\n", argv[0]);
+        return 1;
+    }
+    sprintf(source, PROGRAM, outer);
+    if (assemble_buffer(source, strlen(source), &result) != NO_ERROR) {
+        flush_diagnostics(&result.diagnostics);
+        free_assembly_result(&result);
+        return 1;
+    }
+
+    /* The simulator loads modules; this one lives in the assembly result */
+    memset(&program, 0, sizeof(program));
+    program.base = result.image.words[0].address;
+    program.instruction_count = result.instruction_count;
+    program.data_count = result.data_count;
+    program.words = malloc(sizeof(unsigned short) * result.image.size);
+    machine = malloc(sizeof(Machine));
+    if (program.words == NULL || machine == NULL) {
+        printf("Out of memory\n");
+        free(program.words);
+        free(machine);
+        free_assembly_result(&result);
+        return 1;
+    }
+    for (i = 0; i < result.image.size; i++) {
+        program.words[i] = (unsigned short)result.image.words[i].value;
+    }
+
+    for (i = 0; i < rounds && status == 0; i++) {
+        double start;
+        double seconds;
+
+        if (load_machine(machine, &program, stdin, stdout) != NO_ERROR) {
+            status = 1;
+            break;
+        }
+        start = now();
+        if (run_machine(machine, 0) != SIMULATOR_HALTED) {
+            printf("Fault: %s at %04d\n", machine->fault, machine->fault_address);
+            status = 1;
+        }
+        seconds = now() - start;
+        if (i == 0 || seconds < best) {
+            best = seconds;
+        }
+        steps = machine->steps;
+    }
+
+    if (status == 0) {
+        printf("%lu instructions per run, best of %d: %.3f ms, %.1f million instructions/s\n",
+               steps, rounds, best * 1000, best > 0 ? steps / best / 1e6 : 0.0);
+    }
+    free(program.words);
+    free(machine);
+    free_assembly_result(&result);
+    return status;
+}
@@ -0,0 +1,67 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * @file arena.h
+ * Bump-pointer arena owning the objects created while assembling one file.
+ * Objects are never freed one by one; the whole arena is released at once.
+ */
+
+/*
+ * @struct ArenaBlock
+ * A chunk of arena memory. The usable bytes follow the header.
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;  /* Previously filled block */
+    size_t size;              /* Number of usable bytes in the block */
+    size_t used;              /* Number of bytes handed out so far */
+} ArenaBlock;
+
+/*
+ * @struct Arena
+ * A chain of blocks; allocations are served from the newest one.
+ * Each new block is at least twice the size of the previous one.
+ */
+typedef struct {
+    ArenaBlock *head;         /* Block currently being filled */
+} Arena;
+
+/*
+ * Initializes an empty arena. No memory is allocated until the first request.
+ * arena - Pointer to the arena to initialize.
+ */
+void init_arena(Arena *arena);
+
+/*
+ * Allocates suitably aligned memory from the arena.
+ * arena - Pointer to the arena.
+ * size - Number of bytes to allocate.
+ * Returns a pointer to the memory, or NULL if allocation fails.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/*
+ * Copies a string of the given length into the arena and terminates it.
+ * arena - Pointer to the arena.
+ * str - The characters to copy.
+ * length - Number of characters to copy.
+ * Returns a pointer to the copy, or NULL if allocation fails.
+ */
+char *arena_strndup(Arena *arena, const char *str, int length);
+
+/*
+ * Releases everything allocated from the arena except its largest block,
+ * which is kept for the next file assembled with the same arena.
+ * arena - Pointer to the arena to reset.
+ */
+void reset_arena(Arena *arena);
+
+/*
+ * Releases all memory owned by the arena.
+ * arena - Pointer to the arena to free.
+ */
+void free_arena(Arena *arena);
+
+#endif /* ARENA_H */
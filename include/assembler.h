@@ -0,0 +1,102 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <stddef.h>
+#include "arena.h"
+#include "binary_table.h"
+#include "error_handling.h"
+
+/*
+ * @file assembler.h
+ * Assembles source through all stages of the assembler, either from a file
+ * to output files or from a buffer to memory (the libassembler API).
+ */
+
+/*
+ * Version recorded in build cache manifests. Bump it whenever the output for
+ * a given source can change, so cached outputs of older versions are not reused.
+ */
+#define ASSEMBLER_VERSION "1.19"
+
+/*
+ * @struct AssemblyOptions
+ * Switches that select how files are assembled.
+ */
+typedef struct {
+    int write_am;                  /* Also write the expanded source to a .am file */
+    int single_pass;               /* Encode while reading and backpatch, instead of two passes */
+    int binary_object;             /* Also write a binary object (.obj) next to the .ob */
+    int pass_threads;              /* Threads for the first pass of a large source (1 = serial) */
+    const char *cache_directory;   /* Build cache directory for batch runs, or NULL for none */
+} AssemblyOptions;
+
+/*
+ * @struct AssembledSymbol
+ * A name and an address reported in the assembly result.
+ */
+typedef struct {
+    const char *name;              /* Symbol name, owned by the result's arena */
+    int address;                   /* Entry address, or the address referencing an extern */
+} AssembledSymbol;
+
+/*
+ * @struct AssemblyResult
+ * Context of one in-memory assembly and everything it produced.
+ * The words, entries and externs hold the same information as the
+ * .ob, .ent and .ext files, in the same order.
+ */
+typedef struct {
+    int status;                    /* 0 (NO_ERROR) on success, an error code on failure */
+    int instruction_count;         /* Number of instruction words */
+    int data_count;                /* Number of data words */
+    BinaryTable image;             /* Object words: instructions first, then data */
+    AssembledSymbol *entries;      /* Entry symbols in definition order */
+    int entry_count;               /* Number of entries */
+    AssembledSymbol *externs;      /* Extern references, as listed in the .ext file */
+    int extern_count;              /* Number of extern references */
+    DiagnosticBuffer diagnostics;  /* Messages reported while assembling */
+    Arena arena;                   /* Owns the names and symbol data */
+} AssemblyResult;
+
+/*
+ * Runs the pre-assembler, first pass and second pass on one file and writes its output files.
+ * Everything the file allocates is released before returning, except the arena,
+ * which the caller may reset and reuse for the next file.
+ * input_filename - The assembly file, with or without the .as extension.
+ * arena - Arena for the macros, symbols and extern references of this file.
+ * options - How to assemble the file.
+ * Returns 0 (NO_ERROR) on success, an error code on failure.
+ */
+int assemble_file(const char *input_filename, Arena *arena, const AssemblyOptions *options);
+
+/*
+ * Assembles source held in memory. No files are read or written, and
+ * nothing is printed: messages are collected in the result's diagnostics
+ * and can be printed with flush_diagnostics.
+ * source - The assembly source text (need not be null-terminated).
+ * length - Number of characters in the source.
+ * result - Receives the output; release it with free_assembly_result.
+ * Returns result->status.
+ */
+int assemble_buffer(const char *source, size_t length, AssemblyResult *result);
+
+/*
+ * Assembles source held in memory into a result that was already filled by
+ * assemble_buffer. The previous output is discarded, but the memory behind it
+ * (arena, object words and diagnostics) is kept and reused, which saves the
+ * allocations when many small sources are assembled one after another.
+ * source - The assembly source text (need not be null-terminated).
+ * length - Number of characters in the source.
+ * name - Name of the source file for messages, or NULL if it has none.
+ * result - A result filled by assemble_buffer, not yet freed.
+ * Returns result->status.
+ */
+int reassemble_buffer(const char *source, size_t length, const char *name, AssemblyResult *result);
+
+/*
+ * Releases everything owned by an assembly result.
+ * result - Pointer to the result to free.
+ */
+void free_assembly_result(AssemblyResult *result);
+
+#endif /* ASSEMBLER_H */
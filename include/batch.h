@@ -0,0 +1,29 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "assembler.h"
+
+/*
+ * @file batch.h
+ * Assembles several source files on a pool of worker threads.
+ */
+
+/*
+ * Returns the number of worker threads to use by default (one per online core).
+ */
+int default_job_count(void);
+
+/*
+ * Assembles every file in the list. With more than one worker, files are
+ * scheduled largest first; the diagnostics of each file are buffered and
+ * printed (sorted, see flush_diagnostics) in the order the files were given,
+ * so the output does not depend on scheduling.
+ * filenames - The assembly files to assemble.
+ * count - Number of files in the list.
+ * jobs - Maximum number of worker threads.
+ * options - How to assemble each file.
+ * Returns 0 if every file assembled, otherwise the status of the first file that failed.
+ */
+int assemble_files(char *const *filenames, int count, int jobs, const AssemblyOptions *options);
+
+#endif /* BATCH_H */
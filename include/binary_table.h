@@ -3,24 +3,13 @@
 
 #include "line_parser.h"
 #include "symbol_table.h"
+#include "ir.h"
 
 /* 
  * @file binary_table.h
  * Declarations for managing the binary table in the assembler.
  */
 
-/* 
- * Structure to represent a binary instruction with opcode, addressing modes, registers, and ARE value.
- */
-typedef struct {
-    unsigned int opcode : 4;           /* Operation code */
-    unsigned int source_addressing : 2; /* Source operand addressing mode */
-    unsigned int target_addressing : 2; /* Target operand addressing mode */
-    unsigned int source_register : 3;   /* Source register number */
-    unsigned int target_register : 3;   /* Target register number */
-    unsigned int are : 2;               /* ARE value (absolute, relocatable, external) */
-} BinaryInstruction;
-
 /* 
  * Structure to represent a binary word in memory with an address and a 15-bit value.
  */
@@ -42,8 +31,9 @@ typedef struct {
 /* 
  * Initializes a binary table with default size and values.
  * table - Pointer to the binary table to be initialized.
+ * Returns 1 on success, 0 if allocation fails.
  */
-void init_binary_table(BinaryTable *table);
+int init_binary_table(BinaryTable *table);
 
 /* 
  * Adds a binary word to the binary table.
@@ -54,8 +44,36 @@ void init_binary_table(BinaryTable *table);
  */
 int add_binary_word(BinaryTable *table, int address, unsigned short value);
 
+/* Length of an object file line: four address digits, a space, five octal digits and a newline */
+#define OBJECT_LINE_LENGTH 11
+
+/* Upper bound on an object file line, for addresses of any width */
+#define OBJECT_LINE_MAX 24
+
+/* Upper bound on the object file header line */
+#define OBJECT_HEADER_LENGTH 32
+
+/* 
+ * Formats one object file line ("%04d %05o\n") using digit lookup tables.
+ * The output is not null-terminated.
+ * out - Buffer with room for OBJECT_LINE_MAX characters.
+ * address - Memory address of the word.
+ * value - 15-bit value of the word.
+ * Returns the number of characters written.
+ */
+int format_object_line(char *out, int address, unsigned short value);
+
+/* 
+ * Renders the object file contents of a binary table: the header line, then one line per word.
+ * table - Pointer to the binary table.
+ * length - Receives the number of characters rendered.
+ * Returns the rendered text (not null-terminated; release it with free), or NULL if allocation fails.
+ */
+char *format_binary_table(const BinaryTable *table, size_t *length);
+
 /* 
  * Writes the binary table to a file.
+ * The whole file is rendered into one buffer and written with a single write call.
  * table - Pointer to the binary table.
  * filename - Name of the output file.
  * ic - Instruction counter value.
@@ -70,20 +88,6 @@ int write_binary_table_to_file(const BinaryTable *table, const char *filename, i
  */
 void free_binary_table(BinaryTable *table);
 
-/* 
- * Retrieves the addressing mode of a given operand.
- * operand - Pointer to the operand.
- * Returns the addressing mode as an integer.
- */
-int get_addressing_mode(const Operand *operand);
-
-/* 
- * Converts a binary instruction to an integer representation.
- * instruction - Binary instruction to be converted.
- * Returns the integer representation of the binary instruction.
- */
-int binary_instruction_to_int(BinaryInstruction instruction);
-
 /* 
  * Processes an immediate value in assembly code.
  * value - String representation of the immediate value.
@@ -98,21 +102,5 @@ int process_immediate_value(const char *value);
  */
 int get_register_number(const char *value);
 
-/* 
- * Assembles an instruction from the parsed assembly line and symbol table.
- * line - Pointer to the assembly line structure.
- * symbol_table - Pointer to the symbol table.
- * Returns the assembled binary instruction as an unsigned short.
- */
-unsigned short assemble_instruction(const AssemblyLine *line, Symbol *symbol_table);
-
-/* 
- * Retrieves the ARE value for a given assembly line.
- * line - Pointer to the assembly line structure.
- * symbol_table - Pointer to the symbol table.
- * Returns the ARE value as an integer.
- */
-int get_are_value(const AssemblyLine *line, Symbol *symbol_table);
-
 #endif /* BINARY_TABLE_H */
 
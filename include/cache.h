@@ -0,0 +1,89 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <pthread.h>
+
+/*
+ * @file cache.h
+ * Incremental build cache. A manifest in the cache directory records, for each
+ * source that assembled cleanly, a hash of its contents, the assembler version
+ * and a hash of every output file it produced. A source whose contents and
+ * version match, and whose outputs are still there unchanged, need not be
+ * assembled again.
+ */
+
+/* Characters in a hash written as text, including the terminator */
+#define CACHE_HASH_TEXT 17
+
+/* Output files recorded per source: .ob, .ent and .ext */
+#define CACHE_OUTPUTS 3
+
+/* Cache directory used by --cache */
+#define DEFAULT_CACHE_DIRECTORY ".assembler-cache"
+
+/* Name of the manifest inside the cache directory */
+#define CACHE_MANIFEST "manifest"
+
+/*
+ * @struct CacheEntry
+ * What the manifest records about one source.
+ */
+typedef struct {
+    char *source;                                   /* Path of the source as given */
+    unsigned long hash;                             /* Hash of the path, cached for lookups */
+    char source_hash[CACHE_HASH_TEXT];              /* Hash of the source contents */
+    char output_hashes[CACHE_OUTPUTS][CACHE_HASH_TEXT]; /* Hash of each output, "-" if not produced */
+} CacheEntry;
+
+/*
+ * @struct BuildCache
+ * The manifest of a cache directory, shared by the batch workers.
+ */
+typedef struct {
+    char *directory;               /* The cache directory */
+    CacheEntry *entries;           /* Entries of the current assembler version */
+    int count;                     /* Number of entries */
+    int capacity;                  /* Number of entries allocated */
+    int *slots;                    /* Hash index of the entries: index + 1, or 0 if free (linear probing) */
+    int slot_capacity;             /* Number of slots, always a power of two */
+    int hits;                      /* Sources found up to date */
+    int misses;                    /* Sources that had to be assembled */
+    int dirty;                     /* Set when the manifest must be saved */
+    pthread_mutex_t lock;          /* Guards the entries and counters */
+} BuildCache;
+
+/*
+ * Opens a cache directory, creating it if needed, and loads its manifest.
+ * Entries written by another assembler version are dropped.
+ * cache - The cache to initialize; on failure nothing needs to be released.
+ * directory - The cache directory.
+ * Returns 0 (NO_ERROR) on success, ERR_FILE_ACCESS or ERR_MEMORY_ALLOCATION on failure.
+ */
+int open_build_cache(BuildCache *cache, const char *directory);
+
+/*
+ * Checks whether a source is up to date and counts a hit or a miss.
+ * cache - The cache.
+ * filename - The assembly file, with or without the .as extension.
+ * source_hash - Receives the hash of the source contents (CACHE_HASH_TEXT
+ *               characters), to be passed to record_build_cache after a miss.
+ * Returns 1 if the source and its outputs match the manifest, 0 otherwise.
+ */
+int check_build_cache(BuildCache *cache, const char *filename, char *source_hash);
+
+/*
+ * Records the outputs of a source that was just assembled without errors.
+ * cache - The cache.
+ * filename - The assembly file, with or without the .as extension.
+ * source_hash - Hash of the contents that were assembled, from check_build_cache.
+ */
+void record_build_cache(BuildCache *cache, const char *filename, const char *source_hash);
+
+/*
+ * Saves the manifest if it changed and releases the cache.
+ * cache - The cache.
+ * Returns 0 (NO_ERROR) on success, ERR_FILE_ACCESS if the manifest could not be saved.
+ */
+int close_build_cache(BuildCache *cache);
+
+#endif /* CACHE_H */
@@ -1,6 +1,9 @@
 #ifndef ERROR_HANDLING_H
 #define ERROR_HANDLING_H
 
+#include <stdio.h>
+#include <stddef.h>
+
 /*
  * @file error_handling.h
  * Error codes and functions for handling errors in the assembler.
@@ -34,11 +37,104 @@ typedef enum {
     ERR_SYMBOL_SHORT,          /* Symbol name is too short */
     ERR_SYMBOL_NOT_FOUND,      /* Symbol not found in symbol table */
     ERR_INVALID_OPERAND,       /* Invalid operand provided */
-    ERR_PROCESSING_FAILED      /* General error during processing */
+    ERR_PROCESSING_FAILED,     /* General error during processing */
+    ERR_LINE_TOO_LONG          /* Source line longer than the maximum line length */
 } ErrorCode;
 
 /* 
- * Reports an error with a specific error code and line number.
+ * @enum DiagnosticFormat
+ * How flush_diagnostics prints diagnostics.
+ */
+typedef enum {
+    DIAGNOSTICS_TEXT = 0,      /* file:line:column: error: message */
+    DIAGNOSTICS_JSON           /* One JSON object per line */
+} DiagnosticFormat;
+
+/* 
+ * @struct DiagnosticBuffer
+ * Messages captured for one input file, kept in the order they were reported.
+ * Each message is stored as a tag followed by its null-terminated text. Plain
+ * messages are tagged with their stream; diagnostics (errors and warnings about
+ * the source) are tagged as such and hold their severity, code, line, column,
+ * file and message.
+ */
+typedef struct {
+    char *text;          /* Tagged messages, back to back */
+    size_t length;       /* Number of bytes in use */
+    size_t capacity;     /* Number of bytes allocated */
+} DiagnosticBuffer;
+
+/* 
+ * Initializes an empty diagnostic buffer.
+ * buffer - Pointer to the buffer to initialize.
+ */
+void init_diagnostic_buffer(DiagnosticBuffer *buffer);
+
+/* 
+ * Routes the messages reported by the calling thread into a buffer.
+ * buffer - The buffer that receives the messages, or NULL to print them directly.
+ * Returns the buffer that was capturing before, so it can be restored.
+ */
+DiagnosticBuffer *capture_diagnostics(DiagnosticBuffer *buffer);
+
+/* 
+ * Selects how diagnostics are printed. Call before any worker thread is started.
+ * format - Text or JSON lines.
+ * max_errors - Errors printed per flush before the rest are cut off, 0 for no limit.
+ */
+void configure_diagnostics(DiagnosticFormat format, int max_errors);
+
+/* 
+ * Names the file that the calling thread's diagnostics refer to.
+ * name - The file name, or NULL for none; must stay valid until it is replaced.
+ * Returns the name that was set before, so it can be restored.
+ */
+const char *set_diagnostic_source(const char *name);
+
+/* 
+ * Prints the captured diagnostics on stderr, sorted by file, line and column,
+ * without duplicates and cut off after the configured number of errors; then
+ * prints the plain messages to the streams they were reported on, in order,
+ * and empties the buffer.
+ * buffer - Pointer to the buffer to flush.
+ */
+void flush_diagnostics(DiagnosticBuffer *buffer);
+
+/* 
+ * Frees the memory used by a diagnostic buffer.
+ * buffer - Pointer to the buffer to free.
+ */
+void free_diagnostic_buffer(DiagnosticBuffer *buffer);
+
+/* 
+ * Reports a message on stdout or stderr, or captures it if the calling
+ * thread is capturing diagnostics. Takes the same arguments as fprintf.
+ * stream - stdout or stderr.
+ * format - printf-style format string.
+ */
+void report_message(FILE *stream, const char *format, ...);
+
+/* 
+ * Reports an error in the source being assembled. It is captured if the
+ * calling thread is capturing diagnostics, and printed at once otherwise.
+ * error - The error code to report.
+ * line_number - The line number where the error occurred, 0 if it has none.
+ * column - The column (from 1) where the error occurred, 0 if unknown.
+ * format - printf-style format string of the message, without a newline.
+ */
+void report_diagnostic(ErrorCode error, int line_number, int column, const char *format, ...);
+
+/* 
+ * Reports a warning about the source being assembled, like report_diagnostic.
+ * line_number - The line number the warning is about, 0 if it has none.
+ * column - The column (from 1) the warning is about, 0 if unknown.
+ * format - printf-style format string of the message, without a newline.
+ */
+void report_warning(int line_number, int column, const char *format, ...);
+
+/* 
+ * Reports an error with a specific error code and line number,
+ * with the standard message of the code.
  * error - The error code to report.
  * line_number - The line number where the error occurred.
  */
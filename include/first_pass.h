@@ -3,6 +3,8 @@
 
 #include "symbol_table.h"
 #include "line_parser.h"
+#include "lines.h"
+#include "ir.h"
 
 /*
  * @file first_pass.h
@@ -21,20 +23,48 @@ typedef struct {
 /*
  * @struct FirstPassResult
  * Holds the result of the first pass, including the symbol table,
- * memory counters, and error flag.
+ * memory counters, error flag, and the parsed program.
  */
 typedef struct {
-    Symbol *symbolTable;      /* Pointer to the symbol table */
+    SymbolTable symbolTable;  /* The symbol table */
     MemoryCounters memoryCounters; /* Memory counters (IC and DC) */
     int errorFlag;            /* Flag indicating if any errors occurred during the first pass */
+    IrProgram program;        /* Parsed lines consumed by the second pass */
 } FirstPassResult;
 
 /*
- * Executes the first pass of the assembler on the given source file.
- * filename - Name of the source file to process.
+ * Executes the first pass of the assembler on the expanded source.
+ * A line with an error is reported and skipped; only a failed allocation
+ * stops the pass. The error flag holds the error of the first bad line.
+ * source - The macro-expanded source lines produced by pre_process.
+ * arena - Arena that owns the symbols of this assembly.
  * Returns a FirstPassResult structure containing the result of the first pass.
  */
-FirstPassResult first_pass(const char* filename);
+FirstPassResult first_pass(const LineBuffer *source, Arena *arena);
+
+/*
+ * Prepares an empty first pass result: counters, symbol table and IR.
+ * result - The result to initialize.
+ * arena - Arena that owns the symbols of this assembly.
+ */
+void begin_first_pass(FirstPassResult *result, Arena *arena);
+
+/*
+ * Parses one source line and adds it to the symbol table and IR.
+ * result - The first pass result being built.
+ * line - The source line.
+ * line_number - The number of the source line the line came from.
+ * parse_error - Set to 1 if the line has a syntax error; processing may continue.
+ * Returns 0 (NO_ERROR) if successful, otherwise the error of the line, already reported.
+ */
+int first_pass_line(FirstPassResult *result, const char *line, int line_number, int *parse_error);
+
+/*
+ * Finishes the first pass: moves data symbols after the code and sets the error flag.
+ * result - The first pass result being built.
+ * parse_error - Non-zero if any line had a syntax error.
+ */
+void end_first_pass(FirstPassResult *result, int parse_error);
 
 /*
  * Processes a single line during the first pass.
@@ -42,20 +72,22 @@ FirstPassResult first_pass(const char* filename);
  * ic - Pointer to the instruction counter.
  * dc - Pointer to the data counter.
  * symbol_table - Pointer to the symbol table.
+ * program - The IR program that receives the parsed line.
  * line_number - The current line number in the source file.
- * Returns 1 if successful, 0 if an error occurred.
+ * Returns 0 (NO_ERROR) if successful, an error code otherwise.
  */
-int process_line_first_pass(const AssemblyLine *line, int *ic, int *dc, Symbol **symbol_table, int line_number);
+int process_line_first_pass(const AssemblyLine *line, int *ic, int *dc, SymbolTable *symbol_table, IrProgram *program, int line_number);
 
 /*
  * Handles a directive (e.g., .data, .string) during the first pass.
  * line - Pointer to the parsed assembly line.
  * dc - Pointer to the data counter.
  * symbol_table - Pointer to the symbol table.
+ * program - The IR program that receives data and entry lines.
  * line_number - The current line number in the source file.
- * Returns 1 if successful, 0 if an error occurred.
+ * Returns 0 (NO_ERROR) if successful, an error code otherwise.
  */
-int handle_directive_first_pass(const AssemblyLine *line, int *dc, Symbol **symbol_table, int line_number);
+int handle_directive_first_pass(const AssemblyLine *line, int *dc, SymbolTable *symbol_table, IrProgram *program, int line_number);
 
 /*
  * Handles a label during the first pass.
@@ -66,22 +98,24 @@ int handle_directive_first_pass(const AssemblyLine *line, int *dc, Symbol **symb
  * symbol_table - Pointer to the symbol table.
  * Returns 1 if successful, 0 if an error occurred.
  */
-int handle_label_first_pass(const char* label, int address, int is_data_line, int line, Symbol** symbol_table);
+int handle_label_first_pass(const char* label, int address, int is_data_line, int line, SymbolTable *symbol_table);
 
 /*
  * Handles an instruction during the first pass.
  * line - Pointer to the parsed assembly line.
  * ic - Pointer to the instruction counter.
- * Returns 1 if successful, 0 if an error occurred.
+ * program - The IR program that receives the instruction.
+ * line_number - The current line number in the source file.
+ * Returns 0 (NO_ERROR) if successful, an error code otherwise.
  */
-int handle_instruction_first_pass(const AssemblyLine *line, int *ic);
+int handle_instruction_first_pass(const AssemblyLine *line, int *ic, IrProgram *program, int line_number);
 
 /*
  * Updates the addresses of all data symbols after the first pass.
  * symbol_table - Pointer to the symbol table.
  * ic - The final instruction counter value after the first pass.
  */
-void update_data_symbols(Symbol *symbol_table, int ic);
+void update_data_symbols(SymbolTable *symbol_table, int ic);
 
 /*
  * Counts the number of data values in a .data directive string.
@@ -97,7 +131,7 @@ int count_data_values(const char *data_string);
  * line_number - The current line number in the source file.
  * Returns 1 if successful, 0 if an error occurred.
  */
-int handle_extern_directive(const AssemblyLine *line, Symbol **symbol_table, int line_number);
+int handle_extern_directive(const AssemblyLine *line, SymbolTable *symbol_table, int line_number);
 
 #endif /* FIRST_PASS_H */
 
@@ -0,0 +1,75 @@
+#ifndef INSTRUCTION_TABLE_H
+#define INSTRUCTION_TABLE_H
+
+#include "ir.h"
+
+/*
+ * @file instruction_table.h
+ * The forms of every instruction, indexed by opcode and by the addressing
+ * modes of its source and destination: whether the opcode accepts them, how
+ * many words the instruction takes and the routine that encodes it.
+ * The first pass sizes instructions with it and both encoders (second_pass
+ * and single_pass) encode with it, so the addresses given out in the first
+ * pass always match the words written.
+ */
+
+/* Number of opcodes */
+#define OPCODE_COUNT 16
+
+/* Operand slots of the table: no operand, then one per OperandType */
+#define OPERAND_SLOTS 5
+#define OPERAND_SLOT_NONE 0
+
+/* Most words an instruction takes: the first word and two operand words */
+#define MAX_INSTRUCTION_WORDS 3
+
+/*
+ * Encodes the word of a direct operand, which depends on the symbol table.
+ * context - The caller's state, as passed to the instruction encoder.
+ * operand - The direct operand.
+ * index - Index of the operand word within the instruction (1 or 2).
+ * word - Receives the word.
+ * Returns 0 (NO_ERROR) on success, an error code on failure.
+ */
+typedef int (*DirectOperandEncoder)(void *context, const IrOperand *operand, int index, unsigned short *word);
+
+/*
+ * Encodes every word of an instruction.
+ * line - The IR line of the instruction.
+ * words - Receives the words, as many as the form's word_count.
+ * direct - Encodes the direct operand words.
+ * context - Passed on to direct.
+ * Returns 0 (NO_ERROR) on success, or the error returned by direct.
+ */
+typedef int (*InstructionEncoder)(const IrLine *line, unsigned short *words, DirectOperandEncoder direct, void *context);
+
+/*
+ * @struct InstructionForm
+ * An opcode with one combination of operand addressing modes.
+ */
+typedef struct {
+    int legal;                    /* The opcode accepts these addressing modes */
+    int word_count;               /* Number of words the instruction takes */
+    InstructionEncoder encode;    /* Encodes the instruction */
+} InstructionForm;
+
+/*
+ * The forms indexed by opcode, source slot and destination slot. A lone
+ * operand is the destination, so its source slot is OPERAND_SLOT_NONE.
+ */
+extern const InstructionForm INSTRUCTION_FORMS[OPCODE_COUNT][OPERAND_SLOTS][OPERAND_SLOTS];
+
+/*
+ * Returns the table slot of an operand type.
+ * type - The addressing type of the operand.
+ */
+int operand_slot(OperandType type);
+
+/*
+ * Looks up the form of an instruction.
+ * line - The IR line of the instruction.
+ * Returns the form of its opcode and operands.
+ */
+const InstructionForm *get_instruction_form(const IrLine *line);
+
+#endif /* INSTRUCTION_TABLE_H */
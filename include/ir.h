@@ -0,0 +1,122 @@
+#ifndef IR_H
+#define IR_H
+
+#include "line_parser.h"
+
+/*
+ * @file ir.h
+ * Intermediate representation built by the first pass and consumed by the second pass.
+ * Each source line is parsed once; the second pass works only on these records.
+ */
+
+/*
+ * @enum IrKind
+ * The kind of output an IR line produces.
+ */
+typedef enum {
+    IR_INSTRUCTION,  /* An instruction with up to two operands */
+    IR_DATA,         /* A .data or .string directive */
+    IR_ENTRY         /* An .entry directive */
+} IrKind;
+
+/*
+ * @struct IrOperand
+ * A decoded instruction operand.
+ */
+typedef struct {
+    OperandType type;  /* Addressing type of the operand */
+    int value;         /* Immediate value, register number, or name offset for direct operands */
+    int column;        /* Column of the operand in the source line, for messages */
+} IrOperand;
+
+/*
+ * @struct IrLine
+ * A single parsed source line.
+ */
+typedef struct {
+    IrKind kind;        /* What the line produces */
+    int line_number;    /* Number of the source line it came from */
+    int opcode;         /* Opcode number (instructions only) */
+    int operand_count;  /* Number of operands (instructions only) */
+    IrOperand src;      /* Source operand (two-operand instructions only) */
+    IrOperand dest;     /* Destination operand (one- and two-operand instructions) */
+    int word_count;     /* Number of memory words the line occupies */
+    int payload;        /* First value in the data pool, or name offset for .entry */
+    int column;         /* Column of the .entry name, for messages */
+} IrLine;
+
+/*
+ * @struct IrProgram
+ * The parsed program: an array of IR lines plus pools for data values and names.
+ */
+typedef struct {
+    IrLine *lines;       /* Dynamic array of IR lines */
+    int count;           /* Number of IR lines */
+    int capacity;        /* Allocated number of IR lines */
+    int *data;           /* Pool of .data values and .string characters */
+    int data_count;      /* Number of values in the data pool */
+    int data_capacity;   /* Allocated size of the data pool */
+    char *names;         /* Pool of null-terminated symbol names */
+    int names_length;    /* Number of bytes used in the name pool */
+    int names_capacity;  /* Allocated size of the name pool */
+} IrProgram;
+
+/*
+ * Initializes an empty IR program.
+ * program - Pointer to the IR program to initialize.
+ */
+void init_ir_program(IrProgram *program);
+
+/*
+ * Adds an instruction line to the IR program.
+ * program - Pointer to the IR program.
+ * line - Pointer to the parsed assembly line.
+ * line_number - The line number in the source file.
+ * Returns the number of words the instruction occupies, or 0 on error
+ * (ERR_MIUN_MISMATCH is reported if the opcode does not accept the operands' addressing modes).
+ */
+int add_ir_instruction(IrProgram *program, const AssemblyLine *line, int line_number);
+
+/*
+ * Adds a .data or .string directive to the IR program.
+ * program - Pointer to the IR program.
+ * line - Pointer to the parsed assembly line.
+ * line_number - The line number in the source file.
+ * Returns the number of data words the directive occupies, or -1 on error.
+ */
+int add_ir_data(IrProgram *program, const AssemblyLine *line, int line_number);
+
+/*
+ * Adds an .entry directive to the IR program.
+ * program - Pointer to the IR program.
+ * name - The name of the entry symbol.
+ * line_number - The line number in the source file.
+ * column - Column of the name in the source line.
+ * Returns 1 on success, 0 on failure.
+ */
+int add_ir_entry(IrProgram *program, const char *name, int line_number, int column);
+
+/*
+ * Retrieves a name stored in the IR name pool.
+ * program - Pointer to the IR program.
+ * offset - Offset of the name, as stored in an operand or payload.
+ * Returns a pointer to the null-terminated name.
+ */
+const char *get_ir_name(const IrProgram *program, int offset);
+
+/*
+ * Appends the lines of another IR program, copying its data and names
+ * and rebasing the offsets that point into them.
+ * program - Pointer to the IR program to extend.
+ * other - The program whose lines are appended.
+ * Returns 1 on success, 0 if allocation fails.
+ */
+int append_ir_program(IrProgram *program, const IrProgram *other);
+
+/*
+ * Frees the memory held by an IR program.
+ * program - Pointer to the IR program.
+ */
+void free_ir_program(IrProgram *program);
+
+#endif /* IR_H */
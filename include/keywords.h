@@ -0,0 +1,41 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+/*
+ * @file keywords.h
+ * Classification of reserved words (opcodes and directives) with a single lookup.
+ */
+
+/*
+ * @enum DirectiveKind
+ * Enumeration of the directives recognized by the assembler.
+ */
+typedef enum {
+    DIRECTIVE_NONE = 0,  /* Not a directive */
+    DIRECTIVE_DATA,      /* .data */
+    DIRECTIVE_STRING,    /* .string */
+    DIRECTIVE_ENTRY,     /* .entry */
+    DIRECTIVE_EXTERN     /* .extern */
+} DirectiveKind;
+
+/*
+ * @struct Keyword
+ * Describes a reserved word: an opcode or a directive.
+ */
+typedef struct {
+    const char *name;         /* Name of the keyword */
+    int length;               /* Length of the name */
+    int opcode;               /* Opcode number, or -1 for directives */
+    int operands;             /* Number of operands required, or -1 for directives */
+    DirectiveKind directive;  /* Directive kind, or DIRECTIVE_NONE for opcodes */
+} Keyword;
+
+/*
+ * Classifies a word as an opcode or a directive using a perfect hash.
+ * name - The word to classify (need not be null-terminated).
+ * length - The number of characters in the word.
+ * Returns a pointer to the keyword description, or NULL if the word is not reserved.
+ */
+const Keyword *lookup_keyword(const char *name, int length);
+
+#endif /* KEYWORDS_H */
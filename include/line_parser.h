@@ -1,6 +1,8 @@
 #ifndef LINE_PARSER_H
 #define LINE_PARSER_H
 
+#include "keywords.h"
+
 /*
  * @file line_parser.h
  * Definitions and functions for parsing assembly lines.
@@ -32,12 +34,21 @@ typedef enum {
     OPERAND_REGISTER            /* Register operand */
 } OperandType;
 
+/*
+ * @struct Span
+ * A piece of a source line, referenced in place without copying.
+ */
+typedef struct {
+    const char *start;  /* First character of the span */
+    int length;         /* Number of characters in the span, 0 if absent */
+} Span;
+
 /*
  * @struct Operand
  * Represents an operand in an assembly instruction.
  */
 typedef struct Operand {
-    char *value;        /* Value of the operand (as a string) */
+    Span value;         /* Text of the operand within the source line */
     OperandType type;   /* Type of the operand */
 } Operand;
 
@@ -54,20 +65,23 @@ typedef struct {
 /*
  * @struct AssemblyLine
  * Represents a single parsed line of assembly code.
+ * All text fields are spans into the original line, which must outlive the structure.
  */
 typedef struct AssemblyLine {
-    char *label;        /* Label of the line, if present */
-    char *instruction;  /* Instruction part of the line */
-    char *operands;     /* Operands part of the line */
-    Operand *srcOperand;    /* Source operand */
-    Operand *destOperand;   /* Destination operand */
-    char *original;     /* The original line (before parsing) */
-    const Opcode *opcode;   /* Pointer to the associated opcode */
-    int error;          /* Error flag for the line */
+    Span label;             /* Label of the line, if present */
+    Span instruction;       /* Instruction part of the line */
+    Span operands;          /* Operands part of the line */
+    Operand srcOperand;     /* First operand (the only one for one-operand instructions) */
+    Operand destOperand;    /* Second operand */
+    int operand_count;      /* Number of operands found (0-2) */
+    const char *original;   /* The original line (before parsing) */
+    const Keyword *keyword; /* Opcode or directive of the instruction, NULL if unknown */
+    int error;              /* Error flag for the line */
 } AssemblyLine;
 
 /*
  * Parses an assembly line and returns the result in an AssemblyLine structure.
+ * The parser does not allocate memory or modify the line and is reentrant.
  * line - The assembly line as a string.
  * line_number - The line number in the source file.
  * pass - Indicates the current pass (first or second).
@@ -76,22 +90,26 @@ typedef struct AssemblyLine {
 AssemblyLine parse_assembly_line(const char* line, int line_number, int pass);
 
 /*
- * Prints the contents of a parsed AssemblyLine structure.
- * parsedLine - Pointer to the parsed assembly line to be printed.
+ * Copies a span into a null-terminated buffer, truncating it if needed.
+ * destination - The buffer to copy into.
+ * span - The span to copy.
+ * size - The size of the destination buffer.
  */
-void print_assembly_line(const AssemblyLine *parsedLine);
+void copy_span(char *destination, const Span *span, int size);
 
 /*
- * Frees the memory allocated for an AssemblyLine structure.
- * line - Pointer to the AssemblyLine structure to be freed.
+ * Returns the column (from 1) where a span of a parsed line starts, for messages.
+ * line - The parsed line.
+ * span - A span of the line.
+ * Returns 0 if the span is absent.
  */
-void free_assembly_line(const AssemblyLine *line);
+int span_column(const AssemblyLine *line, const Span *span);
 
 /*
- * Frees the memory allocated for an Operand structure.
- * operand - Pointer to the Operand structure to be freed.
+ * Prints the contents of a parsed AssemblyLine structure.
+ * parsedLine - Pointer to the parsed assembly line to be printed.
  */
-void free_operand(Operand *operand);
+void print_assembly_line(const AssemblyLine *parsedLine);
 
 /*
  * Retrieves the number of operands required for a given opcode.
@@ -5,30 +5,92 @@
 
 /*
  * @file lines.h
- * Defines structures and functions for managing linked list of lines.
+ * Defines the in-memory line buffer passed between the assembler stages.
  */
 
 /*
- * @struct lines
- * Represents a single line of text in a linked list.
+ * @struct LineBuffer
+ * Holds a whole source file in memory as consecutive null-terminated lines.
+ * Lines are stored by offset so the text block can grow with realloc.
+ * Each line also keeps the number of the source line it came from (a line
+ * produced by a macro gets the number of the line that invoked the macro),
+ * so messages of every stage refer to the file as written.
  */
-typedef struct lines {
-    char line[MAX_LINE_LENGTH]; /* Content of the line */
-    struct lines *next;         /* Pointer to the next line in the list */
-} lines;
+typedef struct {
+    char *text;          /* Contiguous storage for the text of all lines */
+    int length;          /* Number of bytes used in text */
+    int capacity;        /* Number of bytes allocated for text */
+    int *offsets;        /* Start offset of each line within text */
+    int *numbers;        /* Source line number of each line, 0 if not known */
+    int count;           /* Number of lines stored */
+    int lines_capacity;  /* Number of entries allocated for offsets and numbers */
+    int number;          /* Source line number given to the lines appended next */
+} LineBuffer;
 
 /*
- * Allocates memory for a new line and copies the content into it.
- * content - The content to be stored in the new line.
- * Returns a pointer to the newly allocated line, or NULL if allocation failed.
+ * Initializes an empty line buffer.
+ * buffer - Pointer to the line buffer to initialize.
  */
-lines* malloc_line(const char *content);
+void init_line_buffer(LineBuffer *buffer);
 
 /*
- * Frees the memory of a linked list of lines.
- * head - Pointer to the head of the linked list.
+ * Appends a copy of a line to the end of the line buffer.
+ * buffer - Pointer to the line buffer.
+ * line - The line to append (including its newline, if any).
+ * Returns 1 on success, 0 on memory allocation failure.
  */
-void free_lines(lines *head);
+int append_line(LineBuffer *buffer, const char *line);
+
+/*
+ * Appends a copy of the given characters to the line buffer as a new line.
+ * buffer - Pointer to the line buffer.
+ * line - The characters of the line (need not be null-terminated).
+ * length - Number of characters to copy.
+ * Returns 1 on success, 0 on memory allocation failure.
+ */
+int append_line_view(LineBuffer *buffer, const char *line, int length);
+
+/*
+ * Appends a block of lines laid out like the text of a line buffer
+ * (null-terminated lines back to back) with one copy.
+ * buffer - Pointer to the line buffer.
+ * text - The lines.
+ * length - Number of bytes in text, including the null terminators.
+ * offsets - Start offset of each line within text.
+ * count - Number of lines in the block.
+ * Returns 1 on success, 0 on memory allocation failure.
+ */
+int append_line_block(LineBuffer *buffer, const char *text, int length, const int *offsets, int count);
+
+/*
+ * Retrieves a line stored in the line buffer.
+ * buffer - Pointer to the line buffer.
+ * index - Zero-based index of the line.
+ * Returns a pointer to the null-terminated line.
+ */
+const char *get_line(const LineBuffer *buffer, int index);
+
+/*
+ * Returns the source line number of a stored line, for messages.
+ * buffer - Pointer to the line buffer.
+ * index - Zero-based index of the line.
+ * Returns the number set when the line was appended, or index + 1 if none was.
+ */
+int get_line_number(const LineBuffer *buffer, int index);
+
+/*
+ * Writes every line of the line buffer to a file.
+ * buffer - Pointer to the line buffer.
+ * filename - Name of the output file.
+ * Returns 1 on success, 0 on failure.
+ */
+int write_line_buffer(const LineBuffer *buffer, const char *filename);
+
+/*
+ * Frees the memory held by a line buffer.
+ * buffer - Pointer to the line buffer to free.
+ */
+void free_line_buffer(LineBuffer *buffer);
 
 #endif /* LINES_H */
 
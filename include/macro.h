@@ -2,6 +2,7 @@
 #define MACROS_H
 
 #include "lines.h"
+#include "arena.h"
 
 /*
  * @file macros.h
@@ -10,30 +11,84 @@
 
 /*
  * @struct macros
- * Represents a macro in the assembler, containing a name, its lines of code,
- * and a pointer to the next macro in a linked list.
+ * Represents a macro in the assembler. The body is one contiguous block laid
+ * out like a LineBuffer (null-terminated lines back to back, each ending in a
+ * newline). Body lines may invoke other macros; the fully expanded body is
+ * computed on first use and kept, so each later expansion is a single bulk copy.
+ * Defining a macro drops only the cached expansions it changes: those with a
+ * body line naming it, and those that nest one of them.
  */
 struct macros {
-    char name[MAX_LINE_LENGTH];  /* Name of the macro */
-    struct lines *lines;         /* Lines of code in the macro */
-    struct macros *next;         /* Pointer to the next macro in the list */
+    char *name;                  /* Name of the macro */
+    char *body;                  /* Text of the body lines */
+    int body_length;             /* Number of bytes in body */
+    int *offsets;                /* Start offset of each body line within body */
+    int line_count;              /* Number of lines in the body */
+    unsigned long hash;          /* Hash of the name, cached for lookups */
+    LineBuffer expansion;        /* Body with nested invocations expanded */
+    int *name_lines;             /* Body lines holding a single word, which may name a macro */
+    int name_line_count;         /* Number of name_lines, -1 until they are indexed */
+    int expanded;                /* Set while expansion is up to date */
+    int expanding;               /* Set while the expansion is being made, to detect cycles */
+    struct macros *next;         /* Pointer to the next macro in definition order */
 };
 
 /*
- * Creates a new macro node and inserts it into the macro list.
+ * @struct MacroTable
+ * The macros of one source, indexed by an open-addressing hash table on their names.
+ */
+typedef struct {
+    struct macros *head;         /* First macro in definition order */
+    struct macros *last;         /* Last macro in definition order */
+    struct macros **slots;       /* Hash index of the macros (linear probing) */
+    int capacity;                /* Number of slots, always a power of two */
+    int count;                   /* Number of macros in the table */
+    Arena *arena;                /* Arena owning the macros and their bodies */
+} MacroTable;
+
+/*
+ * Initializes an empty macro table.
+ * table - Pointer to the macro table.
+ * arena - Arena the macros are allocated from.
+ */
+void init_macro_table(MacroTable *table, Arena *arena);
+
+/*
+ * Releases the hash index and the cached expansions of a macro table;
+ * the macros themselves belong to its arena.
+ * table - Pointer to the macro table.
+ */
+void free_macro_table(MacroTable *table);
+
+/*
+ * Creates a new macro with an empty body and adds it to the table, dropping
+ * the cached expansions in which its name was a plain line.
+ * table - Pointer to the macro table.
  * macro_name - Name of the new macro.
- * ptr_to_head - Pointer to the pointer of the head of the macro list.
  * Returns a pointer to the newly created macro node, or NULL if allocation fails.
  */
-struct macros *create_macro_node(const char *macro_name, struct macros **ptr_to_head);
+struct macros *create_macro_node(MacroTable *table, const char *macro_name);
 
 /*
- * Checks if a macro with the given name already exists in the list.
- * head - Pointer to the head of the macro list.
+ * Looks up a macro by name. Whitespace around the name (including the line
+ * terminator of a source line) is ignored; the rest must match exactly.
+ * table - Pointer to the macro table.
  * name - Name of the macro to check for.
  * Returns a pointer to the macro if found, or NULL if not.
  */
-struct macros *is_existing_macro(struct macros *head, const char *name);
+struct macros *is_existing_macro(const MacroTable *table, const char *name);
+
+/*
+ * Returns the fully expanded body of a macro, expanding body lines that invoke
+ * other macros. The result is cached in the macro and reused until a macro
+ * named by one of its body lines, directly or through nested macros, is defined.
+ * table - Pointer to the macro table.
+ * macro - The macro to expand.
+ * line_number - Source line of the invocation, for error reporting.
+ * Returns the expanded lines, or NULL if the macro invokes itself (directly or
+ * through other macros) or memory allocation fails.
+ */
+const LineBuffer *get_macro_expansion(MacroTable *table, struct macros *macro, int line_number);
 
 /*
  * Checks if a line contains no macro name.
@@ -49,11 +104,5 @@ int no_macro_name(const char* line);
  */
 int extra_macro_name(const char* line);
 
-/*
- * Frees the memory of the macro list.
- * head - Pointer to the head of the macro list.
- */
-void free_macros(struct macros *head);
-
 #endif /* MACROS_H */
 
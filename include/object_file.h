@@ -0,0 +1,149 @@
+#ifndef OBJECT_FILE_H
+#define OBJECT_FILE_H
+
+#include "assembler.h"
+#include "binary_table.h"
+#include "symbol_table.h"
+#include "source.h"
+
+/*
+ * @file object_file.h
+ * Binary object format, written next to the text .ob when asked for.
+ *
+ * Every number is little-endian. The file is laid out so a reader can map it
+ * and use it in place: each section starts on a four-byte boundary and the
+ * only checks on opening are the header fields and the section bounds.
+ *
+ *     offset  size
+ *          0     4  magic "AS15"
+ *          4     4  format version (OBJECT_FORMAT_VERSION)
+ *          8     4  file size in bytes
+ *         12     4  base address of the first word
+ *         16     4  IC: number of instruction words
+ *         20     4  DC: number of data words, which follow the instructions
+ *         24     4  number of entries
+ *         28     4  number of extern references
+ *         32     4  offset of the entry records
+ *         36     4  offset of the extern reference records
+ *         40     4  offset of the name table
+ *         44     4  size of the name table in bytes
+ *         48        IC + DC words of 2 bytes (15 bits used), padded to 4 bytes
+ *                   entry records, then extern reference records, 8 bytes each:
+ *                       4  offset of the name in the name table
+ *                       4  address (of the entry, or of the word referencing the extern)
+ *                   name table: the names, each null-terminated
+ *
+ * Word i sits at address base + i. Entries and extern references are in the
+ * order of the .ent and .ext files.
+ */
+
+/* Magic bytes at the start of a binary object */
+#define OBJECT_MAGIC "AS15"
+
+/* Version of the layout above */
+#define OBJECT_FORMAT_VERSION 1
+
+/* Bytes in the header */
+#define OBJECT_HEADER_SIZE 48
+
+/* Bytes in an entry or extern reference record */
+#define OBJECT_RECORD_SIZE 8
+
+/* Extension of binary object files */
+#define OBJECT_EXTENSION ".obj"
+
+/*
+ * @struct ObjectImage
+ * A binary object mapped into memory. The pointers lead into the mapping.
+ */
+typedef struct {
+    SourceFile file;                 /* The mapped file */
+    int base;                        /* Address of the first word */
+    int instruction_count;           /* Number of instruction words */
+    int data_count;                  /* Number of data words */
+    int entry_count;                 /* Number of entry records */
+    int extern_count;                /* Number of extern reference records */
+    const unsigned char *words;      /* The packed words */
+    const unsigned char *entries;    /* The entry records */
+    const unsigned char *externs;    /* The extern reference records */
+    const char *names;               /* The name table */
+    unsigned long names_size;        /* Size of the name table in bytes */
+} ObjectImage;
+
+/*
+ * @struct ObjectModule
+ * An assembled module loaded by a tool (linker, simulator, disassembler):
+ * its words and its entry and extern reference lists.
+ */
+typedef struct {
+    int base;                        /* Address of the first word */
+    int instruction_count;           /* Number of instruction words */
+    int data_count;                  /* Number of data words, after the instructions */
+    unsigned short *words;           /* The words, instructions first */
+    AssembledSymbol *entries;        /* Entries, as listed in the .ent file */
+    int entry_count;                 /* Number of entries */
+    AssembledSymbol *externs;        /* Extern references, as listed in the .ext file */
+    int extern_count;                /* Number of extern references */
+    Arena arena;                     /* Owns the words, the lists and the names */
+} ObjectModule;
+
+/*
+ * Writes a binary object for an assembled program. Nothing is written for an empty program.
+ * table - The object words, instructions first, at consecutive addresses.
+ * symbol_table - Symbol table with the entries and extern references.
+ * filename - Name of the output file.
+ * Returns 1 on success, 0 on failure.
+ */
+int write_object_file(const BinaryTable *table, const SymbolTable *symbol_table, const char *filename);
+
+/*
+ * Maps a binary object and checks its header and section bounds.
+ * filename - Name of the object file.
+ * image - Receives the object; release it with close_object_file.
+ * Returns 0 (NO_ERROR) on success, ERR_FILE_ACCESS if the file cannot be read
+ * or is not a binary object of this version.
+ */
+int open_object_file(const char *filename, ObjectImage *image);
+
+/*
+ * Returns word i of a binary object (0 <= i < IC + DC).
+ */
+unsigned short object_word(const ObjectImage *image, int i);
+
+/*
+ * Returns the name of entry i of a binary object and stores its address.
+ * Returns NULL if the record points outside the name table.
+ */
+const char *object_entry(const ObjectImage *image, int i, int *address);
+
+/*
+ * Returns the name of extern reference i of a binary object and stores the
+ * address of the word that references it.
+ * Returns NULL if the record points outside the name table.
+ */
+const char *object_extern(const ObjectImage *image, int i, int *address);
+
+/*
+ * Unmaps a binary object.
+ * image - The object to release.
+ */
+void close_object_file(ObjectImage *image);
+
+/*
+ * Loads an assembled module, either from a binary object (a name ending in
+ * .obj) or from the text files: the .ob, and the .ent and .ext files if they exist.
+ * Problems are reported with report_message.
+ * filename - A .obj or .ob file, or the base name of the text files.
+ * module - Receives the module; release it with free_object_module.
+ * Returns 0 (NO_ERROR) on success, ERR_FILE_ACCESS if a file cannot be read or
+ * is malformed, ERR_MEMORY_ALLOCATION if allocation fails.
+ */
+int load_object_module(const char *filename, ObjectModule *module);
+
+/*
+ * Releases a loaded module.
+ * module - The module to free.
+ */
+void free_object_module(ObjectModule *module);
+
+#endif /* OBJECT_FILE_H */
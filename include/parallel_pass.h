@@ -0,0 +1,28 @@
+#ifndef PARALLEL_PASS_H
+#define PARALLEL_PASS_H
+
+#include "first_pass.h"
+
+/*
+ * @file parallel_pass.h
+ * First pass over large sources split into chunks processed on several threads.
+ */
+
+/* Fewest lines worth giving to a thread of its own */
+#define MIN_LINES_PER_CHUNK 2048
+
+/*
+ * Executes the first pass on chunks of the expanded source in parallel.
+ * Each chunk is parsed and sized with its own counters and labels; a prefix
+ * sum over the chunk totals then gives the final addresses, and the chunk
+ * symbol tables are merged in source order. If any chunk reports a message
+ * or the merge finds a label defined twice, the serial first pass is run
+ * instead, so messages and line numbers are always those of the serial path.
+ * source - The macro-expanded source lines produced by pre_process.
+ * arena - Arena that owns the symbols of this assembly.
+ * threads - Maximum number of threads to use.
+ * Returns the same FirstPassResult as first_pass.
+ */
+FirstPassResult parallel_first_pass(const LineBuffer *source, Arena *arena, int threads);
+
+#endif /* PARALLEL_PASS_H */
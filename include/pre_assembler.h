@@ -2,7 +2,8 @@
 #define PRE_ASSEMBLER_H
 
 #include "macro.h"
-#include <stdio.h>
+#include "lines.h"
+#include "arena.h"
 
 /*
  * @file pre_assembler.h
@@ -19,11 +20,47 @@ int starts_with(const char* line, const char* prefix);
 
 /*
  * Preprocesses the assembly file, expanding macros and handling directives.
+ * The expanded source is kept in memory and handed to both passes.
  * filename - The name of the assembly file to preprocess.
- * macro_head - The head of the macro list.
- * Returns 1 on success, 0 on failure.
+ * arena - Arena that owns the macro definitions of this assembly.
+ * output - Line buffer that receives the expanded source.
+ * write_am - If non-zero, the expanded source is also written to a .am file.
+ * Returns 0 (NO_ERROR) on success, an error code on failure.
  */
-int pre_process(const char *filename, struct macros *macro_head);
+int pre_process(const char *filename, Arena *arena, LineBuffer *output, int write_am);
+
+/*
+ * Preprocesses assembly source held in memory, expanding macros.
+ * No files are read or written.
+ * source - The assembly source text.
+ * length - Number of characters in the source.
+ * name - Name of the source file for messages, or NULL if it has none.
+ * arena - Arena that owns the macro definitions of this assembly.
+ * output - Line buffer that receives the expanded source.
+ * Returns 0 (NO_ERROR) on success, an error code on failure.
+ */
+int pre_process_buffer(const char *source, size_t length, const char *name, Arena *arena, LineBuffer *output);
+
+/*
+ * Splits source text into lines, dropping blank lines, comments and leading whitespace.
+ * Lines longer than MAX_LINE_LENGTH - 1 characters (not counting the line
+ * terminator) are reported with ERR_LINE_TOO_LONG; the rest are still checked.
+ * Each line is classified in one sweep: skip_blanks finds its first character
+ * and memchr its end, so comment and blank lines are never examined byte by byte.
+ * source - The assembly source text.
+ * length - Number of characters in the source.
+ * output - Line buffer that receives the remaining lines.
+ * Returns 0 (NO_ERROR) on success, an error code on failure.
+ */
+int clean_buffer(const char *source, size_t length, LineBuffer *output);
+
+/*
+ * Maps the assembly file and cleans it with clean_buffer.
+ * input_filename - The name of the assembly file.
+ * output - Line buffer that receives the remaining lines.
+ * Returns 0 (NO_ERROR) on success, an error code on failure.
+ */
+int clean_file(const char *input_filename, LineBuffer *output);
 
 /*
  * Compares two strings case-insensitively.
@@ -34,38 +71,45 @@ int pre_process(const char *filename, struct macros *macro_head);
 int case_insensitive_compare(const char *str1, const char *str2);
 
 /*
- * Handles the macro definitions in the assembly file.
- * original_filename - The name of the original assembly file.
- * temp_filename - The name of the temporary file to store processed output.
- * macro_head - The head of the macro list.
- * Returns 1 on success, 0 on failure.
+ * Handles the macro definitions in the cleaned source. Every bad macro line
+ * is reported; the scan only stops at a macro without end.
+ * input - The cleaned source lines.
+ * output - Line buffer that receives the source with macros expanded.
+ * arena - Arena the macro definitions are allocated from.
+ * Returns 0 on success, 1 on failure.
  */
-int handle_macros(const char *original_filename, const char *temp_filename, struct macros *macro_head);
+int handle_macros(const LineBuffer *input, LineBuffer *output, Arena *arena);
 
 /*
  * Verifies if the given line contains a valid macro name.
  * line - The line to check.
- * macro_head - The head of the macro list.
- * Returns 1 if the macro name is valid, 0 otherwise.
+ * macros - The macros defined so far.
+ * line_number - Source line of the definition, for messages.
+ * Returns 1 if the macro name is invalid, 0 otherwise.
  */
-int verify_macro_name(const char *line, struct macros *macro_head);
+int verify_macro_name(const char *line, const MacroTable *macros, int line_number);
 
 /*
- * Inserts a macro definition into the macro list.
- * input_file - The input file containing the macro definition.
- * output_file - The output file to store the expanded macro.
- * macro_head - The head of the macro list.
+ * Inserts a macro definition into the macro table. The body lines are copied
+ * into one block allocated from the table's arena.
+ * input - The cleaned source lines containing the macro definition.
+ * index - Index of the definition line; left on the closing endmacr line.
+ * macros - The macro table.
  * macro_definition - The macro definition to insert.
- * Returns 1 on success, 0 on failure.
+ * Returns 0 on success, 1 on failure.
  */
-int insert_macro(FILE *input_file, FILE *output_file, struct macros **macro_head, const char *macro_definition);
+int insert_macro(const LineBuffer *input, int *index, MacroTable *macros, const char *macro_definition);
 
 /*
- * Expands a macro and writes its content to the output file.
+ * Expands a macro, including the macros it invokes, by appending its cached
+ * expansion to the output buffer in one copy.
+ * macros - The macro table.
  * macro - Pointer to the macro to expand.
- * output_file - The output file to write the expanded macro.
+ * output - The line buffer that receives the expanded macro.
+ * line_number - Source line of the invocation, for error reporting.
+ * Returns 1 on success, 0 if the macro invokes itself or memory allocation fails.
  */
-void expand_macro(const struct macros *macro, FILE *output_file);
+int expand_macro(MacroTable *macros, struct macros *macro, LineBuffer *output, int line_number);
 
 /*
  * Trims leading and trailing whitespace from a string.
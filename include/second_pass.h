@@ -4,6 +4,7 @@
 #include "symbol_table.h"
 #include "binary_table.h"
 #include "line_parser.h"
+#include "ir.h"
 
 /*
  * @file second_pass.h
@@ -11,38 +12,65 @@
  */
 
 /*
- * Executes the second pass of the assembler on the given source file.
- * filename - The name of the source file.
+ * Executes the second pass of the assembler on the IR built by the first pass.
+ * filename - The base name used for the output files.
+ * program - The IR program produced by first_pass.
  * symbol_table - Pointer to the symbol table.
- * Returns 1 on success, 0 on failure.
+ * binary_object - 1 to also write a binary object (.obj), 0 for the text files only.
+ * Returns 0 on success, an error code on failure.
+ */
+int second_pass(const char *filename, const IrProgram *program, SymbolTable *symbol_table, int binary_object);
+
+/*
+ * Encodes the IR into memory words without writing any files.
+ * Instruction words come first, followed by the data image. Every unknown
+ * symbol is reported before the first one's error code is returned.
+ * program - The IR program produced by first_pass.
+ * symbol_table - Pointer to the symbol table; extern references are added to it.
+ * binary_table - Initialized binary table that receives the words.
+ * Returns 0 (NO_ERROR) on success, an error code on failure.
+ */
+int encode_program(const IrProgram *program, SymbolTable *symbol_table, BinaryTable *binary_table);
+
+/*
+ * Runs the second pass on a program whose first pass failed, writing nothing,
+ * so that the errors the second pass finds are reported in the same run.
+ * program - The IR program produced by first_pass.
+ * symbol_table - Pointer to the symbol table; its entries and extern references change.
+ * Returns 0 (NO_ERROR) if the second pass found nothing, an error code otherwise.
  */
-int second_pass(const char *filename, Symbol *symbol_table);
+int check_program(const IrProgram *program, SymbolTable *symbol_table);
 
 /*
- * Processes a single line during the second pass.
- * line - Pointer to the parsed assembly line.
+ * Processes a single instruction or entry line during the second pass.
+ * line - Pointer to the IR line.
+ * program - The IR program the line belongs to.
  * symbol_table - Pointer to the symbol table.
  * binary_table - Pointer to the binary table for storing instructions.
  * ic - Pointer to the instruction counter.
- * Returns 1 if successful, 0 on failure.
+ * Returns 0 (NO_ERROR) if successful, an error code on failure.
  */
-int process_line_second_pass(const AssemblyLine *line, Symbol *symbol_table, BinaryTable *binary_table, int *ic);
+int process_line_second_pass(const IrLine *line, const IrProgram *program, SymbolTable *symbol_table, BinaryTable *binary_table, int *ic);
 
 /*
- * Resolves a symbol name in the symbol table.
- * symbol_name - The name of the symbol to resolve.
- * symbol_table - Pointer to the symbol table.
- * Returns the address of the symbol, or -1 if not found.
+ * Emits the words of a .data or .string line into the binary table.
+ * line - Pointer to the IR line of the directive.
+ * program - The IR program holding the data values.
+ * binary_table - Pointer to the binary table.
+ * dc - Pointer to the address of the next data word.
+ * Returns 0 (NO_ERROR) if successful, an error code on failure.
  */
-int resolve_symbol(const char *symbol_name, Symbol *symbol_table);
+int handle_data_directive(const IrLine *line, const IrProgram *program, BinaryTable *binary_table, int *dc);
 
 /*
  * Handles the .entry directive during the second pass.
- * line - Pointer to the parsed assembly line.
+ * symbol_name - The name of the entry symbol.
  * symbol_table - Pointer to the symbol table.
- * Returns 1 if successful, 0 on failure.
+ * line_number - Source line of the directive, for messages.
+ * column - Column of the name in the source line, for messages.
+ * Returns 0 (NO_ERROR) if successful, an error code on failure.
  */
-int handle_entry_directive(const AssemblyLine* line, Symbol* symbol_table);
+int handle_entry_directive(const char *symbol_name, SymbolTable *symbol_table, int line_number, int column);
 
 /*
  * Writes the entry symbols to an entry file.
@@ -50,42 +78,37 @@ int handle_entry_directive(const AssemblyLine* line, Symbol* symbol_table);
  * symbol_table - Pointer to the symbol table.
  * Returns 1 on success, 0 on failure.
  */
-int write_entry_file(const char *base_name, const Symbol *symbol_table);
-
-/*
- * Processes an operand during the second pass.
- * operand - Pointer to the operand to process.
- * symbol_table - Pointer to the symbol table.
- * binary_table - Pointer to the binary table.
- * current_address - Pointer to the current address being processed.
- * src - Pointer to the source operand, if applicable.
- * dest - Pointer to the destination operand, if applicable.
- * Returns 1 if successful, 0 on failure.
- */
-int process_operand(const Operand *operand, Symbol *symbol_table, BinaryTable *binary_table, int *current_address, const Operand* src, const Operand* dest);
+int write_entry_file(const char *base_name, const SymbolTable *symbol_table);
 
 /*
  * Writes the external symbols to an extern file.
  * base_name - Base name of the output file (without extension).
  * Returns 1 on success, 0 on failure.
  */
-int write_extern_file(const char *base_name);
+int write_extern_file(const char *base_name, const SymbolTable *symbol_table);
 
 /*
- * Processes a symbol during the second pass.
- * symbol_name - The name of the symbol to process.
- * line_number - The current line number being processed.
+ * Encodes the word of a direct (label) operand.
+ * References to extern symbols are recorded in the symbol table.
+ * name - The referenced symbol name.
  * symbol_table - Pointer to the symbol table.
+ * address - Address of the operand word.
+ * line_number - Source line of the instruction, for messages.
+ * column - Column of the operand in the source line, for messages.
+ * word - Receives the encoded word.
+ * Returns 0 (NO_ERROR) if successful, an error code on failure.
  */
-void process_symbol_in_second_pass(const char *symbol_name, int line_number, Symbol *symbol_table);
+int encode_direct_operand(const char *name, SymbolTable *symbol_table, int address, int line_number, int column,
+                          unsigned short *word);
 
 /*
  * Writes the final output files (object, entry, and extern) after the second pass.
  * table - Pointer to the binary table.
  * symbol_table - Pointer to the symbol table.
  * filename - The base name of the output file (without extension).
+ * binary_object - 1 to also write a binary object (.obj), 0 for the text files only.
  */
-void write_output_files(const BinaryTable *table, const Symbol *symbol_table, const char *filename);
+void write_output_files(const BinaryTable *table, const SymbolTable *symbol_table, const char *filename, int binary_object);
 
 #endif /* SECOND_PASS_H */
 
@@ -0,0 +1,79 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+/*
+ * @file server.h
+ * Long-running assembler on a Unix domain socket, and the client for it.
+ *
+ * A client connects and sends any number of requests; each is answered
+ * before the next one is read. Numbers are 32-bit unsigned, most
+ * significant byte first.
+ *
+ * Request: a kind byte, the payload length, then the payload.
+ *     'S' - the payload is the name of the source file (used in messages),
+ *           a null byte, then the assembly source text.
+ *     'P' - the payload is the path of a source file, read by the server.
+ *     'Q' - no payload; the server stops after replying.
+ * Reply: the status (0 on success, an ErrorCode otherwise), then four
+ * sections, each a length followed by that many bytes:
+ *     object      - contents of the .ob file
+ *     entries     - contents of the .ent file
+ *     externs     - contents of the .ext file
+ *     diagnostics - the messages, each a tag followed by null-terminated
+ *                   text: '1' for stdout and '2' for stderr, then the text
+ *                   to print; or '3' for a diagnostic, then its severity
+ *                   ('E' or 'W'), code, line and column separated by
+ *                   spaces, a tab, the file name, a tab and the message
+ * An empty output section is a file that would not have been written.
+ */
+
+/* Name of the socket used when none is given, in the user's runtime directory */
+#define DEFAULT_SOCKET_NAME "assembler.sock"
+
+/* Request kinds */
+#define REQUEST_SOURCE 'S'
+#define REQUEST_PATH 'P'
+#define REQUEST_STOP 'Q'
+
+/* Largest request payload the server accepts */
+#define MAX_REQUEST_LENGTH (64UL * 1024 * 1024)
+
+/*
+ * Listens on a Unix domain socket and assembles requests on a pool of worker
+ * threads until a stop request arrives. Each worker keeps its arena, object
+ * table and buffers from one request to the next. The socket file is replaced
+ * if it exists, readable and writable by its owner only, and removed when the
+ * server stops.
+ * socket_path - Path of the socket.
+ * workers - Number of worker threads (connections served at once).
+ * Returns 0 (NO_ERROR) after a stop request, ERR_FILE_ACCESS if the socket cannot be set up.
+ */
+int serve(const char *socket_path, int workers);
+
+/*
+ * Assembles files on a running server, printing their diagnostics and writing
+ * their output files just as assemble_files would.
+ * socket_path - Path of the server's socket.
+ * filenames - The assembly files, with or without the .as extension.
+ * count - Number of files.
+ * send_paths - 1 to send the absolute path of each file for the server to
+ *              read, 0 to read each file here and send its contents.
+ * Returns 0 if every file assembled, otherwise the status of the first file that failed.
+ */
+int assemble_remote(const char *socket_path, char *const *filenames, int count, int send_paths);
+
+/*
+ * Returns the socket used when none is given: DEFAULT_SOCKET_NAME in
+ * $XDG_RUNTIME_DIR, or /tmp/assembler-<uid>.sock if that is not set, so that
+ * every user has a server of their own.
+ */
+const char *default_socket_path(void);
+
+/*
+ * Asks a running server to stop.
+ * socket_path - Path of the server's socket.
+ * Returns 0 (NO_ERROR) once the server has acknowledged, ERR_FILE_ACCESS if it cannot be reached.
+ */
+int stop_server(const char *socket_path);
+
+#endif /* SERVER_H */
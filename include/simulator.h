@@ -0,0 +1,96 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdio.h>
+#include "common.h"
+#include "object_file.h"
+
+/*
+ * @file simulator.h
+ * Simulator of the target machine: MAX_MEMORY_WORDS words of 15 bits,
+ * registers r0-r7, a Z flag set by cmp and a return address stack for jsr/rts.
+ *
+ * Every instruction word is decoded once into a DecodedInstruction holding the
+ * handler of its opcode, its operand modes and values and the address of the
+ * next instruction. Execution is call-threaded: each handler carries out its
+ * instruction and returns the record to run next, so the loop is nothing but
+ * record = record->handler(machine, record). A store into memory invalidates
+ * the records that could include the stored word, which are decoded again
+ * when next reached, so self-modifying programs still run correctly.
+ *
+ * red reads one character from the input into its operand (-1 at end of
+ * input); prn writes the low byte of its operand to the output as a character.
+ */
+
+/* Registers r0-r7 */
+#define SIMULATOR_REGISTERS 8
+
+/* Depth of the jsr return address stack */
+#define SIMULATOR_STACK_DEPTH 1024
+
+/* Outcome of a run */
+#define SIMULATOR_HALTED 0        /* Reached stop */
+#define SIMULATOR_FAULT 1         /* Ran into an invalid instruction or access */
+#define SIMULATOR_STEP_LIMIT 2    /* Executed the maximum number of instructions */
+
+typedef struct Machine Machine;
+typedef struct DecodedInstruction DecodedInstruction;
+
+/* Carries out one instruction; returns the next one to run, or NULL to stop */
+typedef DecodedInstruction *(*InstructionHandler)(Machine *machine, DecodedInstruction *instruction);
+
+/*
+ * @struct DecodedInstruction
+ * An instruction word decoded for execution.
+ */
+struct DecodedInstruction {
+    InstructionHandler handler;      /* Handler of the opcode, or of a decoding step or fault */
+    int address;                     /* Address of the instruction word */
+    int source_mode;                 /* Addressing mode of the source (0 if none) */
+    int source;                      /* Immediate value, address or register of the source */
+    int target_mode;                 /* Addressing mode of the target (0 if none) */
+    int target;                      /* Immediate value, address or register of the target */
+    DecodedInstruction *next;        /* The instruction that follows */
+    const char *fault;               /* Why the word cannot run, for the fault handler */
+};
+
+/*
+ * @struct Machine
+ * State of the simulated machine.
+ */
+struct Machine {
+    unsigned short memory[MAX_MEMORY_WORDS];            /* The memory, 15 bits per word */
+    unsigned short registers[SIMULATOR_REGISTERS];      /* r0-r7 */
+    int zero;                                           /* Z flag: the last cmp found its operands equal */
+    int stack[SIMULATOR_STACK_DEPTH];                   /* Return addresses of jsr */
+    int stack_depth;                                    /* Number of return addresses on the stack */
+    DecodedInstruction decoded[MAX_MEMORY_WORDS + 1];   /* One record per address, one past the end */
+    int start;                                          /* Address execution starts at */
+    unsigned long steps;                                /* Instructions executed */
+    const char *fault;                                  /* Why the last run faulted */
+    int fault_address;                                  /* Address of the instruction that faulted */
+    FILE *input;                                        /* Read by red */
+    FILE *output;                                       /* Written by prn */
+};
+
+/*
+ * Loads a program into a machine and decodes its instructions.
+ * The words are placed at their addresses; execution starts at the first word.
+ * machine - The machine to initialize.
+ * program - A linked program or a module without extern references.
+ * input - Stream read by red.
+ * output - Stream written by prn.
+ * Returns 0 (NO_ERROR) on success, ERR_PROCESSING_FAILED if the program does not
+ * fit in memory or still has extern references.
+ */
+int load_machine(Machine *machine, const ObjectModule *program, FILE *input, FILE *output);
+
+/*
+ * Runs the loaded program from its start address.
+ * machine - The loaded machine.
+ * step_limit - Maximum number of instructions to execute, 0 for no limit.
+ * Returns SIMULATOR_HALTED, SIMULATOR_FAULT (see machine->fault) or SIMULATOR_STEP_LIMIT.
+ */
+int run_machine(Machine *machine, unsigned long step_limit);
+
+#endif /* SIMULATOR_H */
@@ -0,0 +1,76 @@
+#ifndef SINGLE_PASS_H
+#define SINGLE_PASS_H
+
+#include "first_pass.h"
+#include "binary_table.h"
+#include "lines.h"
+#include "arena.h"
+
+/*
+ * @file single_pass.h
+ * Single-pass assembly: words are encoded while the source is read, and
+ * operands naming symbols are backpatched from a fixup list at end of file.
+ * The result is identical to the first pass followed by the second pass.
+ */
+
+/*
+ * @enum FixupKind
+ * What a fixup completes once all symbols are known.
+ */
+typedef enum {
+    FIXUP_OPERAND,   /* A direct operand word to encode */
+    FIXUP_ENTRY      /* An .entry directive to apply */
+} FixupKind;
+
+/*
+ * @struct Fixup
+ * Work deferred to the end of the file, kept in source order.
+ */
+typedef struct {
+    FixupKind kind;     /* Kind of fixup */
+    int word;           /* Index of the operand word in the image (FIXUP_OPERAND) */
+    int name;           /* Offset of the symbol name in the IR name pool */
+    int line_number;    /* Source line, for diagnostics */
+    int column;         /* Column of the name in the source line, for diagnostics */
+} Fixup;
+
+/*
+ * @struct SinglePassResult
+ * State and output of a single-pass assembly.
+ */
+typedef struct {
+    FirstPassResult pass;   /* Symbols, counters and IR, as built by the first pass */
+    BinaryTable image;      /* Instruction words; the data is appended by resolve_fixups */
+    BinaryTable data;       /* Data words, addressed from the start of the data segment */
+    Fixup *fixups;          /* Deferred operands and entries in source order */
+    int fixup_count;        /* Number of fixups */
+    int fixup_capacity;     /* Allocated fixups */
+} SinglePassResult;
+
+/*
+ * Reads the expanded source once, encoding each line as it is parsed.
+ * Operands naming symbols get a placeholder word and a fixup.
+ * source - The macro-expanded source lines produced by pre_process.
+ * arena - Arena that owns the symbols of this assembly.
+ * result - Receives the state; release it with free_single_pass.
+ * Returns 0 (NO_ERROR) on success, or the error of the first bad line; the
+ * lines after it are still read, so every bad line is reported.
+ */
+int single_pass(const LineBuffer *source, Arena *arena, SinglePassResult *result);
+
+/*
+ * Patches every fixup in one sweep, recording extern references, then
+ * appends the data words shifted past the final instruction counter.
+ * Every unknown symbol is reported, not only the first.
+ * result - The state built by single_pass.
+ * Returns 0 (NO_ERROR) on success, an error code on failure.
+ */
+int resolve_fixups(SinglePassResult *result);
+
+/*
+ * Frees the memory used by a single-pass result.
+ * result - Pointer to the result to free.
+ */
+void free_single_pass(SinglePassResult *result);
+
+#endif /* SINGLE_PASS_H */
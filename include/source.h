@@ -0,0 +1,88 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+
+/*
+ * @file source.h
+ * Input layer: maps a source file into memory once and splits it into line views.
+ */
+
+/*
+ * @struct SourceFile
+ * The contents of an input file, mapped or read into memory.
+ */
+typedef struct {
+    const char *text;        /* File contents (not null-terminated) */
+    size_t length;           /* Number of bytes in the file */
+    int mapped;              /* 1 if text is a mapping, 0 if it was read into the heap */
+} SourceFile;
+
+/*
+ * @struct LineView
+ * One line of a source buffer, pointing into the buffer itself.
+ */
+typedef struct {
+    const char *start;       /* First character of the line */
+    int length;              /* Length including the newline, if any */
+    int number;              /* One-based line number in the source */
+} LineView;
+
+/*
+ * @struct LineScanner
+ * Position of a line-by-line walk over a source buffer.
+ */
+typedef struct {
+    const char *cursor;      /* Start of the next line */
+    const char *end;         /* End of the buffer */
+    int number;              /* Number of lines returned so far */
+} LineScanner;
+
+/*
+ * Maps a file into memory, or reads it if it cannot be mapped.
+ * filename - The name of the file.
+ * file - Receives the contents; release it with close_source.
+ * Returns 0 (NO_ERROR) on success, ERR_FILE_ACCESS or ERR_MEMORY_ALLOCATION on failure.
+ */
+int open_source(const char *filename, SourceFile *file);
+
+/*
+ * Releases the contents of a source file.
+ * file - Pointer to the source file.
+ */
+void close_source(SourceFile *file);
+
+/*
+ * Starts a line-by-line walk over a buffer.
+ * scanner - The scanner to initialize.
+ * text - The buffer.
+ * length - Number of bytes in the buffer.
+ */
+void init_line_scanner(LineScanner *scanner, const char *text, size_t length);
+
+/*
+ * Returns the next line of the buffer. Line ends are found with memchr.
+ * scanner - The scanner.
+ * line - Receives the next line.
+ * Returns 1 if a line was returned, 0 at the end of the buffer.
+ */
+int next_line(LineScanner *scanner, LineView *line);
+
+/*
+ * Skips spaces and tabs. The bytes are compared 32 (AVX2) or 16 (SSE2) at a time
+ * where the compiler targets those instruction sets, and one at a time otherwise
+ * or when SOURCE_NO_SIMD is defined.
+ * text - The first character to examine.
+ * end - End of the buffer.
+ * Returns the first character that is neither a space nor a tab, or end.
+ */
+const char *skip_blanks(const char *text, const char *end);
+
+/*
+ * Length of a line without its line terminator ("\n" or "\r\n").
+ * line - The line.
+ * Returns the number of characters before the terminator.
+ */
+int line_content_length(const LineView *line);
+
+#endif /* SOURCE_H */
@@ -1,6 +1,8 @@
 #ifndef SYMBOL_TABLE_H
 #define SYMBOL_TABLE_H
 
+#include "arena.h"
+
 /*
  * @file symbol_table.h
  * Definitions and functions for managing the symbol table in the assembler.
@@ -29,18 +31,10 @@ typedef struct Symbol {
     int is_data_line;        /* Flag indicating if it's a data line */
     int line;                /* The line number where the symbol is defined */
     char *data;              /* Data associated with DATA and STRING symbols */
-    struct Symbol *next;     /* Pointer to the next symbol in the table */
+    unsigned long hash;      /* Hash of the name, cached for lookups */
+    struct Symbol *next;     /* Pointer to the next symbol in definition order */
 } Symbol;
 
-/*
- * @struct SymbolTable
- * Represents the symbol table as a linked list of symbols.
- */
-typedef struct SymbolTable {
-    Symbol *head;            /* Pointer to the first symbol in the table */
-    Symbol *last;            /* Pointer to the last symbol in the table */
-} SymbolTable;
-
 /*
  * @struct ExternReference
  * Represents a reference to an external symbol in the assembler.
@@ -51,31 +45,54 @@ typedef struct ExternReference {
     struct ExternReference *next; /* Pointer to the next external reference */
 } ExternReference;
 
-/* External reference to the list of external symbols */
-extern ExternReference* extern_references;
+/*
+ * @struct SymbolTable
+ * Represents the symbol table as a list of symbols in definition order,
+ * indexed by an open-addressing hash table on the symbol names.
+ */
+typedef struct SymbolTable {
+    Symbol *head;            /* Pointer to the first symbol in the table */
+    Symbol *last;            /* Pointer to the last symbol in the table */
+    Symbol **slots;          /* Hash index of the symbols (linear probing) */
+    int capacity;            /* Number of slots, always a power of two */
+    int count;               /* Number of symbols in the table */
+    ExternReference *externs; /* References to extern symbols, most recent first */
+    Arena *arena;            /* Arena owning the symbols and extern references */
+} SymbolTable;
 
 /*
- * Adds a new external symbol reference to the list.
+ * Adds a new external symbol reference to the symbol table's list.
+ * symbol_table - Pointer to the symbol table that collects the references.
  * name - The name of the external symbol.
  * address - The address where the external symbol is referenced.
+ * Returns 1 on success, 0 if allocation fails.
  */
-void add_extern_reference(const char *name, int address);
+int add_extern_reference(SymbolTable *symbol_table, const char *name, int address);
 
 /*
  * Retrieves the list of external symbol references.
+ * symbol_table - Pointer to the symbol table.
  * Returns a pointer to the head of the external reference list.
  */
-const ExternReference *get_extern_references(void);
+const ExternReference *get_extern_references(const SymbolTable *symbol_table);
+
+/*
+ * Initializes an empty symbol table.
+ * symbol_table - Pointer to the symbol table to initialize.
+ * arena - Arena the symbols are allocated from.
+ */
+void init_symbol_table(SymbolTable *symbol_table, Arena *arena);
 
 /*
  * Counts the number of data symbols in the symbol table.
  * symbol_table - Pointer to the symbol table.
  * Returns the count of data symbols.
  */
-int count_data_symbols(const Symbol *symbol_table);
+int count_data_symbols(const SymbolTable *symbol_table);
 
 /*
  * Adds a new symbol to the symbol table.
+ * Surrounding whitespace is trimmed from the name before it is stored.
  * symbol_table - Pointer to the symbol table.
  * name - The name of the symbol.
  * address - The memory address of the symbol.
@@ -84,34 +101,36 @@ int count_data_symbols(const Symbol *symbol_table);
  * line - The line number where the symbol is defined.
  * Returns 1 on success, 0 on failure.
  */
-int add_symbol(Symbol **symbol_table, const char *name, int address, SymbolType type, int is_data_line, int line);
+int add_symbol(SymbolTable *symbol_table, const char *name, int address, SymbolType type, int is_data_line, int line);
 
 /*
  * Finds a symbol by its name in the symbol table.
+ * Surrounding whitespace in the name is ignored.
  * name - The name of the symbol to find.
  * symbol_table - Pointer to the symbol table.
  * Returns a pointer to the symbol if found, or NULL if not.
  */
-Symbol *find_symbol(const char *name, Symbol *symbol_table);
+Symbol *find_symbol(const char *name, const SymbolTable *symbol_table);
 
 /*
- * Frees the memory used by the symbol table.
+ * Frees the hash index of the symbol table.
+ * The symbols themselves are released with the table's arena.
  * symbol_table - Pointer to the symbol table to be freed.
  */
-void free_symbol_table(Symbol *symbol_table);
+void free_symbol_table(SymbolTable *symbol_table);
 
 /*
  * Prints the contents of the symbol table.
  * symbol_table - Pointer to the symbol table to print.
  */
-void print_symbol_table(Symbol *symbol_table);
+void print_symbol_table(const SymbolTable *symbol_table);
 
 /*
  * Updates the addresses of data symbols after the first pass.
  * symbol_table - Pointer to the symbol table.
  * ic - The instruction counter value after the first pass.
  */
-void update_data_symbols(Symbol *symbol_table, int ic);
+void update_data_symbols(SymbolTable *symbol_table, int ic);
 
 #endif /* SYMBOL_TABLE_H */
 
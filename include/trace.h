@@ -0,0 +1,58 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * @file trace.h
+ * Timing spans of the assembler stages, written as Chrome trace-event JSON
+ * (load the file in chrome://tracing or Perfetto).
+ *
+ * A span is measured on the monotonic clock:
+ *     double started = trace_clock();
+ *     ... the stage ...
+ *     trace_span("first_pass", started);
+ * Spans are recorded on the calling thread's current track. Tracks are grouped
+ * by worker; a batch worker starts a new track for every file it assembles.
+ * While tracing is off, both calls return at once.
+ */
+
+/*
+ * Starts recording spans. Call before any worker thread is started.
+ * Returns 1 on success, 0 if tracing was already started.
+ */
+int start_trace(void);
+
+/*
+ * Writes the recorded spans to a file and stops recording.
+ * Call after every worker thread has finished.
+ * filename - The name of the trace file.
+ * Returns 1 on success, 0 if the file could not be written.
+ */
+int write_trace(const char *filename);
+
+/*
+ * Starts a new track for the calling thread; later spans of the thread go there.
+ * group - Number of the track group (the worker); tracks of a group are shown together.
+ * group_name - Name of the group, or NULL to leave it unchanged.
+ * track_name - Name of the track (the file being assembled, for example).
+ */
+void enter_trace_track(int group, const char *group_name, const char *track_name);
+
+/*
+ * Returns the group of the calling thread's current track, 0 if it has none.
+ */
+int current_trace_group(void);
+
+/*
+ * Returns the start time of a span, in microseconds since tracing started,
+ * or 0 if tracing is off.
+ */
+double trace_clock(void);
+
+/*
+ * Records a span that started at the given time and ends now.
+ * name - Name of the span; must stay valid until the trace is written.
+ * started - Value returned by trace_clock when the span started.
+ */
+void trace_span(const char *name, double started);
+
+#endif /* TRACE_H */
@@ -43,5 +43,21 @@ char* replace_file_extension(const char* filename, const char* new_extension);
  */
 char *my_strdup(const char *s);
 
+/*
+ * Finds a string without its leading and trailing whitespace.
+ * text - The string.
+ * length - Receives the length of the span.
+ * Returns the first character of the span.
+ */
+const char *trim_span(const char *text, int *length);
+
+/*
+ * Hashes a name for the open-addressing tables (FNV-1a, 32 bits).
+ * name - The characters of the name (need not be null-terminated).
+ * length - Number of characters in the name.
+ * Returns the hash value.
+ */
+unsigned long hash_name(const char *name, int length);
+
 #endif /* UTILS_H */
 
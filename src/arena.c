@@ -0,0 +1,97 @@
+#include "arena.h"
+#include "error_handling.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Size of the first block; later blocks double */
+#define ARENA_BLOCK_SIZE 4096
+
+/* Strictest alignment needed by any object placed in the arena */
+typedef union {
+    long l;
+    double d;
+    void *p;
+} ArenaAlign;
+
+#define ARENA_ALIGNMENT sizeof(ArenaAlign)
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT)
+
+/* The usable bytes of a block start after its (aligned) header */
+#define ARENA_HEADER ARENA_ROUND(sizeof(ArenaBlock))
+#define BLOCK_DATA(block) ((char *)(block) + ARENA_HEADER)
+
+void init_arena(Arena *arena) {
+    arena->head = NULL;
+}
+
+/* Start a new block able to hold at least the requested size */
+static ArenaBlock *new_block(Arena *arena, size_t size) {
+    size_t block_size = arena->head ? arena->head->size * 2 : ARENA_BLOCK_SIZE;
+    ArenaBlock *block;
+
+    while (block_size < size) {
+        block_size *= 2;
+    }
+    block = malloc(ARENA_HEADER + block_size);
+    if (block == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return NULL;
+    }
+    block->size = block_size;
+    block->used = 0;
+    block->next = arena->head;
+    arena->head = block;
+    return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    ArenaBlock *block = arena->head;
+    void *memory;
+
+    size = ARENA_ROUND(size);
+    if (block == NULL || block->size - block->used < size) {
+        block = new_block(arena, size);
+        if (block == NULL) {
+            return NULL;
+        }
+    }
+    memory = BLOCK_DATA(block) + block->used;
+    block->used += size;
+    return memory;
+}
+
+char *arena_strndup(Arena *arena, const char *str, int length) {
+    char *copy = arena_alloc(arena, length + 1);
+    if (copy != NULL) {
+        memcpy(copy, str, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+void reset_arena(Arena *arena) {
+    ArenaBlock *block;
+
+    if (arena->head == NULL) {
+        return;
+    }
+    /* The newest block is the largest one */
+    block = arena->head->next;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+}
+
+void free_arena(Arena *arena) {
+    ArenaBlock *block = arena->head;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assembler.h"
+#include "second_pass.h"
+#include "symbol_table.h"
+#include "first_pass.h"
+#include "pre_assembler.h"
+#include "single_pass.h"
+#include "parallel_pass.h"
+#include "lines.h"
+#include "utils.h"
+#include "error_handling.h"
+#include "trace.h"
+
+/* Assemble the expanded source in one pass with backpatching, then write the output files */
+static int assemble_single_pass(const char *base_filename, LineBuffer *source, Arena *arena, int binary_object) {
+    SinglePassResult result;
+    int status;
+    double started = trace_clock();
+
+    status = single_pass(source, arena, &result);
+    trace_span("single_pass", started);
+    free_line_buffer(source);
+    if (status != NO_ERROR) {
+        report_message(stdout, "Error in first pass\n");
+        /* Report the unknown symbols too; nothing is written */
+        if (status != ERR_MEMORY_ALLOCATION) {
+            resolve_fixups(&result);
+        }
+        free_single_pass(&result);
+        return status;
+    }
+
+    started = trace_clock();
+    status = resolve_fixups(&result);
+    trace_span("resolve_fixups", started);
+    if (status != NO_ERROR) {
+        report_message(stdout, "Error in second pass\n");
+    } else {
+        write_output_files(&result.image, &result.pass.symbolTable, base_filename, binary_object);
+    }
+
+    free_single_pass(&result);
+    return status;
+}
+
+/* Run every stage on one source; messages name the source already */
+static int assemble_source(const char *input_filename, const char *base_filename, Arena *arena, const AssemblyOptions *options) {
+    LineBuffer source;
+    int status;
+    FirstPassResult first_pass_result;
+
+    init_line_buffer(&source);
+
+    /* Pre-assembler stage */
+    status = pre_process(input_filename, arena, &source, options->write_am);
+    if (status != NO_ERROR) {
+        report_message(stdout, "Error in pre-assembler stage\n");
+        free_line_buffer(&source);
+        return status;
+    }
+
+    if (options->single_pass) {
+        return assemble_single_pass(base_filename, &source, arena, options->binary_object);
+    }
+
+    /* First pass */
+    if (options->pass_threads > 1) {
+        first_pass_result = parallel_first_pass(&source, arena, options->pass_threads);
+    } else {
+        first_pass_result = first_pass(&source, arena);
+    }
+    free_line_buffer(&source);
+    if (first_pass_result.errorFlag != NO_ERROR) {
+        report_message(stdout, "Error in first pass\n");
+
+        /* The second pass can still report unknown symbols; nothing is written */
+        if (first_pass_result.errorFlag != ERR_MEMORY_ALLOCATION) {
+            check_program(&first_pass_result.program, &first_pass_result.symbolTable);
+        }
+        free_symbol_table(&first_pass_result.symbolTable);
+        free_ir_program(&first_pass_result.program);
+        return first_pass_result.errorFlag;
+    }
+
+    /* Second pass, on the IR only */
+    status = second_pass(base_filename, &first_pass_result.program, &first_pass_result.symbolTable, options->binary_object);
+    if (status != NO_ERROR) {
+        report_message(stdout, "Error in second pass\n");
+    }
+
+    /* Free allocated resources */
+    free_ir_program(&first_pass_result.program);
+    free_symbol_table(&first_pass_result.symbolTable);
+
+    return status;
+}
+
+int assemble_file(const char *input_filename, Arena *arena, const AssemblyOptions *options) {
+    char *base_filename;
+    char *as_filename;
+    const char *previous_source;
+    int status;
+    char *dot;
+
+    /* Check file extension for ".as" */
+    dot = strrchr(input_filename, '.');
+    if (dot && (strcmp(dot + 1, "as") != 0)) {
+        previous_source = set_diagnostic_source(input_filename);
+        report_diagnostic(ERR_FILE_ACCESS, 0, 0, "Wrong File Extension");
+        set_diagnostic_source(previous_source);
+        return ERR_FILE_ACCESS;
+    }
+
+    /* Remove the file extension for further processing */
+    base_filename = remove_extension(input_filename);
+    as_filename = replace_file_extension(input_filename, ".as");
+    if (base_filename == NULL || as_filename == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        free(base_filename);
+        free(as_filename);
+        return ERR_MEMORY_ALLOCATION;
+    }
+
+    /* Diagnostics of every stage name the source file */
+    previous_source = set_diagnostic_source(as_filename);
+    status = assemble_source(input_filename, base_filename, arena, options);
+    set_diagnostic_source(previous_source);
+
+    free(as_filename);
+    free(base_filename);
+    return status;
+}
+
+/* Copy the entries and extern references of the symbol table into the result */
+static int collect_symbols(const SymbolTable *symbol_table, AssemblyResult *result) {
+    const Symbol *symbol;
+    const ExternReference *reference;
+    int count = 0;
+
+    for (symbol = symbol_table->head; symbol != NULL; symbol = symbol->next) {
+        if (symbol->type == SYMBOL_ENTRY) {
+            count++;
+        }
+    }
+    result->entries = arena_alloc(&result->arena, sizeof(AssembledSymbol) * (count + 1));
+    if (result->entries == NULL) {
+        return ERR_MEMORY_ALLOCATION;
+    }
+    for (symbol = symbol_table->head; symbol != NULL; symbol = symbol->next) {
+        if (symbol->type == SYMBOL_ENTRY) {
+            result->entries[result->entry_count].name = symbol->name;
+            result->entries[result->entry_count].address = symbol->address;
+            result->entry_count++;
+        }
+    }
+
+    count = 0;
+    for (reference = get_extern_references(symbol_table); reference != NULL; reference = reference->next) {
+        count++;
+    }
+    result->externs = arena_alloc(&result->arena, sizeof(AssembledSymbol) * (count + 1));
+    if (result->externs == NULL) {
+        return ERR_MEMORY_ALLOCATION;
+    }
+    for (reference = get_extern_references(symbol_table); reference != NULL; reference = reference->next) {
+        result->externs[result->extern_count].name = reference->name;
+        result->externs[result->extern_count].address = reference->address;
+        result->extern_count++;
+    }
+    return NO_ERROR;
+}
+
+/* Clear what the previous assembly into a result produced */
+static void clear_result(AssemblyResult *result) {
+    result->status = NO_ERROR;
+    result->instruction_count = 0;
+    result->data_count = 0;
+    result->entries = NULL;
+    result->entry_count = 0;
+    result->externs = NULL;
+    result->extern_count = 0;
+}
+
+/* Assemble source into a result whose buffers are ready and empty */
+static int assemble_into(const char *source, size_t length, const char *name, AssemblyResult *result) {
+    DiagnosticBuffer *previous;
+    const char *previous_source;
+    LineBuffer expanded;
+    FirstPassResult first_pass_result;
+
+    previous = capture_diagnostics(&result->diagnostics);
+    previous_source = set_diagnostic_source(name);
+    init_line_buffer(&expanded);
+
+    /* Pre-assembler stage */
+    result->status = pre_process_buffer(source, length, name, &result->arena, &expanded);
+    if (result->status != NO_ERROR) {
+        report_message(stdout, "Error in pre-assembler stage\n");
+        free_line_buffer(&expanded);
+        set_diagnostic_source(previous_source);
+        capture_diagnostics(previous);
+        return result->status;
+    }
+
+    /* First pass */
+    first_pass_result = first_pass(&expanded, &result->arena);
+    free_line_buffer(&expanded);
+    if (first_pass_result.errorFlag != NO_ERROR) {
+        report_message(stdout, "Error in first pass\n");
+        result->status = first_pass_result.errorFlag;
+
+        /* The second pass can still report unknown symbols */
+        if (result->status != ERR_MEMORY_ALLOCATION) {
+            check_program(&first_pass_result.program, &first_pass_result.symbolTable);
+        }
+    }
+
+    /* Second pass, into memory only */
+    if (result->status == NO_ERROR) {
+        result->status = encode_program(&first_pass_result.program, &first_pass_result.symbolTable, &result->image);
+        if (result->status != NO_ERROR) {
+            report_message(stdout, "Error in second pass\n");
+        }
+    }
+    if (result->status == NO_ERROR) {
+        result->data_count = result->image.data;
+        result->instruction_count = result->image.size - result->image.data;
+        result->status = collect_symbols(&first_pass_result.symbolTable, result);
+    }
+
+    free_ir_program(&first_pass_result.program);
+    free_symbol_table(&first_pass_result.symbolTable);
+    set_diagnostic_source(previous_source);
+    capture_diagnostics(previous);
+    return result->status;
+}
+
+int assemble_buffer(const char *source, size_t length, AssemblyResult *result) {
+    clear_result(result);
+    init_diagnostic_buffer(&result->diagnostics);
+    init_arena(&result->arena);
+    if (!init_binary_table(&result->image)) {
+        result->status = ERR_MEMORY_ALLOCATION;
+        return result->status;
+    }
+    return assemble_into(source, length, NULL, result);
+}
+
+int reassemble_buffer(const char *source, size_t length, const char *name, AssemblyResult *result) {
+    /* Keep the arena's largest block, the word table and the message buffer */
+    clear_result(result);
+    result->diagnostics.length = 0;
+    reset_arena(&result->arena);
+    result->image.size = 0;
+    result->image.data = 0;
+    if (result->image.words == NULL && !init_binary_table(&result->image)) {
+        result->status = ERR_MEMORY_ALLOCATION;
+        return result->status;
+    }
+    return assemble_into(source, length, name, result);
+}
+
+void free_assembly_result(AssemblyResult *result) {
+    free_binary_table(&result->image);
+    free_diagnostic_buffer(&result->diagnostics);
+    free_arena(&result->arena);
+    result->entries = NULL;
+    result->externs = NULL;
+    result->entry_count = 0;
+    result->extern_count = 0;
+}
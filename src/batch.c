@@ -0,0 +1,268 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "assembler.h"
+#include "arena.h"
+#include "cache.h"
+#include "utils.h"
+#include "error_handling.h"
+#include "trace.h"
+
+/*
+ * @struct BatchJob
+ * One input file and the result of assembling it.
+ */
+typedef struct {
+    const char *filename;            /* File name as given on the command line */
+    long size;                       /* Size of the source, used for scheduling */
+    int status;                      /* Result of assemble_file */
+    int done;                        /* Set once the file has been assembled */
+    DiagnosticBuffer diagnostics;    /* Messages reported while assembling */
+} BatchJob;
+
+/*
+ * @struct BatchQueue
+ * Work shared by the worker threads.
+ */
+typedef struct {
+    BatchJob **order;                /* Jobs, largest source first */
+    int count;                       /* Number of jobs */
+    int next;                        /* Next position in order to hand out */
+    int workers;                     /* Number of workers started so far */
+    const AssemblyOptions *options;  /* How to assemble each file */
+    BuildCache *cache;               /* Build cache, or NULL */
+    pthread_mutex_t lock;            /* Guards next and the done flags */
+    pthread_cond_t finished;         /* Signalled whenever a job is done */
+} BatchQueue;
+
+int default_job_count(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+/* Size of the source file a job will read, or 0 if it cannot be found */
+static long source_size(const char *filename) {
+    char *as_filename = replace_file_extension(filename, ".as");
+    struct stat info;
+    long size = 0;
+
+    if (as_filename != NULL && stat(as_filename, &info) == 0) {
+        size = (long)info.st_size;
+    }
+    free(as_filename);
+    return size;
+}
+
+/* Order jobs by decreasing size; ties keep command line order */
+static int compare_jobs(const void *a, const void *b) {
+    const BatchJob *first = *(BatchJob *const *)a;
+    const BatchJob *second = *(BatchJob *const *)b;
+
+    if (first->size != second->size) {
+        return first->size < second->size ? 1 : -1;
+    }
+    return first < second ? -1 : (first > second);
+}
+
+/* Assemble one file on its own trace track in the worker's group, unless the cache has it up to date */
+static int run_job(const char *filename, Arena *arena, const AssemblyOptions *options, BuildCache *cache, int worker) {
+    char source_hash[CACHE_HASH_TEXT];
+    char group_name[32];
+    double started;
+    int status;
+
+    sprintf(group_name, "worker %d", worker);
+    enter_trace_track(worker, group_name, filename);
+
+    started = trace_clock();
+    if (cache != NULL && check_build_cache(cache, filename, source_hash)) {
+        trace_span("cache_hit", started);
+        report_message(stdout, "Up to date: %s\n", filename);
+        return NO_ERROR;
+    }
+
+    status = assemble_file(filename, arena, options);
+    if (cache != NULL && status == NO_ERROR) {
+        record_build_cache(cache, filename, source_hash);
+    }
+    trace_span("assemble_file", started);
+    return status;
+}
+
+static void *batch_worker(void *argument) {
+    BatchQueue *queue = argument;
+    Arena arena;
+    BatchJob *job;
+    int worker;
+
+    init_arena(&arena);
+    pthread_mutex_lock(&queue->lock);
+    worker = ++queue->workers;
+    pthread_mutex_unlock(&queue->lock);
+
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        job = queue->next < queue->count ? queue->order[queue->next++] : NULL;
+        pthread_mutex_unlock(&queue->lock);
+        if (job == NULL) {
+            break;
+        }
+
+        capture_diagnostics(&job->diagnostics);
+        job->status = run_job(job->filename, &arena, queue->options, queue->cache, worker);
+        capture_diagnostics(NULL);
+        reset_arena(&arena);
+
+        pthread_mutex_lock(&queue->lock);
+        job->done = 1;
+        pthread_cond_broadcast(&queue->finished);
+        pthread_mutex_unlock(&queue->lock);
+    }
+    free_arena(&arena);
+    return NULL;
+}
+
+/* Assemble on the calling thread, printing each file's diagnostics once it is done */
+static void run_sequential(BatchJob *jobs, int count, const AssemblyOptions *options, BuildCache *cache) {
+    DiagnosticBuffer *previous;
+    Arena arena;
+    int i;
+
+    init_arena(&arena);
+    for (i = 0; i < count; i++) {
+        previous = capture_diagnostics(&jobs[i].diagnostics);
+        jobs[i].status = run_job(jobs[i].filename, &arena, options, cache, 1);
+        capture_diagnostics(previous);
+        flush_diagnostics(&jobs[i].diagnostics);
+        jobs[i].done = 1;
+        reset_arena(&arena);
+    }
+    free_arena(&arena);
+}
+
+/* Assemble on worker threads, printing each file's diagnostics in command line order */
+static int run_parallel(BatchJob *jobs, int count, int workers, const AssemblyOptions *options, BuildCache *cache) {
+    BatchQueue queue;
+    pthread_t *threads;
+    int started = 0;
+    int i;
+
+    queue.count = count;
+    queue.next = 0;
+    queue.workers = 0;
+    queue.options = options;
+    queue.cache = cache;
+    queue.order = malloc(sizeof(BatchJob *) * count);
+    threads = malloc(sizeof(pthread_t) * workers);
+    if (queue.order == NULL || threads == NULL) {
+        free(queue.order);
+        free(threads);
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        queue.order[i] = &jobs[i];
+        jobs[i].size = source_size(jobs[i].filename);
+    }
+    qsort(queue.order, count, sizeof(BatchJob *), compare_jobs);
+
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.finished, NULL);
+    while (started < workers && pthread_create(&threads[started], NULL, batch_worker, &queue) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        pthread_cond_destroy(&queue.finished);
+        pthread_mutex_destroy(&queue.lock);
+        free(queue.order);
+        free(threads);
+        return 0;
+    }
+
+    /* Print each file's diagnostics as soon as it and every file before it are done */
+    for (i = 0; i < count; i++) {
+        pthread_mutex_lock(&queue.lock);
+        while (!jobs[i].done) {
+            pthread_cond_wait(&queue.finished, &queue.lock);
+        }
+        pthread_mutex_unlock(&queue.lock);
+        flush_diagnostics(&jobs[i].diagnostics);
+    }
+
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_cond_destroy(&queue.finished);
+    pthread_mutex_destroy(&queue.lock);
+    free(queue.order);
+    free(threads);
+    return 1;
+}
+
+int assemble_files(char *const *filenames, int count, int jobs, const AssemblyOptions *options) {
+    BatchJob *batch = malloc(sizeof(BatchJob) * count);
+    BuildCache build_cache;
+    BuildCache *cache = NULL;
+    int workers = jobs < count ? jobs : count;
+    int status = NO_ERROR;
+    int failed = 0;
+    int i;
+
+    if (batch == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return ERR_MEMORY_ALLOCATION;
+    }
+    for (i = 0; i < count; i++) {
+        batch[i].filename = filenames[i];
+        batch[i].size = 0;
+        batch[i].status = NO_ERROR;
+        batch[i].done = 0;
+        init_diagnostic_buffer(&batch[i].diagnostics);
+    }
+
+    /* The cache does not know about .am and .obj files, so --write-am and --binary-object always assemble */
+    if (options->cache_directory != NULL && !options->write_am && !options->binary_object) {
+        if (open_build_cache(&build_cache, options->cache_directory) == NO_ERROR) {
+            cache = &build_cache;
+        } else {
+            fprintf(stderr, "Warning: Cannot use cache directory %s\n", options->cache_directory);
+        }
+    }
+
+    if (workers <= 1 || !run_parallel(batch, count, workers, options, cache)) {
+        run_sequential(batch, count, options, cache);
+    }
+
+    /* Summarize: the first failure decides the exit status */
+    for (i = 0; i < count; i++) {
+        if (batch[i].status != NO_ERROR) {
+            if (status == NO_ERROR) {
+                status = batch[i].status;
+            }
+            failed++;
+        }
+        free_diagnostic_buffer(&batch[i].diagnostics);
+    }
+    if (count > 1) {
+        for (i = 0; i < count; i++) {
+            if (batch[i].status != NO_ERROR) {
+                fprintf(stderr, "Failed: %s (error %d)\n", batch[i].filename, batch[i].status);
+            }
+        }
+        fprintf(stderr, "%d of %d files assembled\n", count - failed, count);
+    }
+    if (cache != NULL) {
+        fprintf(stderr, "Cache: %d hits, %d misses\n", cache->hits, cache->misses);
+        if (close_build_cache(cache) != NO_ERROR) {
+            fprintf(stderr, "Warning: Cannot save the cache manifest in %s\n", options->cache_directory);
+        }
+    }
+
+    free(batch);
+    return status;
+}
@@ -1,26 +1,56 @@
+#define _POSIX_C_SOURCE 200112L
+
 #include "binary_table.h"
 #include "error_handling.h"
 #include "line_parser.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "common.h"
 
-int decimalToOctal(int decimalNumber) {
-    int octalNumber = 0, placeValue = 1;
+/* "00" .. "99": two decimal digits per lookup */
+static const char decimal_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* "00" .. "77": two octal digits (six bits) per lookup */
+static const char octal_pairs[] =
+    "0001020304050607101112131415161720212223242526273031323334353637"
+    "4041424344454647505152535455565760616263646566677071727374757677";
+
+int format_object_line(char *out, int address, unsigned short value) {
+    /* Addresses wider than four digits are rare enough for the slow path */
+    if (address < 0 || address > 9999) {
+        return sprintf(out, "%04d %05o\n", address, value & 0x7FFF);
+    }
+
+    memcpy(out, &decimal_pairs[(address / 100) * 2], 2);
+    memcpy(out + 2, &decimal_pairs[(address % 100) * 2], 2);
+    out[4] = ' ';
+    out[5] = (char)('0' + ((value >> 12) & 07));
+    memcpy(out + 6, &octal_pairs[((value >> 6) & 077) * 2], 2);
+    memcpy(out + 8, &octal_pairs[(value & 077) * 2], 2);
+    out[10] = '\n';
+    return OBJECT_LINE_LENGTH;
+}
 
-    /* Convert a decimal number to octal */
-    while (decimalNumber > 0) {
-        int remainder = decimalNumber % 8;
-        octalNumber += remainder * placeValue;
-        decimalNumber /= 8;
-        placeValue *= 10;
+/* Write a whole buffer, retrying after short writes */
+static int write_all(int fd, const char *buffer, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, buffer, length);
+        if (written <= 0) {
+            return 0;
+        }
+        buffer += written;
+        length -= written;
     }
-
-    return octalNumber;
+    return 1;
 }
 
-void init_binary_table(BinaryTable *table) {
+int init_binary_table(BinaryTable *table) {
     table->size = 0;
     table->data = 0;
     table->capacity = 10;
@@ -29,8 +59,10 @@ void init_binary_table(BinaryTable *table) {
     table->words = malloc(sizeof(BinaryWord) * table->capacity);
     if (table->words == NULL) {
         report_error(ERR_MEMORY_ALLOCATION, 0);
-        exit(1);
+        table->capacity = 0;
+        return 0;
     }
+    return 1;
 }
 
 int add_binary_word(BinaryTable *table, int address, unsigned short value) {
@@ -55,37 +87,59 @@ int add_binary_word(BinaryTable *table, int address, unsigned short value) {
     return 1;
 }
 
-int write_binary_table_to_file(const BinaryTable *table, const char *filename, int ic, int dc) {
-    FILE *file = NULL;
+char *format_binary_table(const BinaryTable *table, size_t *length) {
+    char *buffer;
     int i;
-    int instruction_count = 0;
-    int data_count = 0;
+
+    /* Room for the header and the longest possible line per word */
+    buffer = malloc(OBJECT_HEADER_LENGTH + (size_t)table->size * OBJECT_LINE_MAX);
+    if (buffer == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return NULL;
+    }
+
+    /* Write IC (instruction count) and DC (data count) */
+    *length = sprintf(buffer, "%d %d\n", table->size - table->data, table->data);
+
+    /* Render every word into the buffer */
+    for (i = 0; i < table->size; i++) {
+        *length += format_object_line(buffer + *length, table->words[i].address, table->words[i].value);
+    }
+    return buffer;
+}
+
+int write_binary_table_to_file(const BinaryTable *table, const char *filename, int ic, int dc) {
+    char *buffer;
+    size_t length;
+    int fd;
+    int status;
 
     if (table->size == 0) {
         return 1;
     }
 
-    /* Open file for writing */
-    file = fopen(filename, "w");
-    if (file == NULL) {
-        fprintf(stderr, "Error opening file %s for writing\n", filename);
+    buffer = format_binary_table(table, &length);
+    if (buffer == NULL) {
         return 0;
     }
 
-    /* Calculate instruction and data counts */
-    data_count = table->data;
-    instruction_count = table->size - data_count;
-
-    /* Write IC (instruction count) and DC (data count) */
-    fprintf(file, "%d %d\n", instruction_count, data_count);
-
-    /* Write binary words to file */
-    for (i = 0; i < table->size; i++) {
-        fprintf(file, "%04d %05d\n", table->words[i].address, decimalToOctal(table->words[i].value));
+    /* Emit the whole file with a single write */
+    fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        report_message(stderr, "Error opening file %s for writing\n", filename);
+        free(buffer);
+        return 0;
+    }
+    status = write_all(fd, buffer, length);
+    if (close(fd) != 0) {
+        status = 0;
+    }
+    if (!status) {
+        report_message(stderr, "Error writing file %s\n", filename);
     }
 
-    fclose(file);
-    return 1;
+    free(buffer);
+    return status;
 }
 
 void free_binary_table(BinaryTable *table) {
@@ -106,105 +160,15 @@ int get_register_number(const char *value) {
     return value[1] - '0';
 }
 
-unsigned short assemble_instruction(const AssemblyLine *line, Symbol *symbol_table) {
-    unsigned short binary = 0;
-    int opcode;
-
-    if (!line || !line->instruction) {
-        fprintf(stderr, "Error: Invalid instruction line\n");
-        return 0;
-    }
-
-    /* Get opcode from instruction */
-    opcode = get_opcode(line->instruction);
-
-    /* Special case for "stop" instruction */
-    if (!strcmp(line->instruction, "stop")) {
-        return 30724;
-    }
-
-    /* Encode opcode */
-    binary |= (unsigned short)(opcode << 11);
-
-    /* Process operands */
-    if (line->srcOperand && line->destOperand) {
-        if (line->srcOperand) {
-            binary |= get_addressing_mode(line->srcOperand) << 7;
-        }
-        if (line->destOperand) {
-            binary |= get_addressing_mode(line->destOperand) << 3;
-        }
-    } else if (line->srcOperand) {
-        binary |= get_addressing_mode(line->srcOperand) << 3;
-    }
-
-    /* Set ARE bits (default to 4) */
-    binary |= 4;
-
-    return binary;
-}
-
-int get_are_value(const AssemblyLine *line, Symbol *symbol_table) {
-    /* Check if destination operand is an external symbol */
-    if (line->destOperand && find_symbol(line->destOperand->value, symbol_table) && symbol_table->type == SYMBOL_EXTERN) {
-        return 1;
-    }
-
-    /* Check if source operand is an external symbol */
-    if (line->srcOperand && find_symbol(line->srcOperand->value, symbol_table) && symbol_table->type == SYMBOL_EXTERN) {
-        return 1;
-    }
-
-    /* Check if destination operand is a regular symbol */
-    if (line->destOperand && find_symbol(line->destOperand->value, symbol_table)) {
-        return 2;
-    }
-
-    /* Default ARE value */
-    return 4;
-}
-
 int process_immediate_value(const char *value) {
     const char *num_start = value + 1; /* Skip '#' */
     int immediate_value = atoi(num_start);
 
     /* Warn if immediate value is out of range */
     if (immediate_value < -2048 || immediate_value > 2047) {
-        fprintf(stderr, "Warning: Immediate value %d out of range (-2048 to 2047). Truncating.\n", immediate_value);
+        report_message(stderr, "Warning: Immediate value %d out of range (-2048 to 2047). Truncating.\n", immediate_value);
         immediate_value &= 0xFFF; /* Truncate to 12 bits */
     }
 
     return immediate_value;
 }
-
-int get_addressing_mode(const Operand *operand) {
-    if (operand == NULL) {
-        return 0;
-    }
-
-    /* Determine addressing mode based on operand type */
-    switch (operand->type) {
-        case OPERAND_IMMEDIATE:
-            return 1;
-        case OPERAND_DIRECT:
-            return 2;
-        case OPERAND_INDIRECT_REGISTER:
-            return 4;
-        case OPERAND_REGISTER:
-            return 8;
-        default:
-            fprintf(stderr, "Error: Invalid operand type: %d\n", operand->type);
-            return -1;
-    }
-}
-
-int binary_instruction_to_int(BinaryInstruction instruction) {
-    /* Encode instruction as an integer */
-    return (instruction.opcode << 12) |
-           (instruction.source_register << 9) |
-           (instruction.source_addressing << 7) |
-           (instruction.target_register << 4) |
-           (instruction.target_addressing << 2) |
-           instruction.are;
-}
-
@@ -0,0 +1,357 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "cache.h"
+#include "assembler.h"
+#include "source.h"
+#include "utils.h"
+#include "error_handling.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+/* Longest manifest line accepted: version, four hashes and a path */
+#define MANIFEST_LINE 4096
+
+/* Extensions of the recorded outputs, in the order of CacheEntry.output_hashes */
+static const char *const OUTPUT_EXTENSIONS[CACHE_OUTPUTS] = {".ob", ".ent", ".ext"};
+
+/* Marks an output the source did not produce */
+static const char NO_OUTPUT[] = "-";
+
+/*
+ * Hash of a byte range as 16 hex digits: FNV-1a and sdbm side by side,
+ * 32 bits each, the second seeded with the length.
+ */
+static void hash_bytes(const char *text, size_t length, char *hash) {
+    unsigned long fnv = 2166136261UL;
+    unsigned long sdbm = (unsigned long)length & 0xFFFFFFFFUL;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        fnv = ((fnv ^ c) * 16777619UL) & 0xFFFFFFFFUL;
+        sdbm = (c + (sdbm << 6) + (sdbm << 16) - sdbm) & 0xFFFFFFFFUL;
+    }
+    sprintf(hash, "%08lx%08lx", fnv, sdbm);
+}
+
+/* Hash the contents of a file; returns 0 if it cannot be read */
+static int hash_file(const char *filename, char *hash) {
+    SourceFile file;
+
+    if (open_source(filename, &file) != NO_ERROR) {
+        return 0;
+    }
+    hash_bytes(file.text, file.length, hash);
+    close_source(&file);
+    return 1;
+}
+
+/* Name of an output of a source: the source without its extension, plus the output's */
+static char *output_filename(const char *filename, int output) {
+    char *base_name = remove_extension(filename);
+    char *name;
+
+    if (base_name == NULL) {
+        return NULL;
+    }
+    name = add_file_extension(base_name, OUTPUT_EXTENSIONS[output]);
+    free(base_name);
+    return name;
+}
+
+/* A path inside the cache directory */
+static char *cache_path(const BuildCache *cache, const char *name) {
+    char *path = malloc(strlen(cache->directory) + strlen(name) + 2);
+
+    if (path != NULL) {
+        sprintf(path, "%s/%s", cache->directory, name);
+    }
+    return path;
+}
+
+/* Place an entry into the first free slot of its probe sequence */
+static void insert_slot(int *slots, int capacity, const CacheEntry *entries, int index) {
+    int mask = capacity - 1;
+    int i = (int)(entries[index].hash & mask);
+
+    while (slots[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = index + 1;
+}
+
+/* Double the hash index, keeping the load factor at or below one half */
+static int grow_slots(BuildCache *cache) {
+    int new_capacity = cache->slot_capacity ? cache->slot_capacity * 2 : 64;
+    int *new_slots = calloc(new_capacity, sizeof(int));
+    int i;
+
+    if (new_slots == NULL) {
+        return 0;
+    }
+    for (i = 0; i < cache->count; i++) {
+        insert_slot(new_slots, new_capacity, cache->entries, i);
+    }
+    free(cache->slots);
+    cache->slots = new_slots;
+    cache->slot_capacity = new_capacity;
+    return 1;
+}
+
+/* Entry for a source path, or NULL if the manifest has none */
+static CacheEntry *find_entry(BuildCache *cache, const char *source) {
+    unsigned long hash;
+    int mask;
+    int i;
+
+    if (cache->count == 0) {
+        return NULL;
+    }
+
+    hash = hash_name(source, (int)strlen(source));
+    mask = cache->slot_capacity - 1;
+    for (i = (int)(hash & mask); cache->slots[i] != 0; i = (i + 1) & mask) {
+        CacheEntry *entry = &cache->entries[cache->slots[i] - 1];
+        if (entry->hash == hash && strcmp(entry->source, source) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* Add an entry for a source path with no hashes yet; returns NULL if allocation fails */
+static CacheEntry *add_entry(BuildCache *cache, const char *source) {
+    CacheEntry *entry;
+
+    if ((cache->count + 1) * 2 > cache->slot_capacity && !grow_slots(cache)) {
+        return NULL;
+    }
+    if (cache->count == cache->capacity) {
+        int new_capacity = cache->capacity ? cache->capacity * 2 : 16;
+        CacheEntry *new_entries = realloc(cache->entries, sizeof(CacheEntry) * new_capacity);
+        if (new_entries == NULL) {
+            return NULL;
+        }
+        cache->entries = new_entries;
+        cache->capacity = new_capacity;
+    }
+    entry = &cache->entries[cache->count];
+    entry->source = my_strdup(source);
+    if (entry->source == NULL) {
+        return NULL;
+    }
+    entry->hash = hash_name(source, (int)strlen(source));
+    insert_slot(cache->slots, cache->slot_capacity, cache->entries, cache->count);
+    cache->count++;
+    return entry;
+}
+
+/* Load the manifest; a missing manifest is an empty cache */
+static int load_manifest(BuildCache *cache) {
+    char *path = cache_path(cache, CACHE_MANIFEST);
+    char line[MANIFEST_LINE];
+    FILE *file;
+
+    if (path == NULL) {
+        return ERR_MEMORY_ALLOCATION;
+    }
+    file = fopen(path, "r");
+    free(path);
+    if (file == NULL) {
+        return NO_ERROR;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char version[64];
+        char hashes[CACHE_OUTPUTS + 1][CACHE_HASH_TEXT];
+        CacheEntry *entry;
+        int source_start = 0;
+        int i;
+
+        line[strcspn(line, "\n")] = '\0';
+        if (sscanf(line, "%63s %16s %16s %16s %16s %n", version, hashes[0], hashes[1], hashes[2], hashes[3],
+                   &source_start) < CACHE_OUTPUTS + 2 || source_start == 0) {
+            continue;
+        }
+        /* Outputs of another version may differ; those sources are assembled again */
+        if (strcmp(version, ASSEMBLER_VERSION) != 0 || find_entry(cache, line + source_start) != NULL) {
+            continue;
+        }
+        entry = add_entry(cache, line + source_start);
+        if (entry == NULL) {
+            fclose(file);
+            return ERR_MEMORY_ALLOCATION;
+        }
+        strcpy(entry->source_hash, hashes[0]);
+        for (i = 0; i < CACHE_OUTPUTS; i++) {
+            strcpy(entry->output_hashes[i], hashes[i + 1]);
+        }
+    }
+    fclose(file);
+    return NO_ERROR;
+}
+
+int open_build_cache(BuildCache *cache, const char *directory) {
+    int status;
+
+    cache->directory = my_strdup(directory);
+    cache->entries = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
+    cache->slots = NULL;
+    cache->slot_capacity = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->dirty = 0;
+    pthread_mutex_init(&cache->lock, NULL);
+
+    if (cache->directory == NULL) {
+        status = ERR_MEMORY_ALLOCATION;
+    } else if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+        status = ERR_FILE_ACCESS;
+    } else {
+        status = load_manifest(cache);
+    }
+    if (status != NO_ERROR) {
+        close_build_cache(cache);
+    }
+    return status;
+}
+
+/* Check that the outputs recorded for an entry are still there, unchanged */
+static int outputs_intact(const char *filename, const char (*output_hashes)[CACHE_HASH_TEXT]) {
+    char hash[CACHE_HASH_TEXT];
+    int intact = 1;
+    int i;
+
+    for (i = 0; i < CACHE_OUTPUTS && intact; i++) {
+        char *name;
+
+        /* An output that was not produced is not checked, just as it is not rewritten */
+        if (strcmp(output_hashes[i], NO_OUTPUT) == 0) {
+            continue;
+        }
+        name = output_filename(filename, i);
+        intact = name != NULL && hash_file(name, hash) && strcmp(hash, output_hashes[i]) == 0;
+        free(name);
+    }
+    return intact;
+}
+
+int check_build_cache(BuildCache *cache, const char *filename, char *source_hash) {
+    char *as_filename = replace_file_extension(filename, ".as");
+    char output_hashes[CACHE_OUTPUTS][CACHE_HASH_TEXT];
+    int found = 0;
+    int hit = 0;
+
+    strcpy(source_hash, NO_OUTPUT);
+    if (as_filename != NULL && hash_file(as_filename, source_hash)) {
+        const CacheEntry *entry;
+
+        /* Copy the entry so the outputs are hashed without holding the lock */
+        pthread_mutex_lock(&cache->lock);
+        entry = find_entry(cache, filename);
+        if (entry != NULL && strcmp(entry->source_hash, source_hash) == 0) {
+            memcpy(output_hashes, entry->output_hashes, sizeof(output_hashes));
+            found = 1;
+        }
+        pthread_mutex_unlock(&cache->lock);
+
+        hit = found && outputs_intact(filename, (const char (*)[CACHE_HASH_TEXT])output_hashes);
+    }
+    free(as_filename);
+
+    pthread_mutex_lock(&cache->lock);
+    if (hit) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return hit;
+}
+
+void record_build_cache(BuildCache *cache, const char *filename, const char *source_hash) {
+    char output_hashes[CACHE_OUTPUTS][CACHE_HASH_TEXT];
+    CacheEntry *entry;
+    int i;
+
+    /* A source that could not be read has nothing to record */
+    if (strcmp(source_hash, NO_OUTPUT) == 0) {
+        return;
+    }
+
+    for (i = 0; i < CACHE_OUTPUTS; i++) {
+        char *name = output_filename(filename, i);
+
+        if (name == NULL || !hash_file(name, output_hashes[i])) {
+            strcpy(output_hashes[i], NO_OUTPUT);
+        }
+        free(name);
+    }
+
+    /* Every clean assembly writes a .ob file; without it there is nothing to reuse */
+    if (strcmp(output_hashes[0], NO_OUTPUT) == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    entry = find_entry(cache, filename);
+    if (entry == NULL) {
+        entry = add_entry(cache, filename);
+    }
+    if (entry != NULL) {
+        strcpy(entry->source_hash, source_hash);
+        memcpy(entry->output_hashes, output_hashes, sizeof(output_hashes));
+        cache->dirty = 1;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/* Write the manifest to a temporary file and move it into place */
+static int save_manifest(const BuildCache *cache) {
+    char *path = cache_path(cache, CACHE_MANIFEST);
+    char *temporary = cache_path(cache, CACHE_MANIFEST ".tmp");
+    FILE *file = NULL;
+    int status = ERR_FILE_ACCESS;
+    int i;
+
+    if (path != NULL && temporary != NULL) {
+        file = fopen(temporary, "w");
+    }
+    if (file != NULL) {
+        for (i = 0; i < cache->count; i++) {
+            const CacheEntry *entry = &cache->entries[i];
+            fprintf(file, "%s %s %s %s %s %s\n", ASSEMBLER_VERSION, entry->source_hash,
+                    entry->output_hashes[0], entry->output_hashes[1], entry->output_hashes[2], entry->source);
+        }
+        if (fclose(file) == 0 && rename(temporary, path) == 0) {
+            status = NO_ERROR;
+        } else {
+            remove(temporary);
+        }
+    }
+    free(path);
+    free(temporary);
+    return status;
+}
+
+int close_build_cache(BuildCache *cache) {
+    int status = NO_ERROR;
+    int i;
+
+    if (cache->dirty) {
+        status = save_manifest(cache);
+    }
+    pthread_mutex_destroy(&cache->lock);
+    for (i = 0; i < cache->count; i++) {
+        free(cache->entries[i].source);
+    }
+    free(cache->entries);
+    free(cache->slots);
+    free(cache->directory);
+    return status;
+}
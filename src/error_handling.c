@@ -1,102 +1,461 @@
+#define _XOPEN_SOURCE 600
+
 #include "error_handling.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
 
-void report_error(ErrorCode error, int line_number) {
-    /* Handle different error cases */
+/* Tags stored in front of each captured message */
+#define TAG_STDOUT '1'
+#define TAG_STDERR '2'
+#define TAG_DIAGNOSTIC '3'
+
+/* Severities of a diagnostic record */
+#define SEVERITY_ERROR 'E'
+#define SEVERITY_WARNING 'W'
+
+/* Longest message text kept */
+#define MAX_MESSAGE_LENGTH 512
+
+/*
+ * @struct Diagnostic
+ * A diagnostic record read back from a buffer (or about to be printed).
+ * The file and message point into the record text.
+ */
+typedef struct {
+    char severity;           /* SEVERITY_ERROR or SEVERITY_WARNING */
+    int code;                /* ErrorCode of an error, 0 for a warning */
+    int line;                /* Line number, 0 if none */
+    int column;              /* Column from 1, 0 if unknown */
+    const char *file;        /* File name, not null-terminated */
+    int file_length;         /* Length of the file name, 0 if none */
+    const char *message;     /* Null-terminated message */
+    size_t order;            /* Position in the buffer, to keep sorting stable */
+} Diagnostic;
+
+/* Per-thread capture target and source name; unset means print directly and no name */
+static pthread_key_t capture_key;
+static pthread_key_t source_key;
+static pthread_once_t capture_once = PTHREAD_ONCE_INIT;
+
+/* How diagnostics are printed; set once before any worker starts */
+static DiagnosticFormat diagnostic_format = DIAGNOSTICS_TEXT;
+static int diagnostic_max_errors = 0;
+
+static void create_capture_key(void) {
+    pthread_key_create(&capture_key, NULL);
+    pthread_key_create(&source_key, NULL);
+}
+
+void init_diagnostic_buffer(DiagnosticBuffer *buffer) {
+    buffer->text = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+DiagnosticBuffer *capture_diagnostics(DiagnosticBuffer *buffer) {
+    DiagnosticBuffer *previous;
+
+    pthread_once(&capture_once, create_capture_key);
+    previous = pthread_getspecific(capture_key);
+    pthread_setspecific(capture_key, buffer);
+    return previous;
+}
+
+void configure_diagnostics(DiagnosticFormat format, int max_errors) {
+    diagnostic_format = format;
+    diagnostic_max_errors = max_errors > 0 ? max_errors : 0;
+}
+
+const char *set_diagnostic_source(const char *name) {
+    const char *previous;
+
+    pthread_once(&capture_once, create_capture_key);
+    previous = pthread_getspecific(source_key);
+    pthread_setspecific(source_key, (void *)name);
+    return previous;
+}
+
+/* Append one tagged entry; returns 0 if it could not be stored */
+static int append_entry(DiagnosticBuffer *buffer, char tag, const char *text, size_t length) {
+    size_t needed = buffer->length + length + 2;
+
+    if (needed > buffer->capacity) {
+        size_t new_capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        char *new_text;
+        while (new_capacity < needed) {
+            new_capacity *= 2;
+        }
+        new_text = realloc(buffer->text, new_capacity);
+        if (new_text == NULL) {
+            return 0;
+        }
+        buffer->text = new_text;
+        buffer->capacity = new_capacity;
+    }
+
+    buffer->text[buffer->length++] = tag;
+    memcpy(buffer->text + buffer->length, text, length);
+    buffer->length += length;
+    buffer->text[buffer->length++] = '\0';
+    return 1;
+}
+
+/* Append one formatted message; returns 0 if it could not be stored */
+static int append_message(DiagnosticBuffer *buffer, FILE *stream, const char *format, va_list args) {
+    char message[MAX_MESSAGE_LENGTH];
+    int length = vsnprintf(message, sizeof(message), format, args);
+
+    if (length < 0) {
+        return 0;
+    }
+    if (length >= (int)sizeof(message)) {
+        length = sizeof(message) - 1;
+    }
+    return append_entry(buffer, (stream == stderr) ? TAG_STDERR : TAG_STDOUT, message, length);
+}
+
+void report_message(FILE *stream, const char *format, ...) {
+    DiagnosticBuffer *buffer;
+    va_list args;
+
+    pthread_once(&capture_once, create_capture_key);
+    buffer = pthread_getspecific(capture_key);
+
+    va_start(args, format);
+    if (buffer == NULL || !append_message(buffer, stream, format, args)) {
+        va_end(args);
+        va_start(args, format);
+        vfprintf(stream, format, args);
+    }
+    va_end(args);
+}
+
+/* Write a string as a JSON string literal */
+static void print_json_string(FILE *stream, const char *text, int length) {
+    int i;
+
+    fputc('"', stream);
+    for (i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            fputc('\\', stream);
+            fputc(c, stream);
+        } else if (c < 0x20) {
+            fprintf(stream, "\\u%04x", c);
+        } else {
+            fputc(c, stream);
+        }
+    }
+    fputc('"', stream);
+}
+
+/* Print one diagnostic in the configured format */
+static void print_diagnostic(const Diagnostic *diagnostic) {
+    const char *severity = diagnostic->severity == SEVERITY_WARNING ? "warning" :
+                           diagnostic->severity == SEVERITY_ERROR ? "error" : "note";
+
+    if (diagnostic_format == DIAGNOSTICS_JSON) {
+        fputs("{\"file\":", stderr);
+        if (diagnostic->file_length > 0) {
+            print_json_string(stderr, diagnostic->file, diagnostic->file_length);
+        } else {
+            fputs("null", stderr);
+        }
+        fprintf(stderr, ",\"line\":%d,\"column\":%d,\"severity\":\"%s\",\"code\":%d,\"message\":",
+                diagnostic->line, diagnostic->column, severity, diagnostic->code);
+        print_json_string(stderr, diagnostic->message, strlen(diagnostic->message));
+        fputs("}\n", stderr);
+        return;
+    }
+
+    /* file:line:column, or "line N" for source that has no file name */
+    if (diagnostic->file_length > 0) {
+        fprintf(stderr, "%.*s:", diagnostic->file_length, diagnostic->file);
+    } else if (diagnostic->line > 0) {
+        fputs("line ", stderr);
+    }
+    if (diagnostic->line > 0) {
+        fprintf(stderr, "%d:", diagnostic->line);
+        if (diagnostic->column > 0) {
+            fprintf(stderr, "%d:", diagnostic->column);
+        }
+    }
+    fprintf(stderr, "%s%s: %s\n", diagnostic->file_length > 0 || diagnostic->line > 0 ? " " : "",
+            severity, diagnostic->message);
+}
+
+/* Capture or print a diagnostic about the current source */
+static void record_diagnostic(char severity, int code, int line_number, int column, const char *format, va_list args) {
+    DiagnosticBuffer *buffer;
+    const char *source;
+    char message[MAX_MESSAGE_LENGTH];
+    char record[MAX_MESSAGE_LENGTH + 64 + MAX_MESSAGE_LENGTH];
+    int length;
+
+    pthread_once(&capture_once, create_capture_key);
+    buffer = pthread_getspecific(capture_key);
+    source = pthread_getspecific(source_key);
+
+    if (vsnprintf(message, sizeof(message), format, args) < 0) {
+        message[0] = '\0';
+    }
+
+    /* Severity, code, line and column, then the file and the message after tabs */
+    length = snprintf(record, sizeof(record), "%c %d %d %d\t%.*s\t%s", severity, code, line_number, column,
+                      MAX_MESSAGE_LENGTH, source ? source : "", message);
+    if (length >= (int)sizeof(record)) {
+        length = sizeof(record) - 1;
+    }
+    if (buffer == NULL || length < 0 || !append_entry(buffer, TAG_DIAGNOSTIC, record, length)) {
+        Diagnostic diagnostic;
+
+        diagnostic.severity = severity;
+        diagnostic.code = code;
+        diagnostic.line = line_number;
+        diagnostic.column = column;
+        diagnostic.file = source;
+        diagnostic.file_length = source ? strlen(source) : 0;
+        diagnostic.message = message;
+        diagnostic.order = 0;
+        print_diagnostic(&diagnostic);
+    }
+}
+
+void report_diagnostic(ErrorCode error, int line_number, int column, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    record_diagnostic(SEVERITY_ERROR, error, line_number, column, format, args);
+    va_end(args);
+}
+
+void report_warning(int line_number, int column, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    record_diagnostic(SEVERITY_WARNING, NO_ERROR, line_number, column, format, args);
+    va_end(args);
+}
+
+/* Read a diagnostic record back; the text is what follows its tag */
+static void parse_diagnostic(const char *text, size_t order, Diagnostic *diagnostic) {
+    char *end;
+    const char *tab;
+
+    diagnostic->severity = text[0];
+    diagnostic->code = (int)strtol(text + 1, &end, 10);
+    diagnostic->line = (int)strtol(end, &end, 10);
+    diagnostic->column = (int)strtol(end, &end, 10);
+    diagnostic->file = *end == '\t' ? end + 1 : end;
+    tab = strchr(diagnostic->file, '\t');
+    diagnostic->file_length = tab ? (int)(tab - diagnostic->file) : 0;
+    diagnostic->message = tab ? tab + 1 : "";
+    diagnostic->order = order;
+}
+
+/* Order by file, line, column, severity, code and message; equal ones are duplicates */
+static int compare_diagnostic_keys(const Diagnostic *first, const Diagnostic *second) {
+    int length = first->file_length < second->file_length ? first->file_length : second->file_length;
+    int result = memcmp(first->file, second->file, length);
+
+    if (result != 0 || first->file_length != second->file_length) {
+        return result != 0 ? result : first->file_length - second->file_length;
+    }
+    if (first->line != second->line) {
+        return first->line < second->line ? -1 : 1;
+    }
+    if (first->column != second->column) {
+        return first->column < second->column ? -1 : 1;
+    }
+    if (first->severity != second->severity) {
+        return first->severity < second->severity ? -1 : 1;
+    }
+    if (first->code != second->code) {
+        return first->code < second->code ? -1 : 1;
+    }
+    return strcmp(first->message, second->message);
+}
+
+static int compare_diagnostics(const void *a, const void *b) {
+    const Diagnostic *first = a;
+    const Diagnostic *second = b;
+    int result = compare_diagnostic_keys(first, second);
+
+    if (result != 0) {
+        return result;
+    }
+    return first->order < second->order ? -1 : (first->order > second->order);
+}
+
+/* Print the diagnostics of a buffer sorted, without duplicates and up to the error limit */
+static void print_diagnostics(const DiagnosticBuffer *buffer) {
+    Diagnostic *diagnostics;
+    Diagnostic note;
+    char message[64];
+    size_t count = 0;
+    size_t i = 0;
+    size_t n;
+    int errors = 0;
+    int omitted = 0;
+
+    while (i < buffer->length) {
+        count += buffer->text[i] == TAG_DIAGNOSTIC;
+        i += strlen(buffer->text + i + 1) + 2;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    diagnostics = malloc(sizeof(Diagnostic) * count);
+    count = 0;
+    for (i = 0; i < buffer->length; i += strlen(buffer->text + i + 1) + 2) {
+        if (buffer->text[i] != TAG_DIAGNOSTIC) {
+            continue;
+        }
+        if (diagnostics == NULL) {
+            /* No room to sort: print them as they came */
+            Diagnostic diagnostic;
+            parse_diagnostic(buffer->text + i + 1, 0, &diagnostic);
+            print_diagnostic(&diagnostic);
+        } else {
+            parse_diagnostic(buffer->text + i + 1, count, &diagnostics[count]);
+            count++;
+        }
+    }
+    if (diagnostics == NULL) {
+        return;
+    }
+
+    qsort(diagnostics, count, sizeof(Diagnostic), compare_diagnostics);
+    for (n = 0; n < count; n++) {
+        if (n > 0 && compare_diagnostic_keys(&diagnostics[n - 1], &diagnostics[n]) == 0) {
+            continue;
+        }
+        if (diagnostic_max_errors > 0 && errors >= diagnostic_max_errors) {
+            omitted += diagnostics[n].severity == SEVERITY_ERROR;
+            continue;
+        }
+        errors += diagnostics[n].severity == SEVERITY_ERROR;
+        print_diagnostic(&diagnostics[n]);
+    }
+
+    if (omitted > 0) {
+        sprintf(message, "%d more error%s not shown", omitted, omitted == 1 ? "" : "s");
+        note.severity = 'N';
+        note.code = NO_ERROR;
+        note.line = 0;
+        note.column = 0;
+        note.file = diagnostics[0].file;
+        note.file_length = diagnostics[0].file_length;
+        note.message = message;
+        note.order = 0;
+        print_diagnostic(&note);
+    }
+    free(diagnostics);
+}
+
+void flush_diagnostics(DiagnosticBuffer *buffer) {
+    size_t i = 0;
+
+    print_diagnostics(buffer);
+    while (i < buffer->length) {
+        FILE *stream = (buffer->text[i] == TAG_STDERR) ? stderr : stdout;
+        const char *message = buffer->text + i + 1;
+        if (buffer->text[i] != TAG_DIAGNOSTIC) {
+            fputs(message, stream);
+        }
+        i += strlen(message) + 2;
+    }
+    fflush(stdout);
+    buffer->length = 0;
+}
+
+void free_diagnostic_buffer(DiagnosticBuffer *buffer) {
+    free(buffer->text);
+    init_diagnostic_buffer(buffer);
+}
+
+/* Standard message of an error code */
+static const char *error_message(ErrorCode error) {
     switch (error) {
         case ERR_FILE_ACCESS:
-            fprintf(stderr, "Error on line %d: File access error\n", line_number);
-            break;
+            return "File access error";
 
         case ERR_MEMORY_ALLOCATION:
-            fprintf(stderr, "Error on line %d: Memory allocation failed\n", line_number);
-            exit(1); /* Memory allocation failure is critical */
-            break;
+            /* The caller unwinds; exiting here would take every other file down with it */
+            return "Memory allocation failed";
 
         case ERR_MACRO_NAME_ERROR:
-            fprintf(stderr, "Error on line %d: Macro name error\n", line_number);
-            break;
+            return "Macro name error";
 
         case ERR_INSTRUCTION_INVALID:
-            fprintf(stderr, "Error on line %d: Invalid instruction\n", line_number);
-            break;
+            return "Invalid instruction";
 
         case ERR_SYMBOL_DUPLICATE:
-            fprintf(stderr, "Error on line %d: Duplicate symbol\n", line_number);
-            break;
+            return "Duplicate symbol";
 
         case ERR_SYMBOL_SYNTAX:
-            fprintf(stderr, "Error on line %d: Symbol syntax is wrong\n", line_number);
-            break;
+            return "Symbol syntax is wrong";
 
         case ERR_SYMBOL_LENGTH:
-            fprintf(stderr, "Error on line %d: Symbol too long\n", line_number);
-            break;
+            return "Symbol too long";
 
         case ERR_SYMBOL_OPCODE:
-            fprintf(stderr, "Error on line %d: Symbol name is an opcode\n", line_number);
-            break;
+            return "Symbol name is an opcode";
 
         case ERR_SYMBOL_REGISTER:
-            fprintf(stderr, "Error on line %d: Symbol name is a register\n", line_number);
-            break;
+            return "Symbol name is a register";
 
         case ERR_SYMBOL_MACRO:
-            fprintf(stderr, "Error on line %d: Symbol name is a macro\n", line_number);
-            break;
+            return "Symbol name is a macro";
 
         case ERR_DATA_SYNTAX:
-            fprintf(stderr, "Error on line %d: Invalid data directive syntax\n", line_number);
-            break;
+            return "Invalid data directive syntax";
 
         case ERR_MEMORY_OVERFLOW:
-            fprintf(stderr, "Error on line %d: Memory overflow\n", line_number);
-            break;
+            return "Memory overflow";
 
         case ERR_DIRECTIVE_UNDEFINED:
-            fprintf(stderr, "Error on line %d: Undefined directive\n", line_number);
-            break;
+            return "Undefined directive";
 
         case ERR_STRING_SYNTAX:
-            fprintf(stderr, "Error on line %d: Invalid string syntax\n", line_number);
-            break;
+            return "Invalid string syntax";
 
         case ERR_OPERANDS_INSUFFICIENT:
-            fprintf(stderr, "Error on line %d: Not enough operands\n", line_number);
-            break;
+            return "Not enough operands";
 
         case ERR_OPERAND_EMPTY:
-            fprintf(stderr, "Error on line %d: Operand is empty\n", line_number);
-            break;
+            return "Operand is empty";
 
         case ERR_INTEGER_INVALID:
-            fprintf(stderr, "Error on line %d: Invalid integer\n", line_number);
-            break;
+            return "Invalid integer";
 
         case ERR_OPERANDS_TOO_MANY:
-            fprintf(stderr, "Error on line %d: Too many operands\n", line_number);
-            break;
+            return "Too many operands";
 
         case ERR_MIUN_MISMATCH:
-            fprintf(stderr, "Error on line %d: Miun types do not match\n", line_number);
-            break;
+            return "Miun types do not match";
 
         case ERR_SYMBOL_SHORT:
-            fprintf(stderr, "Error on line %d: Symbol name too short\n", line_number);
-            break;
+            return "Symbol name too short";
 
         case ERR_SYMBOL_NOT_FOUND:
-            fprintf(stderr, "Error on line %d: Symbol not found\n", line_number);
-            break;
+            return "Symbol not found";
 
         case ERR_INVALID_OPERAND:
-            fprintf(stderr, "Error on line %d: Invalid operand\n", line_number);
-            break;
+            return "Invalid operand";
+
+        case ERR_LINE_TOO_LONG:
+            return "Line too long";
 
         default:
-            fprintf(stderr, "Unknown error occurred on line %d\n", line_number);
-            break;
+            return "Unknown error";
     }
 }
 
+void report_error(ErrorCode error, int line_number) {
+    report_diagnostic(error, line_number, 0, "%s", error_message(error));
+}
@@ -4,199 +4,196 @@
 #include "error_handling.h"
 #include "line_parser.h"
 #include "utils.h"
+#include "trace.h"
 #include <stdio.h>
 #include <string.h>
 
-FirstPassResult first_pass(const char* filename) {
-    FirstPassResult result;
-    FILE *file;
-    char am_filename[MAX_FILE_NAME];
-    char line[MAX_LINE_LENGTH];
-    int line_number = 0;
-    int status;
-    int flag = 0;
-    AssemblyLine parsed_line;
-
-    /* Initialize result variables */
-    result.symbolTable = NULL;
-    result.memoryCounters.instructionCounter = 100;
-    result.memoryCounters.dataCounter = 0;
-    result.errorFlag = NO_ERROR;
-
-    /* Check if filename length is within buffer limit and create .am filename */
-    if (strlen(filename) + 3 < sizeof(am_filename)) {
-        sprintf(am_filename, "%s.am", filename);
-    } else {
-        fprintf(stderr, "Filename too long to fit in buffer\n");
-    }
-
-    /* Try to open .am file, if not found, open the original file */
-    file = fopen(am_filename, "r");
-    if (file == NULL) {
-        printf("Error: Could not open .am file, trying original file: %s\n", filename);
-        file = fopen(filename, "r");
-        if (file == NULL) {
-            printf("Error: Could not open file %s\n", filename);
-            result.errorFlag = ERR_FILE_ACCESS;
-            return result;
-        }
-    }
+void begin_first_pass(FirstPassResult *result, Arena *arena) {
+    init_symbol_table(&result->symbolTable, arena);
+    result->memoryCounters.instructionCounter = 100;
+    result->memoryCounters.dataCounter = 0;
+    result->errorFlag = NO_ERROR;
+    init_ir_program(&result->program);
+}
 
-    /* Process each line in the file */
-    while (fgets(line, sizeof(line), file) != NULL) {
-        line_number++;
-        parsed_line = parse_assembly_line(line, line_number, 1);
+int first_pass_line(FirstPassResult *result, const char *line, int line_number, int *parse_error) {
+    AssemblyLine parsed_line = parse_assembly_line(line, line_number, 1);
 
-        if (parsed_line.error) {
-            flag = 1;
-        }
+    if (parsed_line.error) {
+        *parse_error = 1;
+    }
 
-        status = process_line_first_pass(&parsed_line, &result.memoryCounters.instructionCounter, 
-            &result.memoryCounters.dataCounter, &result.symbolTable, line_number);
+    return process_line_first_pass(&parsed_line, &result->memoryCounters.instructionCounter, 
+        &result->memoryCounters.dataCounter, &result->symbolTable, &result->program, line_number);
+}
 
-        if (status != NO_ERROR) {
-            free_assembly_line(&parsed_line);
-            result.errorFlag = status;
-            break;
-        }
+void end_first_pass(FirstPassResult *result, int parse_error) {
+    /* Update addresses of data symbols */
+    update_data_symbols(&result->symbolTable, result->memoryCounters.instructionCounter);
+    result->memoryCounters.dataCounter += result->memoryCounters.instructionCounter - 100;
 
-        free_assembly_line(&parsed_line);
+    /* Set error flag if the only errors were parse errors */
+    if (parse_error && result->errorFlag == NO_ERROR) {
+        result->errorFlag = 1;
     }
+}
 
-    /* Update addresses of data symbols */
-    update_data_symbols(result.symbolTable, result.memoryCounters.instructionCounter);
-    result.memoryCounters.dataCounter += result.memoryCounters.instructionCounter - 100;
+FirstPassResult first_pass(const LineBuffer *source, Arena *arena) {
+    FirstPassResult result;
+    int index;
+    int status;
+    int flag = 0;
+    double started = trace_clock();
 
-    fclose(file);
+    begin_first_pass(&result, arena);
 
-    /* Set error flag if any errors were encountered */
-    if (flag) {
-        result.errorFlag = 1;
+    /* Process each line of the expanded source; a bad line is reported and the pass goes on */
+    for (index = 0; index < source->count; index++) {
+        status = first_pass_line(&result, get_line(source, index), get_line_number(source, index), &flag);
+        if (status != NO_ERROR && result.errorFlag == NO_ERROR) {
+            result.errorFlag = status;
+        }
+        if (status == ERR_MEMORY_ALLOCATION) {
+            break;
+        }
     }
 
+    end_first_pass(&result, flag);
+    trace_span("first_pass", started);
     return result;
 }
 
-int process_line_first_pass(const AssemblyLine *line, int *ic, int *dc, Symbol **symbol_table, int line_number) {
+int process_line_first_pass(const AssemblyLine *line, int *ic, int *dc, SymbolTable *symbol_table, IrProgram *program, int line_number) {
     int status = NO_ERROR;
     int is_data_line;
+    char label[MAX_LINE_LENGTH];
 
     /* Check if the line has a label and handle it */
-    if (line->label) {
-        is_data_line = (line->instruction && (strcmp(line->instruction, ".data") == 0 || strcmp(line->instruction, ".string") == 0));
-        status = handle_label_first_pass(line->label, is_data_line ? *dc : *ic, is_data_line, line_number, symbol_table);
+    if (line->label.length) {
+        is_data_line = (line->keyword && (line->keyword->directive == DIRECTIVE_DATA || line->keyword->directive == DIRECTIVE_STRING));
+        copy_span(label, &line->label, sizeof(label));
+        status = handle_label_first_pass(label, is_data_line ? *dc : *ic, is_data_line, line_number, symbol_table);
         if (status != NO_ERROR) {
             return status;
         }
     }
 
-    /* Handle directives or instructions */
-    if (line->instruction && line->instruction[0] == '.') {
-        status = handle_directive_first_pass(line, dc, symbol_table, line_number);
-    } else if (line->instruction) {
-        status = handle_instruction_first_pass(line, ic);
-    }
+    /* Every failure below reports itself, with the line and column it refers to */
 
-    if (status != NO_ERROR) {
-        printf("Error processing line %d: %d\n", line_number, status);
+    /* Handle directives or instructions */
+    if (line->instruction.length && line->instruction.start[0] == '.') {
+        status = handle_directive_first_pass(line, dc, symbol_table, program, line_number);
+    } else if (line->instruction.length) {
+        status = handle_instruction_first_pass(line, ic, program, line_number);
     }
 
     return status;
 }
 
-int handle_label_first_pass(const char *label, int address, int is_data_line, int line, Symbol **symbol_table) {
+int handle_label_first_pass(const char *label, int address, int is_data_line, int line, SymbolTable *symbol_table) {
     Symbol *existing;
 
     /* Check if the label length is valid */
     if (strlen(label) > MAX_LABEL_LEN) {
-        printf("Error: Label too long\n");
+        report_diagnostic(ERR_SYMBOL_LENGTH, line, 1, "Label too long: %s", label);
         return ERR_SYMBOL_LENGTH;
     }
 
     /* Check if the label already exists */
-    existing = find_symbol(label, *symbol_table);
+    existing = find_symbol(label, symbol_table);
     if (existing) {
-        printf("Error: Duplicate symbol\n");
+        report_diagnostic(ERR_SYMBOL_DUPLICATE, line, 1, "Duplicate symbol %s, first defined on line %d", label, existing->line);
         return ERR_SYMBOL_DUPLICATE;
     }
 
     /* Check if the label is an opcode */
     if (check_if_opcode(label)) {
-        printf("Error Line %d: %s is restricted name\n", line, label);
-        return 1;
+        report_diagnostic(ERR_SYMBOL_OPCODE, line, 1, "%s is restricted name", label);
+        return ERR_SYMBOL_OPCODE;
     }
 
     /* Add the symbol to the symbol table */
     if (!add_symbol(symbol_table, label, address, SYMBOL_LABEL, is_data_line, line)) {
-        printf("Error: Failed to add symbol\n");
+        report_diagnostic(ERR_MEMORY_ALLOCATION, line, 1, "Failed to add symbol %s", label);
         return ERR_MEMORY_ALLOCATION;
     }
 
     return NO_ERROR;
 }
 
-int handle_directive_first_pass(const AssemblyLine *line, int *dc, Symbol **symbol_table, int line_number) {
-    const char *operand_value = line->srcOperand ? line->srcOperand->value : NULL;
+int handle_directive_first_pass(const AssemblyLine *line, int *dc, SymbolTable *symbol_table, IrProgram *program, int line_number) {
+    char operand_value[MAX_LINE_LENGTH];
+    int count;
+
+    switch (line->keyword ? line->keyword->directive : DIRECTIVE_NONE) {
+        case DIRECTIVE_DATA:
+        case DIRECTIVE_STRING:
+            /* Parse the values once and add their count to the data counter */
+            count = add_ir_data(program, line, line_number);
+            if (count < 0) {
+                return ERR_DATA_SYNTAX;
+            }
+            *dc += count;
+            break;
+
+        case DIRECTIVE_EXTERN:
+            return handle_extern_directive(line, symbol_table, line_number);
 
-    if (strcmp(line->instruction, DATA_DIRECTIVE) == 0) {
-        /* Count the number of values in the data directive */
-        int count = 0;
-        int i;
-        for (i = 0; line->original[i] != '\0'; i++) {
-            if (line->original[i] == ',') {
-                count++;
+        case DIRECTIVE_ENTRY:
+            if (line->operand_count == 0) {
+                report_diagnostic(ERR_INVALID_OPERAND, line_number, span_column(line, &line->instruction),
+                                  "Entry directive without operand");
+                return ERR_INVALID_OPERAND;
             }
-        }
-        *dc += count + 1;
-    } else if (strcmp(line->instruction, STRING_DIRECTIVE) == 0) {
-        /* Add string length to data counter */
-        if (operand_value) {
-            *dc += strlen(operand_value) - 2;
-        }
-    } else if (strcmp(line->instruction, EXTERN_DIRECTIVE) == 0) {
-        return handle_extern_directive(line, symbol_table, line_number);
-    } else if (strcmp(line->instruction, ENTRY_DIRECTIVE) == 0) {
-        return NO_ERROR;
-    } else {
-        return ERR_DIRECTIVE_UNDEFINED;
+            copy_span(operand_value, &line->srcOperand.value, sizeof(operand_value));
+            if (!add_ir_entry(program, operand_value, line_number, span_column(line, &line->srcOperand.value))) {
+                return ERR_MEMORY_ALLOCATION;
+            }
+            break;
+
+        default:
+            report_diagnostic(ERR_DIRECTIVE_UNDEFINED, line_number, span_column(line, &line->instruction),
+                              "Undefined directive %.*s", line->instruction.length, line->instruction.start);
+            return ERR_DIRECTIVE_UNDEFINED;
     }
 
     return NO_ERROR;
 }
 
-int handle_instruction_first_pass(const AssemblyLine *line, int *ic) {
-    (*ic)++; /* Increment for the opcode word */
-
-    /* Handle source operand */
-    if (line->srcOperand) {
-        if (line->srcOperand->type == OPERAND_IMMEDIATE || line->srcOperand->type == OPERAND_DIRECT || line->srcOperand->type == OPERAND_REGISTER) {
-            (*ic)++;
-        }
-    }
-
-    /* Handle destination operand */
-    if (line->destOperand) {
-        if (line->destOperand->type == OPERAND_IMMEDIATE || line->destOperand->type == OPERAND_DIRECT || line->srcOperand->type == OPERAND_REGISTER) {
-            (*ic)++;
-        }
+int handle_instruction_first_pass(const AssemblyLine *line, int *ic, IrProgram *program, int line_number) {
+    /* The IR records how many words the second pass will emit */
+    int words = add_ir_instruction(program, line, line_number);
+    if (words == 0) {
+        return ERR_INSTRUCTION_INVALID;
     }
 
+    *ic += words;
     return NO_ERROR;
 }
 
-int handle_extern_directive(const AssemblyLine *line, Symbol **symbol_table, int line_number) {
-    const char *symbol_name = line->srcOperand->value;
-    Symbol *existing_symbol = find_symbol(symbol_name, *symbol_table);
+int handle_extern_directive(const AssemblyLine *line, SymbolTable *symbol_table, int line_number) {
+    char symbol_name[MAX_LINE_LENGTH];
+    Symbol *existing_symbol;
+
+    if (line->operand_count == 0) {
+        report_diagnostic(ERR_INVALID_OPERAND, line_number, span_column(line, &line->instruction),
+                          "Extern directive without operand");
+        return ERR_INVALID_OPERAND;
+    }
+    copy_span(symbol_name, &line->srcOperand.value, sizeof(symbol_name));
+    existing_symbol = find_symbol(symbol_name, symbol_table);
 
     /* Check if the symbol already exists */
     if (existing_symbol != NULL) {
-        printf("Warning: Symbol %s already exists in symbol table with address: %d\n", symbol_name, existing_symbol->address);
+        report_warning(line_number, span_column(line, &line->srcOperand.value),
+                       "Symbol %s already exists in symbol table with address: %d", symbol_name, existing_symbol->address);
         return NO_ERROR;
     }
 
     /* Add the external symbol */
     if (!add_symbol(symbol_table, symbol_name, 0, SYMBOL_EXTERN, 0, line_number)) {
-        printf("Error: Failed to add extern symbol: %s\n", symbol_name);
+        report_diagnostic(ERR_MEMORY_ALLOCATION, line_number, span_column(line, &line->srcOperand.value),
+                          "Failed to add extern symbol: %s", symbol_name);
         return ERR_MEMORY_ALLOCATION;
     }
 
@@ -212,13 +209,15 @@ int count_data_values(const char *data_string) {
     return count;
 }
 
-void update_data_symbols(Symbol *symbol_table, int IC) {
-    Symbol *current = symbol_table;
+void update_data_symbols(SymbolTable *symbol_table, int IC) {
+    Symbol *current = symbol_table->head;
+    double started = trace_clock();
     while (current != NULL) {
         if (current->is_data_line) {
             current->address += IC; /* Update data symbol address */
         }
         current = current->next;
     }
+    trace_span("update_data_symbols", started);
 }
 
@@ -0,0 +1,152 @@
+#include "instruction_table.h"
+#include "error_handling.h"
+#include <stddef.h>
+
+/* Field positions of the first word */
+#define OPCODE_SHIFT 11
+#define SOURCE_MODE_SHIFT 7
+#define TARGET_MODE_SHIFT 3
+
+/* Register fields of an operand word */
+#define SOURCE_REGISTER_SHIFT 6
+#define TARGET_REGISTER_SHIFT 3
+
+/* ARE value of words that need no relocation */
+#define ARE_ABSOLUTE 4
+
+/* Addressing mode bits of each slot, as encoded in the first word */
+static const int MODE_BITS[OPERAND_SLOTS] = {0, 1, 2, 4, 8};
+
+int operand_slot(OperandType type) {
+    return (int)type + 1;
+}
+
+/* Slots of the operands of an instruction line */
+static int source_slot(const IrLine *line) {
+    return line->operand_count == 2 ? operand_slot(line->src.type) : OPERAND_SLOT_NONE;
+}
+
+static int target_slot(const IrLine *line) {
+    return line->operand_count > 0 ? operand_slot(line->dest.type) : OPERAND_SLOT_NONE;
+}
+
+/* The first word: opcode, addressing modes and ARE */
+static unsigned short first_word(const IrLine *line) {
+    return (unsigned short)((line->opcode << OPCODE_SHIFT) | (MODE_BITS[source_slot(line)] << SOURCE_MODE_SHIFT) |
+                            (MODE_BITS[target_slot(line)] << TARGET_MODE_SHIFT) | ARE_ABSOLUTE);
+}
+
+/* The word of one operand; register fields depend on the operand's position */
+static int operand_word(const IrOperand *operand, int register_shift, int index, unsigned short *words,
+                        DirectOperandEncoder direct, void *context) {
+    switch (operand->type) {
+        case OPERAND_IMMEDIATE:
+            words[index] = (unsigned short)((operand->value & 0x1FFF) << 3 | ARE_ABSOLUTE);
+            return NO_ERROR;
+        case OPERAND_DIRECT:
+            return direct(context, operand, index, &words[index]);
+        case OPERAND_INDIRECT_REGISTER:
+        case OPERAND_REGISTER:
+            words[index] = (unsigned short)(operand->value << register_shift | ARE_ABSOLUTE);
+            return NO_ERROR;
+        default:
+            return ERR_INVALID_OPERAND;
+    }
+}
+
+/* No operands: the first word alone */
+static int encode_bare(const IrLine *line, unsigned short *words, DirectOperandEncoder direct, void *context) {
+    (void)direct;
+    (void)context;
+    words[0] = first_word(line);
+    return NO_ERROR;
+}
+
+/* One operand, the destination */
+static int encode_target(const IrLine *line, unsigned short *words, DirectOperandEncoder direct, void *context) {
+    words[0] = first_word(line);
+    return operand_word(&line->dest, TARGET_REGISTER_SHIFT, 1, words, direct, context);
+}
+
+/* Two operands, one word each */
+static int encode_source_target(const IrLine *line, unsigned short *words, DirectOperandEncoder direct,
+                                void *context) {
+    int status;
+
+    words[0] = first_word(line);
+    status = operand_word(&line->src, SOURCE_REGISTER_SHIFT, 1, words, direct, context);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    return operand_word(&line->dest, TARGET_REGISTER_SHIFT, 2, words, direct, context);
+}
+
+/* Two register operands sharing one word */
+static int encode_register_pair(const IrLine *line, unsigned short *words, DirectOperandEncoder direct,
+                                void *context) {
+    (void)direct;
+    (void)context;
+    words[0] = first_word(line);
+    words[1] = (unsigned short)((line->src.value << SOURCE_REGISTER_SHIFT) |
+                                (line->dest.value << TARGET_REGISTER_SHIFT) | ARE_ABSOLUTE);
+    return NO_ERROR;
+}
+
+/* Slot bits of the addressing mode sets below */
+#define ACCEPTS_NONE 0x01
+#define ACCEPTS_IMMEDIATE 0x02
+#define ACCEPTS_DIRECT 0x04
+#define ACCEPTS_INDIRECT 0x08
+#define ACCEPTS_REGISTER 0x10
+#define ACCEPTS_ANY (ACCEPTS_IMMEDIATE | ACCEPTS_DIRECT | ACCEPTS_INDIRECT | ACCEPTS_REGISTER)
+#define ACCEPTS_WRITABLE (ACCEPTS_DIRECT | ACCEPTS_INDIRECT | ACCEPTS_REGISTER)
+#define ACCEPTS_JUMP (ACCEPTS_DIRECT | ACCEPTS_INDIRECT)
+
+/* A form with source slot s and destination slot d, legal if both sets accept them */
+#define FORM(source, target, s, d, words, encoder) {((source) >> (s)) & ((target) >> (d)) & 1, words, encoder}
+
+/*
+ * The forms of an opcode whose source accepts the slots in source and whose
+ * destination accepts the slots in target. A source without a destination
+ * never occurs, since a lone operand is the destination.
+ */
+#define FORMS(source, target) {                                                                   \
+    {FORM(source, target, 0, 0, 1, encode_bare), FORM(source, target, 0, 1, 2, encode_target),    \
+     FORM(source, target, 0, 2, 2, encode_target), FORM(source, target, 0, 3, 2, encode_target),  \
+     FORM(source, target, 0, 4, 2, encode_target)},                                              \
+    {FORM(source, target, 1, 0, 1, encode_bare), FORM(source, target, 1, 1, 3, encode_source_target), \
+     FORM(source, target, 1, 2, 3, encode_source_target), FORM(source, target, 1, 3, 3, encode_source_target), \
+     FORM(source, target, 1, 4, 3, encode_source_target)},                                        \
+    {FORM(source, target, 2, 0, 1, encode_bare), FORM(source, target, 2, 1, 3, encode_source_target), \
+     FORM(source, target, 2, 2, 3, encode_source_target), FORM(source, target, 2, 3, 3, encode_source_target), \
+     FORM(source, target, 2, 4, 3, encode_source_target)},                                        \
+    {FORM(source, target, 3, 0, 1, encode_bare), FORM(source, target, 3, 1, 3, encode_source_target), \
+     FORM(source, target, 3, 2, 3, encode_source_target), FORM(source, target, 3, 3, 2, encode_register_pair), \
+     FORM(source, target, 3, 4, 2, encode_register_pair)},                                        \
+    {FORM(source, target, 4, 0, 1, encode_bare), FORM(source, target, 4, 1, 3, encode_source_target), \
+     FORM(source, target, 4, 2, 3, encode_source_target), FORM(source, target, 4, 3, 2, encode_register_pair), \
+     FORM(source, target, 4, 4, 2, encode_register_pair)}                                         \
+}
+
+const InstructionForm INSTRUCTION_FORMS[OPCODE_COUNT][OPERAND_SLOTS][OPERAND_SLOTS] = {
+    FORMS(ACCEPTS_ANY, ACCEPTS_WRITABLE),       /* mov */
+    FORMS(ACCEPTS_ANY, ACCEPTS_ANY),            /* cmp */
+    FORMS(ACCEPTS_ANY, ACCEPTS_WRITABLE),       /* add */
+    FORMS(ACCEPTS_ANY, ACCEPTS_WRITABLE),       /* sub */
+    FORMS(ACCEPTS_DIRECT, ACCEPTS_WRITABLE),    /* lea */
+    FORMS(ACCEPTS_NONE, ACCEPTS_WRITABLE),      /* clr */
+    FORMS(ACCEPTS_NONE, ACCEPTS_WRITABLE),      /* not */
+    FORMS(ACCEPTS_NONE, ACCEPTS_WRITABLE),      /* inc */
+    FORMS(ACCEPTS_NONE, ACCEPTS_WRITABLE),      /* dec */
+    FORMS(ACCEPTS_NONE, ACCEPTS_JUMP),          /* jmp */
+    FORMS(ACCEPTS_NONE, ACCEPTS_JUMP),          /* bne */
+    FORMS(ACCEPTS_NONE, ACCEPTS_WRITABLE),      /* red */
+    FORMS(ACCEPTS_NONE, ACCEPTS_ANY),           /* prn */
+    FORMS(ACCEPTS_NONE, ACCEPTS_JUMP),          /* jsr */
+    FORMS(ACCEPTS_NONE, ACCEPTS_NONE),          /* rts */
+    FORMS(ACCEPTS_NONE, ACCEPTS_NONE)           /* stop */
+};
+
+const InstructionForm *get_instruction_form(const IrLine *line) {
+    return &INSTRUCTION_FORMS[line->opcode][source_slot(line)][target_slot(line)];
+}
@@ -0,0 +1,325 @@
+#include "ir.h"
+#include "binary_table.h"
+#include "instruction_table.h"
+#include "error_handling.h"
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* Make room for one more IR line */
+static IrLine *new_ir_line(IrProgram *program) {
+    IrLine *temp;
+
+    if (program->count >= program->capacity) {
+        int new_capacity = program->capacity ? program->capacity * 2 : 64;
+        temp = realloc(program->lines, sizeof(IrLine) * new_capacity);
+        if (temp == NULL) {
+            report_error(ERR_MEMORY_ALLOCATION, 0);
+            return NULL;
+        }
+        program->lines = temp;
+        program->capacity = new_capacity;
+    }
+
+    memset(&program->lines[program->count], 0, sizeof(IrLine));
+    return &program->lines[program->count++];
+}
+
+/* Append a value to the data pool */
+static int add_data_value(IrProgram *program, int value) {
+    int *temp;
+
+    if (program->data_count >= program->data_capacity) {
+        int new_capacity = program->data_capacity ? program->data_capacity * 2 : 64;
+        temp = realloc(program->data, sizeof(int) * new_capacity);
+        if (temp == NULL) {
+            report_error(ERR_MEMORY_ALLOCATION, 0);
+            return 0;
+        }
+        program->data = temp;
+        program->data_capacity = new_capacity;
+    }
+
+    program->data[program->data_count++] = value;
+    return 1;
+}
+
+/* Append a name to the name pool and return its offset, or -1 on failure */
+static int add_name(IrProgram *program, const char *name) {
+    int size = strlen(name) + 1;
+    int offset;
+    char *temp;
+
+    if (program->names_length + size > program->names_capacity) {
+        int new_capacity = program->names_capacity ? program->names_capacity : 256;
+        while (program->names_length + size > new_capacity) {
+            new_capacity *= 2;
+        }
+        temp = realloc(program->names, new_capacity);
+        if (temp == NULL) {
+            report_error(ERR_MEMORY_ALLOCATION, 0);
+            return -1;
+        }
+        program->names = temp;
+        program->names_capacity = new_capacity;
+    }
+
+    offset = program->names_length;
+    memcpy(program->names + offset, name, size);
+    program->names_length += size;
+    return offset;
+}
+
+/* Decode an operand token into an IR operand */
+static int decode_operand(IrProgram *program, const AssemblyLine *line, const Operand *operand, IrOperand *result) {
+    char text[MAX_LINE_LENGTH];
+
+    copy_span(text, &operand->value, sizeof(text));
+    if (text[0] == '\0') {
+        return ERR_OPERAND_EMPTY;
+    }
+
+    result->type = operand->type;
+    result->column = span_column(line, &operand->value);
+    switch (operand->type) {
+        case OPERAND_IMMEDIATE:
+            result->value = process_immediate_value(text);
+            break;
+        case OPERAND_INDIRECT_REGISTER:
+        case OPERAND_REGISTER:
+            result->value = get_register_number(text);
+            break;
+        case OPERAND_DIRECT:
+            result->value = add_name(program, text);
+            if (result->value < 0) {
+                return ERR_MEMORY_ALLOCATION;
+            }
+            break;
+        default:
+            return ERR_INVALID_OPERAND;
+    }
+    return NO_ERROR;
+}
+
+void init_ir_program(IrProgram *program) {
+    memset(program, 0, sizeof(IrProgram));
+}
+
+int add_ir_instruction(IrProgram *program, const AssemblyLine *line, int line_number) {
+    const InstructionForm *form;
+    const Operand *operand = NULL;
+    IrLine *ir_line;
+    int status = NO_ERROR;
+
+    if (line->keyword == NULL || line->keyword->opcode < 0) {
+        report_diagnostic(ERR_INSTRUCTION_INVALID, line_number, span_column(line, &line->instruction),
+                          "Invalid instruction %.*s", line->instruction.length, line->instruction.start);
+        return 0;
+    }
+
+    ir_line = new_ir_line(program);
+    if (ir_line == NULL) {
+        return 0;
+    }
+    ir_line->kind = IR_INSTRUCTION;
+    ir_line->line_number = line_number;
+    ir_line->opcode = line->keyword->opcode;
+
+    /* A lone operand is the destination; with two, the first is the source */
+    if (line->operand_count == 2) {
+        ir_line->operand_count = 2;
+        status = decode_operand(program, line, &line->srcOperand, &ir_line->src);
+        operand = &line->srcOperand;
+        if (status == NO_ERROR) {
+            status = decode_operand(program, line, &line->destOperand, &ir_line->dest);
+            operand = &line->destOperand;
+        }
+    } else if (line->operand_count == 1) {
+        ir_line->operand_count = 1;
+        status = decode_operand(program, line, &line->srcOperand, &ir_line->dest);
+        operand = &line->srcOperand;
+    }
+
+    if (status != NO_ERROR) {
+        /* A failed allocation was reported where it happened */
+        if (status != ERR_MEMORY_ALLOCATION) {
+            report_diagnostic(status, line_number, span_column(line, &operand->value), "%s",
+                              status == ERR_OPERAND_EMPTY ? "Operand is empty" : "Invalid operand");
+        }
+        program->count--;
+        return 0;
+    }
+
+    /*
+     * The opcode must accept the addressing modes; the form gives the size.
+     * A wrong operand count was already reported by the parser.
+     */
+    form = get_instruction_form(ir_line);
+    if (!form->legal && !line->error) {
+        report_diagnostic(ERR_MIUN_MISMATCH, line_number, span_column(line, &line->operands),
+                          "Miun types do not match for %.*s", line->instruction.length, line->instruction.start);
+        program->count--;
+        return 0;
+    }
+    ir_line->word_count = form->word_count;
+
+    return ir_line->word_count;
+}
+
+int add_ir_data(IrProgram *program, const AssemblyLine *line, int line_number) {
+    const char *text = line->instruction.start + line->instruction.length;
+    IrLine *ir_line;
+    int start = program->data_count;
+
+    if (line->keyword->directive == DIRECTIVE_STRING) {
+        const char *open = strchr(text, '"');
+        const char *close = strrchr(text, '"');
+
+        if (open == NULL || close == open) {
+            report_diagnostic(ERR_STRING_SYNTAX, line_number, span_column(line, &line->operands), "Invalid string syntax");
+            return -1;
+        }
+        for (open++; open < close; open++) {
+            if (!add_data_value(program, (unsigned char)*open)) {
+                return -1;
+            }
+        }
+        if (!add_data_value(program, 0)) {
+            return -1;
+        }
+    } else {
+        /* Values are separated by commas; each one must be present */
+        while (1) {
+            const char *comma = strchr(text, ',');
+            const char *end = comma ? comma : text + strlen(text);
+            const char *p = text;
+
+            while (p < end && isspace((unsigned char)*p)) {
+                p++;
+            }
+            if (p == end) {
+                report_diagnostic(ERR_DATA_SYNTAX, line_number, (int)(p - line->original) + 1,
+                                  "Invalid data directive syntax: missing value");
+                return -1;
+            }
+            if (!add_data_value(program, atoi(p))) {
+                return -1;
+            }
+            if (comma == NULL) {
+                break;
+            }
+            text = comma + 1;
+        }
+    }
+
+    ir_line = new_ir_line(program);
+    if (ir_line == NULL) {
+        return -1;
+    }
+    ir_line->kind = IR_DATA;
+    ir_line->line_number = line_number;
+    ir_line->payload = start;
+    ir_line->word_count = program->data_count - start;
+    return ir_line->word_count;
+}
+
+int add_ir_entry(IrProgram *program, const char *name, int line_number, int column) {
+    IrLine *ir_line;
+    int offset;
+
+    offset = add_name(program, name);
+    if (offset < 0) {
+        return 0;
+    }
+
+    ir_line = new_ir_line(program);
+    if (ir_line == NULL) {
+        return 0;
+    }
+    ir_line->kind = IR_ENTRY;
+    ir_line->line_number = line_number;
+    ir_line->payload = offset;
+    ir_line->column = column;
+    return 1;
+}
+
+/* Grow an array so that it holds at least the needed number of elements */
+static int reserve(void **array, int *capacity, int needed, size_t element_size) {
+    int new_capacity = *capacity ? *capacity : 64;
+    void *temp;
+
+    if (needed <= *capacity) {
+        return 1;
+    }
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    temp = realloc(*array, element_size * new_capacity);
+    if (temp == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return 0;
+    }
+    *array = temp;
+    *capacity = new_capacity;
+    return 1;
+}
+
+int append_ir_program(IrProgram *program, const IrProgram *other) {
+    void *lines = program->lines;
+    void *data = program->data;
+    void *names = program->names;
+    int data_base = program->data_count;
+    int names_base = program->names_length;
+    int ok;
+    int i;
+
+    ok = reserve(&lines, &program->capacity, program->count + other->count, sizeof(IrLine));
+    program->lines = lines;
+    ok = ok && reserve(&data, &program->data_capacity, program->data_count + other->data_count, sizeof(int));
+    program->data = data;
+    ok = ok && reserve(&names, &program->names_capacity, program->names_length + other->names_length, 1);
+    program->names = names;
+    if (!ok) {
+        return 0;
+    }
+
+    /* Copy the pools, then the lines with their pool offsets rebased */
+    if (other->data_count) {
+        memcpy(program->data + data_base, other->data, sizeof(int) * other->data_count);
+    }
+    if (other->names_length) {
+        memcpy(program->names + names_base, other->names, other->names_length);
+    }
+    program->data_count += other->data_count;
+    program->names_length += other->names_length;
+
+    for (i = 0; i < other->count; i++) {
+        IrLine *line = &program->lines[program->count++];
+        *line = other->lines[i];
+        if (line->kind == IR_DATA) {
+            line->payload += data_base;
+        } else if (line->kind == IR_ENTRY) {
+            line->payload += names_base;
+        } else {
+            if (line->src.type == OPERAND_DIRECT) {
+                line->src.value += names_base;
+            }
+            if (line->dest.type == OPERAND_DIRECT) {
+                line->dest.value += names_base;
+            }
+        }
+    }
+    return 1;
+}
+
+const char *get_ir_name(const IrProgram *program, int offset) {
+    return program->names + offset;
+}
+
+void free_ir_program(IrProgram *program) {
+    free(program->lines);
+    free(program->data);
+    free(program->names);
+    init_ir_program(program);
+}
@@ -0,0 +1,62 @@
+#include "keywords.h"
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Perfect hash over the 16 opcodes and 4 directives:
+ *   (15 * name[0] + 26 * name[1] + 5 * name[2] + length) mod 32
+ * The multipliers were found by exhaustive search so that every keyword
+ * lands in its own slot; a single compare confirms the match.
+ */
+#define KEYWORD_TABLE_SIZE 32
+
+static const Keyword KEYWORD_TABLE[KEYWORD_TABLE_SIZE] = {
+    {".entry", 6, -1, -1, DIRECTIVE_ENTRY},   /*  0 */
+    {"jsr", 3, 13, 1, DIRECTIVE_NONE},        /*  1 */
+    {"clr", 3, 5, 1, DIRECTIVE_NONE},         /*  2 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /*  3 */
+    {".data", 5, -1, -1, DIRECTIVE_DATA},     /*  4 */
+    {"inc", 3, 7, 1, DIRECTIVE_NONE},         /*  5 */
+    {"bne", 3, 10, 1, DIRECTIVE_NONE},        /*  6 */
+    {"red", 3, 11, 1, DIRECTIVE_NONE},        /*  7 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /*  8 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /*  9 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /* 10 */
+    {".string", 7, -1, -1, DIRECTIVE_STRING}, /* 11 */
+    {"sub", 3, 3, 2, DIRECTIVE_NONE},         /* 12 */
+    {"prn", 3, 12, 1, DIRECTIVE_NONE},        /* 13 */
+    {"add", 3, 2, 2, DIRECTIVE_NONE},         /* 14 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /* 15 */
+    {"dec", 3, 8, 1, DIRECTIVE_NONE},         /* 16 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /* 17 */
+    {"cmp", 3, 1, 2, DIRECTIVE_NONE},         /* 18 */
+    {".extern", 7, -1, -1, DIRECTIVE_EXTERN}, /* 19 */
+    {"stop", 4, 15, 0, DIRECTIVE_NONE},       /* 20 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /* 21 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /* 22 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /* 23 */
+    {"rts", 3, 14, 0, DIRECTIVE_NONE},        /* 24 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /* 25 */
+    {"mov", 3, 0, 2, DIRECTIVE_NONE},         /* 26 */
+    {"jmp", 3, 9, 1, DIRECTIVE_NONE},         /* 27 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /* 28 */
+    {NULL, 0, -1, -1, DIRECTIVE_NONE},        /* 29 */
+    {"lea", 3, 4, 2, DIRECTIVE_NONE},         /* 30 */
+    {"not", 3, 6, 1, DIRECTIVE_NONE}          /* 31 */
+};
+
+const Keyword *lookup_keyword(const char *name, int length) {
+    const unsigned char *word = (const unsigned char *)name;
+    const Keyword *keyword;
+
+    /* Every keyword is between 3 and 7 characters long */
+    if (length < 3 || length > 7) {
+        return NULL;
+    }
+
+    keyword = &KEYWORD_TABLE[(15u * word[0] + 26u * word[1] + 5u * word[2] + (unsigned)length) % KEYWORD_TABLE_SIZE];
+    if (keyword->length != length || memcmp(keyword->name, name, length) != 0) {
+        return NULL;
+    }
+    return keyword;
+}
@@ -1,7 +1,8 @@
 #include "line_parser.h"
 #include <string.h>
-#include <stdlib.h>
+#include "error_handling.h"
 #include <stdio.h>
+#include <ctype.h>
 #include "utils.h"
 
 /* Define the opcodes and their corresponding attributes */
@@ -27,23 +28,23 @@ int get_operand(int opcode) {
 
 /* Get the opcode index for a given instruction name */
 int get_opcode(const char* instruction) {
-    size_t i;
-    for (i = 0; i < OPCODES_COUNT; i++) {
-        if (strcmp(instruction, OPCODES[i].name) == 0) {
-            return i;
-        }
+    const Keyword *keyword = lookup_keyword(instruction, strlen(instruction));
+    if (keyword == NULL || keyword->opcode < 0) {
+        return -1; /* Invalid instruction */
     }
-    return -1; /* Invalid instruction */
+    return keyword->opcode;
 }
 
 /* Determine the type of operand based on its syntax */
-OperandType determine_operand_type(const char *operand) {
-    if (operand[0] == '#') {
+OperandType determine_operand_type(const Span *operand) {
+    const char *text = operand->start;
+
+    if (text[0] == '#') {
         return OPERAND_IMMEDIATE;
-    } else if (operand[0] == '*') {
+    } else if (text[0] == '*') {
         return OPERAND_INDIRECT_REGISTER;
-    } else if (operand[0] == 'r') {
-        int reg_num = operand[1] - '0';
+    } else if (text[0] == 'r' && operand->length == 2) {
+        int reg_num = text[1] - '0';
         if (reg_num >= r0 && reg_num <= r7) {
             return OPERAND_REGISTER;
         }
@@ -51,142 +52,141 @@ OperandType determine_operand_type(const char *operand) {
     return OPERAND_DIRECT;
 }
 
+/* Skip spaces, tabs and line terminators */
+static const char *skip_spaces(const char *text) {
+    while (*text && isspace((unsigned char)*text)) {
+        text++;
+    }
+    return text;
+}
+
+/* Set a span, dropping trailing whitespace */
+static void set_span(Span *span, const char *start, const char *end) {
+    while (end > start && isspace((unsigned char)end[-1])) {
+        end--;
+    }
+    span->start = start;
+    span->length = end - start;
+}
+
+void copy_span(char *destination, const Span *span, int size) {
+    int length = span->length < size - 1 ? span->length : size - 1;
+
+    if (length > 0) {
+        memcpy(destination, span->start, length);
+    } else {
+        length = 0;
+    }
+    destination[length] = '\0';
+}
+
 /* Parse a line of assembly code */
 AssemblyLine parse_assembly_line(const char* line, int line_number, int pass) {
     AssemblyLine result;
-    char* line_copy, *token;
-    int opcode = 0;
+    const char *p, *end;
     int operand = 0;
-    result.error = 0;
+    int extra = 0;
 
     memset(&result, 0, sizeof(AssemblyLine));
+    result.original = line;
+    p = skip_spaces(line);
 
-    /* Create copies of the line */
-    line_copy = (char*)malloc(strlen(line) + 1);
-    result.original = (char*)malloc(strlen(line) + 1);
-    if (!line_copy) {
-        return result;
+    /* Check if the first word contains a label */
+    end = p;
+    while (*end && !isspace((unsigned char)*end) && *end != ':') {
+        end++;
     }
-
-    strcpy(line_copy, line);
-    strcpy(result.original, line);
-
-    /* Check if the line contains a label */
-    token = strtok(line_copy, ":");
-    if (token && strchr(line, ':')) {
-        result.label = (char*)malloc(strlen(token) + 1);
-        if (result.label) {
-            strcpy(result.label, token);
-        }
-        token = strtok(NULL, " \t\n");
-
-        /* If the token is null and we are in the first pass, it's an empty label */
-        if (!token && pass) {
-            fprintf(stderr, "Error line %d: %s is an empty label\n", line_number, result.label);
+    if (*end == ':') {
+        set_span(&result.label, p, end);
+        p = skip_spaces(end + 1);
+
+        /* If nothing follows the label and we are in the first pass, it's an empty label */
+        if (*p == '\0' && pass) {
+            report_diagnostic(ERR_SYMBOL_SYNTAX, line_number, span_column(&result, &result.label),
+                              "%.*s is an empty label", result.label.length, result.label.start);
             result.error = 1;
         }
-    } else {
-        token = strtok(line_copy, " \t\n");
     }
 
-    /* Process the instruction and operands */
-    if (token) {
-        result.instruction = (char*)malloc(strlen(token) + 1);
-        if (result.instruction) {
-            strcpy(result.instruction, token);
-        }
-
-        opcode = get_opcode(result.instruction);
-        operand = get_operand(opcode);
-        token = strtok(NULL, ",");
+    if (*p == '\0') {
+        return result;
+    }
 
-        /* Validate operand counts */
-        if (operand == 0 && token && pass) {
-            fprintf(stderr, "Error line %d: Additional Operands\n", line_number);
-            result.error = 1;
-        } else if (operand == 2 && !token && pass) {
-            fprintf(stderr, "Error line %d: Missing Operand 1\n", line_number);
-            result.error = 1;
-        } else if (operand == 1 && !token && pass) {
-            fprintf(stderr, "Error line %d: Missing Operand\n", line_number);
-            result.error = 1;
+    /* Process the instruction and classify it once; directives take no fixed operand count */
+    end = p;
+    while (*end && !isspace((unsigned char)*end)) {
+        end++;
+    }
+    set_span(&result.instruction, p, end);
+    result.keyword = lookup_keyword(result.instruction.start, result.instruction.length);
+    operand = result.keyword ? result.keyword->operands : -1;
+
+    p = skip_spaces(end);
+    set_span(&result.operands, p, p + strlen(p));
+
+    /* The first operand runs up to the comma */
+    if (*p) {
+        end = p;
+        while (*end && *end != ',') {
+            end++;
         }
-
-        /* Parse the source operand */
-        if (token) {
-            result.srcOperand = (Operand*)malloc(sizeof(Operand));
-            if (result.srcOperand) {
-                result.srcOperand->value = (char*)malloc(strlen(token) + 1);
-                if (result.srcOperand->value) {
-                    strcpy(result.srcOperand->value, token);
-                }
-                result.srcOperand->type = determine_operand_type(token);
+        set_span(&result.srcOperand.value, p, end);
+        result.srcOperand.type = determine_operand_type(&result.srcOperand.value);
+        result.operand_count = 1;
+
+        /* The second operand is the next word after the comma */
+        if (*end == ',') {
+            p = skip_spaces(end + 1);
+            end = p;
+            while (*end && *end != ',' && !isspace((unsigned char)*end)) {
+                end++;
             }
-
-            token = strtok(NULL, " \t\n");
-
-            /* Check for additional operands where not expected */
-            if (operand == 1 && token && pass) {
-                fprintf(stderr, "Error line %d: Additional Operands\n", line_number);
-                result.error = 1;
-            } else if (operand == 2 && !token && pass) {
-                fprintf(stderr, "Error line %d: Missing Operand 2\n", line_number);
-                result.error = 1;
-            }
-
-            /* Parse the destination operand */
-            if (token) {
-                result.destOperand = (Operand*)malloc(sizeof(Operand));
-                if (result.destOperand) {
-                    result.destOperand->value = (char*)malloc(strlen(token) + 1);
-                    if (result.destOperand->value) {
-                        strcpy(result.destOperand->value, token);
-                    }
-                    result.destOperand->type = determine_operand_type(token);
-                }
+            if (end > p) {
+                set_span(&result.destOperand.value, p, end);
+                result.destOperand.type = determine_operand_type(&result.destOperand.value);
+                result.operand_count = 2;
             }
+            extra = *skip_spaces(end) != '\0';
+        }
+    }
 
-            token = strtok(NULL, " \t\n");
-
-            /* Handle case with extra operands in two-operand instructions */
-            if (operand == 2 && token && pass) {
-                fprintf(stderr, "Error line %d: Additional Operands\n", line_number);
-                result.error = 1;
-            }
+    /* Validate operand counts */
+    if (pass) {
+        if (operand == 0 && result.operand_count > 0) {
+            report_diagnostic(ERR_OPERANDS_TOO_MANY, line_number, span_column(&result, &result.srcOperand.value), "Additional Operands");
+            result.error = 1;
+        } else if (operand == 2 && result.operand_count == 0) {
+            report_diagnostic(ERR_OPERANDS_INSUFFICIENT, line_number, span_column(&result, &result.instruction), "Missing Operand 1");
+            result.error = 1;
+        } else if (operand == 1 && result.operand_count == 0) {
+            report_diagnostic(ERR_OPERANDS_INSUFFICIENT, line_number, span_column(&result, &result.instruction), "Missing Operand");
+            result.error = 1;
+        } else if (operand == 1 && (result.operand_count == 2 || extra)) {
+            report_diagnostic(ERR_OPERANDS_TOO_MANY, line_number, span_column(&result, &result.operands), "Additional Operands");
+            result.error = 1;
+        } else if (operand == 2 && result.operand_count == 1) {
+            report_diagnostic(ERR_OPERANDS_INSUFFICIENT, line_number, span_column(&result, &result.srcOperand.value), "Missing Operand 2");
+            result.error = 1;
+        } else if (operand == 2 && extra) {
+            report_diagnostic(ERR_OPERANDS_TOO_MANY, line_number, span_column(&result, &result.operands), "Additional Operands");
+            result.error = 1;
         }
     }
 
-    free(line_copy);
     return result;
 }
 
+int span_column(const AssemblyLine *line, const Span *span) {
+    return span->length ? (int)(span->start - line->original) + 1 : 0;
+}
+
 /* Print the contents of an AssemblyLine */
 void print_assembly_line(const AssemblyLine *line) {
     if (line == NULL) {
-        fprintf(stderr, "Error: Assembly line is NULL\n");
+        report_message(stderr, "Error: Assembly line is NULL\n");
         return;
     }
-    printf("Label: %s\n", line->label ? line->label : "(none)");
-    printf("Instruction: %s\n", line->instruction ? line->instruction : "(none)");
-    printf("Operands: %s\n", line->operands ? line->operands : "(none)");
+    report_message(stdout, "Label: %.*s\n", line->label.length ? line->label.length : 6, line->label.length ? line->label.start : "(none)");
+    report_message(stdout, "Instruction: %.*s\n", line->instruction.length ? line->instruction.length : 6, line->instruction.length ? line->instruction.start : "(none)");
+    report_message(stdout, "Operands: %.*s\n", line->operands.length ? line->operands.length : 6, line->operands.length ? line->operands.start : "(none)");
 }
-
-/* Free memory allocated for an AssemblyLine */
-void free_assembly_line(const AssemblyLine *line) {
-    if (line) {
-        free(line->label);
-        free(line->instruction);
-        free(line->operands);
-        free_operand(line->srcOperand);
-        free_operand(line->destOperand);
-    }
-}
-
-/* Free memory allocated for an Operand */
-void free_operand(Operand *op) {
-    if (op) {
-        free(op->value);
-        free(op);
-    }
-}
-
@@ -2,32 +2,126 @@
 #include "error_handling.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 
-lines* malloc_line(const char *content) {
-    lines *new_line = (lines *)malloc(sizeof(lines));
-    
-    /* Check if memory allocation was successful */
-    if (new_line == NULL) {
-        report_error(ERR_MEMORY_ALLOCATION, 0);
-        exit(1); /* Exit on memory allocation failure */
+void init_line_buffer(LineBuffer *buffer) {
+    buffer->text = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+    buffer->offsets = NULL;
+    buffer->numbers = NULL;
+    buffer->count = 0;
+    buffer->lines_capacity = 0;
+    buffer->number = 0;
+}
+
+int append_line(LineBuffer *buffer, const char *line) {
+    return append_line_view(buffer, line, strlen(line));
+}
+
+/* Make room for size more bytes of text and count more lines */
+static int reserve(LineBuffer *buffer, int size, int count) {
+    char *new_text;
+    int *new_offsets;
+    int *new_numbers;
+
+    /* Grow the text block until the new lines fit */
+    if (buffer->length + size > buffer->capacity) {
+        int new_capacity = buffer->capacity ? buffer->capacity : 1024;
+        while (buffer->length + size > new_capacity) {
+            new_capacity *= 2;
+        }
+        new_text = realloc(buffer->text, new_capacity);
+        if (new_text == NULL) {
+            report_error(ERR_MEMORY_ALLOCATION, 0);
+            return 0;
+        }
+        buffer->text = new_text;
+        buffer->capacity = new_capacity;
+    }
+
+    /* Grow the offsets and numbers arrays if needed */
+    if (buffer->count + count > buffer->lines_capacity) {
+        int new_capacity = buffer->lines_capacity ? buffer->lines_capacity : 64;
+        while (buffer->count + count > new_capacity) {
+            new_capacity *= 2;
+        }
+        new_offsets = realloc(buffer->offsets, sizeof(int) * new_capacity);
+        if (new_offsets == NULL) {
+            report_error(ERR_MEMORY_ALLOCATION, 0);
+            return 0;
+        }
+        buffer->offsets = new_offsets;
+        new_numbers = realloc(buffer->numbers, sizeof(int) * new_capacity);
+        if (new_numbers == NULL) {
+            report_error(ERR_MEMORY_ALLOCATION, 0);
+            return 0;
+        }
+        buffer->numbers = new_numbers;
+        buffer->lines_capacity = new_capacity;
+    }
+    return 1;
+}
+
+int append_line_view(LineBuffer *buffer, const char *line, int length) {
+    int size = length + 1;
+
+    if (!reserve(buffer, size, 1)) {
+        return 0;
+    }
+
+    memcpy(buffer->text + buffer->length, line, length);
+    buffer->text[buffer->length + length] = '\0';
+    buffer->numbers[buffer->count] = buffer->number;
+    buffer->offsets[buffer->count++] = buffer->length;
+    buffer->length += size;
+    return 1;
+}
+
+int append_line_block(LineBuffer *buffer, const char *text, int length, const int *offsets, int count) {
+    int i;
+
+    if (!reserve(buffer, length, count)) {
+        return 0;
+    }
+
+    memcpy(buffer->text + buffer->length, text, length);
+    for (i = 0; i < count; i++) {
+        buffer->numbers[buffer->count] = buffer->number;
+        buffer->offsets[buffer->count++] = buffer->length + offsets[i];
     }
+    buffer->length += length;
+    return 1;
+}
 
-    /* Copy the content into the line, ensuring null-termination */
-    strncpy(new_line->line, content, MAX_LINE_LENGTH - 1);
-    new_line->line[MAX_LINE_LENGTH - 1] = '\0'; /* Ensure null-termination */
+const char *get_line(const LineBuffer *buffer, int index) {
+    return buffer->text + buffer->offsets[index];
+}
 
-    new_line->next = NULL;
-    return new_line;
+int get_line_number(const LineBuffer *buffer, int index) {
+    return buffer->numbers[index] ? buffer->numbers[index] : index + 1;
 }
 
-void free_lines(lines *head) {
-    lines *current = head;
+int write_line_buffer(const LineBuffer *buffer, const char *filename) {
+    FILE *file = fopen(filename, "w");
+    int i;
+
+    if (file == NULL) {
+        report_message(stdout, "Error: Could not create output file %s\n", filename);
+        return 0;
+    }
 
-    /* Traverse the linked list and free each line */
-    while (current != NULL) {
-        lines *next = current->next;
-        free(current);
-        current = next;
+    for (i = 0; i < buffer->count; i++) {
+        fputs(get_line(buffer, i), file);
     }
+
+    fclose(file);
+    return 1;
 }
 
+void free_line_buffer(LineBuffer *buffer) {
+    free(buffer->text);
+    free(buffer->offsets);
+    free(buffer->numbers);
+    init_line_buffer(buffer);
+}
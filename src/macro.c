@@ -1,44 +1,236 @@
 #include "macro.h"
 #include "error_handling.h"
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include "lines.h"
+#include "utils.h"
 
-struct macros *create_macro_node(const char *macro_name, struct macros **ptr_to_head) {
-    struct macros *head = *ptr_to_head;
-    struct macros *new_macro = malloc(sizeof(struct macros));
-    if (new_macro == NULL) {
+/* Place a macro into the first free slot of its probe sequence */
+static void insert_slot(struct macros **slots, int capacity, struct macros *macro) {
+    int mask = capacity - 1;
+    int i = (int)(macro->hash & mask);
+
+    while (slots[i] != NULL) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = macro;
+}
+
+/* Double the hash index, keeping the load factor at or below one half */
+static int grow_slots(MacroTable *table) {
+    int new_capacity = table->capacity ? table->capacity * 2 : 64;
+    struct macros **new_slots = calloc(new_capacity, sizeof(struct macros *));
+    struct macros *current;
+
+    if (new_slots == NULL) {
         report_error(ERR_MEMORY_ALLOCATION, 0);
+        return 0;
+    }
+    for (current = table->head; current != NULL; current = current->next) {
+        insert_slot(new_slots, new_capacity, current);
+    }
+    free(table->slots);
+    table->slots = new_slots;
+    table->capacity = new_capacity;
+    return 1;
+}
+
+/* Check whether a body line holds the name of the given macro */
+static int line_names_macro(const char *line, const struct macros *macro) {
+    const char *start;
+    int length;
+
+    start = trim_span(line, &length);
+    return hash_name(start, length) == macro->hash &&
+        strncmp(macro->name, start, length) == 0 && macro->name[length] == '\0';
+}
+
+/* Drop the cached expansion of a macro; it is rebuilt on its next use */
+static void drop_expansion(struct macros *macro) {
+    free_line_buffer(&macro->expansion);
+    macro->expanded = 0;
+}
+
+/* Drop the expansions that a newly defined macro changes: those with a body
+   line naming it, then, until none is left, those nesting a dropped macro */
+static void invalidate_expansions(MacroTable *table, const struct macros *defined) {
+    struct macros *current;
+    int changed = 0;
+    int i;
+
+    for (current = table->head; current != NULL; current = current->next) {
+        for (i = 0; current->expanded && i < current->name_line_count; i++) {
+            if (line_names_macro(current->body + current->offsets[current->name_lines[i]], defined)) {
+                drop_expansion(current);
+                changed = 1;
+            }
+        }
+    }
+    while (changed) {
+        changed = 0;
+        for (current = table->head; current != NULL; current = current->next) {
+            for (i = 0; current->expanded && i < current->name_line_count; i++) {
+                struct macros *nested = is_existing_macro(table, current->body + current->offsets[current->name_lines[i]]);
+                if (nested != NULL && !nested->expanded) {
+                    drop_expansion(current);
+                    changed = 1;
+                }
+            }
+        }
+    }
+}
+
+/* Record which body lines hold a single word; only those can invoke a macro */
+static int index_name_lines(MacroTable *table, struct macros *macro) {
+    int count = 0;
+    int i;
+
+    macro->name_lines = arena_alloc(table->arena, (macro->line_count + 1) * sizeof(int));
+    if (macro->name_lines == NULL) {
+        return 0;
+    }
+    for (i = 0; i < macro->line_count; i++) {
+        const char *start;
+        int length;
+        int j;
+
+        start = trim_span(macro->body + macro->offsets[i], &length);
+        for (j = 0; j < length && !isspace((unsigned char)start[j]); j++)
+            ;
+        if (length > 0 && j == length) {
+            macro->name_lines[count++] = i;
+        }
+    }
+    macro->name_line_count = count;
+    return 1;
+}
+
+void init_macro_table(MacroTable *table, Arena *arena) {
+    table->head = NULL;
+    table->last = NULL;
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+    table->arena = arena;
+}
+
+void free_macro_table(MacroTable *table) {
+    struct macros *current;
+
+    for (current = table->head; current != NULL; current = current->next) {
+        free_line_buffer(&current->expansion);
+    }
+    free(table->slots);
+    init_macro_table(table, table->arena);
+}
+
+struct macros *create_macro_node(MacroTable *table, const char *macro_name) {
+    struct macros *new_macro;
+    const char *start;
+    int length;
+
+    if ((table->count + 1) * 2 > table->capacity && !grow_slots(table)) {
         return NULL;
     }
-    strncpy(new_macro->name, macro_name, MAX_LINE_LENGTH - 1);
-    new_macro->name[MAX_LINE_LENGTH - 1] = '\0'; /* Ensure null-termination */
-    new_macro->lines = NULL;
-    new_macro->next = NULL;
-    if (*ptr_to_head == NULL) {
-        *ptr_to_head = new_macro;
-        return new_macro;
+
+    new_macro = arena_alloc(table->arena, sizeof(struct macros));
+    if (new_macro == NULL) {
+        return NULL;
+    }
+    start = trim_span(macro_name, &length);
+    new_macro->name = arena_strndup(table->arena, start, length);
+    if (new_macro->name == NULL) {
+        return NULL;
     }
-    while (head->next != NULL) {
-        head = head->next;
+    new_macro->body = NULL;
+    new_macro->body_length = 0;
+    new_macro->offsets = NULL;
+    new_macro->line_count = 0;
+    new_macro->hash = hash_name(start, length);
+    init_line_buffer(&new_macro->expansion);
+    new_macro->name_lines = NULL;
+    new_macro->name_line_count = -1;
+    new_macro->expanded = 0;
+    new_macro->expanding = 0;
+    new_macro->next = NULL;
+
+    if (table->last == NULL) {
+        table->head = new_macro;
+    } else {
+        table->last->next = new_macro;
     }
-    head->next = new_macro;
+    table->last = new_macro;
+    insert_slot(table->slots, table->capacity, new_macro);
+    table->count++;
+    invalidate_expansions(table, new_macro);
     return new_macro;
 }
-struct macros *is_existing_macro(struct macros *head, const char *name) {
-    struct macros *current = head;
-    char macro_name[MAX_LINE_LENGTH];
-    strncpy(macro_name, name, MAX_LINE_LENGTH - 1);
-    macro_name[MAX_LINE_LENGTH - 1] = '\0'; /* Ensure null-termination */
-    while (current != NULL) {
-        if (strncmp(current->name, macro_name, strlen(macro_name)-2) == 0) {
+
+struct macros *is_existing_macro(const MacroTable *table, const char *name) {
+    const char *start;
+    unsigned long hash;
+    int length;
+    int mask;
+    int i;
+
+    if (table->count == 0) {
+        return NULL;
+    }
+
+    start = trim_span(name, &length);
+    hash = hash_name(start, length);
+    mask = table->capacity - 1;
+
+    /* Probe until the macro or an empty slot is found */
+    for (i = (int)(hash & mask); table->slots[i] != NULL; i = (i + 1) & mask) {
+        struct macros *current = table->slots[i];
+        if (current->hash == hash && strncmp(current->name, start, length) == 0 && current->name[length] == '\0') {
             return current;
         }
-        current = current->next;
     }
     return NULL;
 }
 
+const LineBuffer *get_macro_expansion(MacroTable *table, struct macros *macro, int line_number) {
+    int ok = 1;
+    int i;
+
+    if (macro->expanded) {
+        return &macro->expansion;
+    }
+    if (macro->expanding) {
+        report_diagnostic(ERR_MACRO_NAME_ERROR, line_number, 1, "Macro %s invokes itself", macro->name);
+        return NULL;
+    }
+    if (macro->name_line_count < 0 && !index_name_lines(table, macro)) {
+        return NULL;
+    }
+
+    macro->expanding = 1;
+    free_line_buffer(&macro->expansion);
+    for (i = 0; i < macro->line_count && ok; i++) {
+        const char *line = macro->body + macro->offsets[i];
+        struct macros *nested = is_existing_macro(table, line);
+
+        if (nested != NULL) {
+            const LineBuffer *lines = get_macro_expansion(table, nested, line_number);
+            ok = lines != NULL && (lines->count == 0 ||
+                append_line_block(&macro->expansion, lines->text, lines->length, lines->offsets, lines->count));
+        } else {
+            ok = append_line(&macro->expansion, line);
+        }
+    }
+    macro->expanding = 0;
+
+    if (!ok) {
+        drop_expansion(macro);
+        return NULL;
+    }
+    macro->expanded = 1;
+    return &macro->expansion;
+}
+
 int no_macro_name(const char* line) {
     int i = 5;
 
@@ -76,13 +268,3 @@ int extra_macro_name(const char* line) {
     return 1;
 }
 
-void free_macros(struct macros *head) {
-    struct macros *current = head;
-    struct macros *next = NULL;
-    while (current != NULL) {
-        next = current->next;
-        free_lines(current->lines);
-        free(current);
-        current = next;
-    }
-}
@@ -1,68 +1,135 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "second_pass.h"
-#include "symbol_table.h"
-#include "first_pass.h"
-#include "pre_assembler.h"
-#include "utils.h"
+#include "batch.h"
+#include "cache.h"
+#include "server.h"
 #include "error_handling.h"
+#include "trace.h"
 
 int main(int argc, char* argv[]) {
-    const char* input_filename;
-    char* base_filename;
-    struct macros* macro_head = NULL;
+    char** input_filenames;
+    int input_count = 0;
+    AssemblyOptions options;
+    int jobs = 0;
+    int pass_threads = 0;
+    const char *trace_filename = NULL;
+    const char *socket_path = NULL;
+    int serve_mode = 0;
+    int client_mode = 0;
+    int send_paths = 0;
+    int stop_mode = 0;
+    DiagnosticFormat diagnostic_format = DIAGNOSTICS_TEXT;
+    int max_errors = 0;
     int status;
-    char* dot;
-    FirstPassResult first_pass_result;
+    int i;
+
+    input_filenames = malloc(sizeof(char*) * argc);
+    if (input_filenames == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return ERR_MEMORY_ALLOCATION;
+    }
+
+    options.write_am = 0;
+    options.single_pass = 0;
+    options.binary_object = 0;
+    options.pass_threads = 1;
+    options.cache_directory = NULL;
+
+    /* Parse options and the input file names */
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--write-am") == 0) {
+            options.write_am = 1;
+        } else if (strcmp(argv[i], "--single-pass") == 0) {
+            options.single_pass = 1;
+        } else if (strcmp(argv[i], "--binary-object") == 0) {
+            options.binary_object = 1;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = atoi(argv[i] + 7);
+        } else if (strncmp(argv[i], "--pass-threads=", 15) == 0) {
+            pass_threads = atoi(argv[i] + 15);
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            trace_filename = argv[i] + 8;
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            options.cache_directory = DEFAULT_CACHE_DIRECTORY;
+        } else if (strncmp(argv[i], "--cache-dir=", 12) == 0) {
+            options.cache_directory = argv[i] + 12;
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            serve_mode = 1;
+        } else if (strcmp(argv[i], "--client") == 0) {
+            client_mode = 1;
+        } else if (strcmp(argv[i], "--send-path") == 0) {
+            send_paths = 1;
+        } else if (strcmp(argv[i], "--stop-server") == 0) {
+            stop_mode = 1;
+        } else if (strncmp(argv[i], "--socket=", 9) == 0) {
+            socket_path = argv[i] + 9;
+        } else if (strncmp(argv[i], "--max-errors=", 13) == 0) {
+            max_errors = atoi(argv[i] + 13);
+        } else if (strcmp(argv[i], "--diagnostics=json") == 0) {
+            diagnostic_format = DIAGNOSTICS_JSON;
+        } else if (strcmp(argv[i], "--diagnostics=text") == 0) {
+            diagnostic_format = DIAGNOSTICS_TEXT;
+        } else {
+            input_filenames[input_count++] = argv[i];
+        }
+    }
     
-    /* Ensure the correct number of arguments are provided */
-    if (argc < 2) {
-        printf("Usage: %s <assembly_file>\n", argv[0]);
-        return 1;
+    /* Diagnostics are printed by this process, also for files assembled on a server */
+    configure_diagnostics(diagnostic_format, max_errors);
+    if (socket_path == NULL) {
+        socket_path = default_socket_path();
     }
 
-    input_filename = argv[1];
+    /* Server modes need no input files */
+    if (serve_mode || stop_mode) {
+        free(input_filenames);
+        if (stop_mode) {
+            return stop_server(socket_path);
+        }
+        return serve(socket_path, jobs > 0 ? jobs : default_job_count());
+    }
 
-    /* Check file extension for ".as" */
-    dot = strrchr(input_filename, '.');
-    if (dot && (strcmp(dot + 1, "as") != 0)) {
-        printf("Error: Wrong File Extension\n");
+    /* Ensure at least one input file is provided */
+    if (input_count == 0) {
+        printf("Usage: %s [--write-am] [--single-pass] [--binary-object] [--jobs=N] [--pass-threads=N] [--trace=FILE] [--cache] [--cache-dir=DIR] [--max-errors=N] [--diagnostics=text|json] <assembly_file>...\n", argv[0]);
+        printf("       %s --serve [--socket=PATH] [--jobs=N]\n", argv[0]);
+        printf("       %s --client [--socket=PATH] [--send-path] [--max-errors=N] [--diagnostics=text|json] <assembly_file>...\n", argv[0]);
+        printf("       %s --stop-server [--socket=PATH]\n", argv[0]);
+        free(input_filenames);
         return 1;
     }
 
-    /* Remove the file extension for further processing */
-    base_filename = remove_extension(input_filename);
+    /* One worker per core unless told otherwise */
+    if (jobs <= 0) {
+        jobs = default_job_count();
+    }
 
-    /* Pre-assembler stage */
-    status = pre_process(input_filename, macro_head);
-    if (status != NO_ERROR) {
-        printf("Error in pre-assembler stage\n");
-        free(base_filename);
-        return status;
+    /* A single file may split its first pass over the cores instead */
+    if (pass_threads > 0) {
+        options.pass_threads = pass_threads;
+    } else if (input_count == 1) {
+        options.pass_threads = default_job_count();
     }
 
-    /* First pass */
-    first_pass_result = first_pass(base_filename);
-    if (first_pass_result.errorFlag != NO_ERROR) {
-        printf("Error in first pass\n");
-        free(base_filename);
-        return first_pass_result.errorFlag;
+    /* Stage timings go to a Chrome trace file when asked for */
+    if (trace_filename != NULL) {
+        start_trace();
     }
 
-    /* Second pass */
-    status = second_pass(base_filename, first_pass_result.symbolTable);
-    if (status != NO_ERROR) {
-        printf("Error in second pass\n");
-        free(base_filename);
-        free_symbol_table(first_pass_result.symbolTable);
-        return status;
+    if (client_mode) {
+        status = assemble_remote(socket_path, input_filenames, input_count, send_paths);
+    } else {
+        status = assemble_files(input_filenames, input_count, jobs, &options);
     }
 
-    /* Free allocated resources */
-    free(base_filename);
-    free_symbol_table(first_pass_result.symbolTable);
-    
-    return 0;
-}
+    if (trace_filename != NULL && !write_trace(trace_filename)) {
+        printf("Error: Could not write trace file %s\n", trace_filename);
+        if (status == NO_ERROR) {
+            status = ERR_FILE_ACCESS;
+        }
+    }
 
+    free(input_filenames);
+    return status;
+}
@@ -0,0 +1,478 @@
+#include "object_file.h"
+#include "error_handling.h"
+#include "utils.h"
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Round a size up to a multiple of four bytes */
+#define ALIGN4(size) (((size) + 3) & ~(unsigned long)3)
+
+static void put_u16(unsigned char *out, unsigned int value) {
+    out[0] = (unsigned char)(value & 0xFF);
+    out[1] = (unsigned char)((value >> 8) & 0xFF);
+}
+
+static void put_u32(unsigned char *out, unsigned long value) {
+    out[0] = (unsigned char)(value & 0xFF);
+    out[1] = (unsigned char)((value >> 8) & 0xFF);
+    out[2] = (unsigned char)((value >> 16) & 0xFF);
+    out[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+static unsigned long get_u32(const unsigned char *in) {
+    return (unsigned long)in[0] | ((unsigned long)in[1] << 8) | ((unsigned long)in[2] << 16) |
+           ((unsigned long)in[3] << 24);
+}
+
+/* Length of a name as written to the .ent and .ext files, without a line break */
+static unsigned long name_length(const char *name) {
+    return (unsigned long)strcspn(name, "\r\n");
+}
+
+/* Write one record and its name; names are appended to the name table */
+static void put_record(unsigned char *record, unsigned char *names, unsigned long *names_used,
+                       const char *name, int address) {
+    unsigned long length = name_length(name);
+
+    put_u32(record, *names_used);
+    put_u32(record + 4, (unsigned long)address);
+    memcpy(names + *names_used, name, length);
+    names[*names_used + length] = '\0';
+    *names_used += length + 1;
+}
+
+int write_object_file(const BinaryTable *table, const SymbolTable *symbol_table, const char *filename) {
+    const Symbol *symbol;
+    const ExternReference *reference;
+    unsigned long entry_count = 0;
+    unsigned long extern_count = 0;
+    unsigned long names_size = 0;
+    unsigned long names_used = 0;
+    unsigned long entries_offset;
+    unsigned long externs_offset;
+    unsigned long names_offset;
+    unsigned long size;
+    unsigned char *buffer;
+    FILE *file;
+    int base;
+    int status;
+    int i;
+
+    if (table->size == 0) {
+        return 1;
+    }
+
+    /* The format stores no addresses, so the words must follow each other */
+    base = table->words[0].address;
+    for (i = 1; i < table->size; i++) {
+        if (table->words[i].address != base + i) {
+            report_message(stderr, "Error: Words of %s are not at consecutive addresses\n", filename);
+            return 0;
+        }
+    }
+
+    /* Size the sections */
+    for (symbol = symbol_table->head; symbol != NULL; symbol = symbol->next) {
+        if (symbol->type == SYMBOL_ENTRY) {
+            entry_count++;
+            names_size += name_length(symbol->name) + 1;
+        }
+    }
+    for (reference = get_extern_references(symbol_table); reference != NULL; reference = reference->next) {
+        extern_count++;
+        names_size += name_length(reference->name) + 1;
+    }
+    entries_offset = OBJECT_HEADER_SIZE + ALIGN4((unsigned long)table->size * 2);
+    externs_offset = entries_offset + entry_count * OBJECT_RECORD_SIZE;
+    names_offset = externs_offset + extern_count * OBJECT_RECORD_SIZE;
+    size = ALIGN4(names_offset + names_size);
+
+    buffer = calloc(size, 1);
+    if (buffer == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return 0;
+    }
+
+    /* Header */
+    memcpy(buffer, OBJECT_MAGIC, 4);
+    put_u32(buffer + 4, OBJECT_FORMAT_VERSION);
+    put_u32(buffer + 8, size);
+    put_u32(buffer + 12, (unsigned long)base);
+    put_u32(buffer + 16, (unsigned long)(table->size - table->data));
+    put_u32(buffer + 20, (unsigned long)table->data);
+    put_u32(buffer + 24, entry_count);
+    put_u32(buffer + 28, extern_count);
+    put_u32(buffer + 32, entries_offset);
+    put_u32(buffer + 36, externs_offset);
+    put_u32(buffer + 40, names_offset);
+    put_u32(buffer + 44, names_size);
+
+    /* Words, then the records with their names */
+    for (i = 0; i < table->size; i++) {
+        put_u16(buffer + OBJECT_HEADER_SIZE + i * 2, table->words[i].value & 0x7FFF);
+    }
+    i = 0;
+    for (symbol = symbol_table->head; symbol != NULL; symbol = symbol->next) {
+        if (symbol->type == SYMBOL_ENTRY) {
+            put_record(buffer + entries_offset + i * OBJECT_RECORD_SIZE, buffer + names_offset, &names_used,
+                       symbol->name, symbol->address);
+            i++;
+        }
+    }
+    i = 0;
+    for (reference = get_extern_references(symbol_table); reference != NULL; reference = reference->next) {
+        put_record(buffer + externs_offset + i * OBJECT_RECORD_SIZE, buffer + names_offset, &names_used,
+                   reference->name, reference->address);
+        i++;
+    }
+
+    file = fopen(filename, "wb");
+    if (file == NULL) {
+        report_message(stderr, "Error opening file %s for writing\n", filename);
+        free(buffer);
+        return 0;
+    }
+    status = fwrite(buffer, 1, size, file) == size;
+    if (fclose(file) != 0) {
+        status = 0;
+    }
+    if (!status) {
+        report_message(stderr, "Error writing file %s\n", filename);
+    }
+    free(buffer);
+    return status;
+}
+
+/* Check that a section of count records of the given size lies inside the file */
+static int section_fits(unsigned long offset, unsigned long count, unsigned long record_size, unsigned long size) {
+    return offset <= size && count <= (size - offset) / record_size;
+}
+
+int open_object_file(const char *filename, ObjectImage *image) {
+    const unsigned char *data;
+    unsigned long size;
+    unsigned long words;
+    unsigned long entries_offset;
+    unsigned long externs_offset;
+    unsigned long names_offset;
+
+    if (open_source(filename, &image->file) != NO_ERROR) {
+        return ERR_FILE_ACCESS;
+    }
+    data = (const unsigned char *)image->file.text;
+    size = (unsigned long)image->file.length;
+
+    if (size < OBJECT_HEADER_SIZE || memcmp(data, OBJECT_MAGIC, 4) != 0 ||
+        get_u32(data + 4) != OBJECT_FORMAT_VERSION || get_u32(data + 8) != size) {
+        close_source(&image->file);
+        return ERR_FILE_ACCESS;
+    }
+
+    image->base = (int)get_u32(data + 12);
+    image->instruction_count = (int)get_u32(data + 16);
+    image->data_count = (int)get_u32(data + 20);
+    image->entry_count = (int)get_u32(data + 24);
+    image->extern_count = (int)get_u32(data + 28);
+    entries_offset = get_u32(data + 32);
+    externs_offset = get_u32(data + 36);
+    names_offset = get_u32(data + 40);
+    image->names_size = get_u32(data + 44);
+    words = get_u32(data + 16) + get_u32(data + 20);
+
+    /* Every section must lie in the file, and the last name must be terminated */
+    if (image->instruction_count < 0 || image->data_count < 0 || image->entry_count < 0 ||
+        image->extern_count < 0 || words > 0x7FFFFFFFUL ||
+        !section_fits(OBJECT_HEADER_SIZE, words, 2, size) ||
+        !section_fits(entries_offset, get_u32(data + 24), OBJECT_RECORD_SIZE, size) ||
+        !section_fits(externs_offset, get_u32(data + 28), OBJECT_RECORD_SIZE, size) ||
+        !section_fits(names_offset, image->names_size, 1, size) ||
+        (image->names_size > 0 && data[names_offset + image->names_size - 1] != '\0')) {
+        close_source(&image->file);
+        return ERR_FILE_ACCESS;
+    }
+
+    image->words = data + OBJECT_HEADER_SIZE;
+    image->entries = data + entries_offset;
+    image->externs = data + externs_offset;
+    image->names = (const char *)data + names_offset;
+    return NO_ERROR;
+}
+
+unsigned short object_word(const ObjectImage *image, int i) {
+    return (unsigned short)(image->words[i * 2] | (image->words[i * 2 + 1] << 8));
+}
+
+/* Name and address of a record */
+static const char *record_name(const ObjectImage *image, const unsigned char *record, int *address) {
+    unsigned long name = get_u32(record);
+
+    *address = (int)get_u32(record + 4);
+    return name < image->names_size ? image->names + name : NULL;
+}
+
+const char *object_entry(const ObjectImage *image, int i, int *address) {
+    return record_name(image, image->entries + i * OBJECT_RECORD_SIZE, address);
+}
+
+const char *object_extern(const ObjectImage *image, int i, int *address) {
+    return record_name(image, image->externs + i * OBJECT_RECORD_SIZE, address);
+}
+
+void close_object_file(ObjectImage *image) {
+    close_source(&image->file);
+}
+
+/* Copy a line view into a null-terminated buffer; returns 0 if it does not fit */
+static int copy_line(const LineView *line, char *buffer, int size) {
+    int length = line->length;
+
+    while (length > 0 && (line->start[length - 1] == '\n' || line->start[length - 1] == '\r')) {
+        length--;
+    }
+    if (length >= size) {
+        return 0;
+    }
+    memcpy(buffer, line->start, length);
+    buffer[length] = '\0';
+    return 1;
+}
+
+/* Check that a line holds nothing but blanks */
+static int is_blank_line(const char *text) {
+    return text[strspn(text, " \t")] == '\0';
+}
+
+/* Load the words of a text .ob file: the "IC DC" header, then one address and octal word per line */
+static int load_text_words(const char *filename, ObjectModule *module) {
+    char text[MAX_LINE_LENGTH];
+    LineScanner scanner;
+    LineView line;
+    SourceFile file;
+    int count = 0;
+    int total;
+    int status = NO_ERROR;
+
+    if (open_source(filename, &file) != NO_ERROR) {
+        report_message(stderr, "Error: Could not open input file %s\n", filename);
+        return ERR_FILE_ACCESS;
+    }
+    init_line_scanner(&scanner, file.text, file.length);
+
+    if (!next_line(&scanner, &line) || !copy_line(&line, text, sizeof(text)) ||
+        sscanf(text, "%d %d", &module->instruction_count, &module->data_count) != 2 ||
+        module->instruction_count < 0 || module->data_count < 0) {
+        report_message(stderr, "Error: %s has no valid header line\n", filename);
+        close_source(&file);
+        return ERR_FILE_ACCESS;
+    }
+    total = module->instruction_count + module->data_count;
+    module->words = arena_alloc(&module->arena, sizeof(unsigned short) * (total + 1));
+    if (module->words == NULL) {
+        close_source(&file);
+        return ERR_MEMORY_ALLOCATION;
+    }
+
+    while (status == NO_ERROR && next_line(&scanner, &line)) {
+        int address;
+        unsigned int value;
+        char extra;
+
+        if (!copy_line(&line, text, sizeof(text))) {
+            status = ERR_FILE_ACCESS;
+        } else if (is_blank_line(text)) {
+            continue;
+        } else if (count == total || sscanf(text, "%d %o %c", &address, &value, &extra) != 2 || value > 0x7FFF) {
+            status = ERR_FILE_ACCESS;
+        } else {
+            /* Words sit at consecutive addresses from the first one */
+            if (count == 0) {
+                module->base = address;
+            }
+            if (address != module->base + count) {
+                status = ERR_FILE_ACCESS;
+            }
+            module->words[count++] = (unsigned short)value;
+        }
+        if (status != NO_ERROR) {
+            report_message(stderr, "Error: Malformed line %d in %s\n", line.number, filename);
+        }
+    }
+    if (status == NO_ERROR && count != total) {
+        report_message(stderr, "Error: %s has %d words, its header announces %d\n", filename, count, total);
+        status = ERR_FILE_ACCESS;
+    }
+    close_source(&file);
+    return status;
+}
+
+/* Load the "name address" lines of a .ent or .ext file; a missing file lists nothing */
+static int load_text_symbols(const char *filename, Arena *arena, AssembledSymbol **symbols, int *count) {
+    char text[MAX_LINE_LENGTH];
+    char name[MAX_LINE_LENGTH];
+    LineScanner scanner;
+    LineView line;
+    SourceFile file;
+    int lines = 0;
+    int status = NO_ERROR;
+
+    *count = 0;
+    *symbols = NULL;
+    if (open_source(filename, &file) != NO_ERROR) {
+        return NO_ERROR;
+    }
+
+    /* One symbol per line at most */
+    init_line_scanner(&scanner, file.text, file.length);
+    while (next_line(&scanner, &line)) {
+        lines++;
+    }
+    *symbols = arena_alloc(arena, sizeof(AssembledSymbol) * (lines + 1));
+    if (*symbols == NULL) {
+        close_source(&file);
+        return ERR_MEMORY_ALLOCATION;
+    }
+
+    init_line_scanner(&scanner, file.text, file.length);
+    while (status == NO_ERROR && next_line(&scanner, &line)) {
+        AssembledSymbol *symbol = &(*symbols)[*count];
+        int address;
+        char extra;
+
+        if (!copy_line(&line, text, sizeof(text))) {
+            status = ERR_FILE_ACCESS;
+        } else if (is_blank_line(text)) {
+            continue;
+        } else if (sscanf(text, "%s %d %c", name, &address, &extra) != 2) {
+            status = ERR_FILE_ACCESS;
+        } else {
+            symbol->name = arena_strndup(arena, name, (int)strlen(name));
+            symbol->address = address;
+            if (symbol->name == NULL) {
+                status = ERR_MEMORY_ALLOCATION;
+            }
+            (*count)++;
+        }
+        if (status == ERR_FILE_ACCESS) {
+            report_message(stderr, "Error: Malformed line %d in %s\n", line.number, filename);
+        }
+    }
+    close_source(&file);
+    return status;
+}
+
+/* Copy the records of a binary object into a list */
+static int copy_records(const ObjectImage *image, int count, const char *(*record)(const ObjectImage *, int, int *),
+                        Arena *arena, AssembledSymbol **symbols) {
+    int i;
+
+    *symbols = arena_alloc(arena, sizeof(AssembledSymbol) * (count + 1));
+    if (*symbols == NULL) {
+        return ERR_MEMORY_ALLOCATION;
+    }
+    for (i = 0; i < count; i++) {
+        const char *name = record(image, i, &(*symbols)[i].address);
+
+        if (name == NULL) {
+            return ERR_FILE_ACCESS;
+        }
+        (*symbols)[i].name = arena_strndup(arena, name, (int)strlen(name));
+        if ((*symbols)[i].name == NULL) {
+            return ERR_MEMORY_ALLOCATION;
+        }
+    }
+    return NO_ERROR;
+}
+
+/* Load a module from a binary object */
+static int load_binary_module(const char *filename, ObjectModule *module) {
+    ObjectImage image;
+    int total;
+    int status;
+    int i;
+
+    if (open_object_file(filename, &image) != NO_ERROR) {
+        report_message(stderr, "Error: %s is not a readable binary object\n", filename);
+        return ERR_FILE_ACCESS;
+    }
+    module->base = image.base;
+    module->instruction_count = image.instruction_count;
+    module->data_count = image.data_count;
+    total = image.instruction_count + image.data_count;
+    module->words = arena_alloc(&module->arena, sizeof(unsigned short) * (total + 1));
+    status = module->words != NULL ? NO_ERROR : ERR_MEMORY_ALLOCATION;
+    for (i = 0; status == NO_ERROR && i < total; i++) {
+        module->words[i] = object_word(&image, i);
+    }
+    if (status == NO_ERROR) {
+        status = copy_records(&image, image.entry_count, object_entry, &module->arena, &module->entries);
+        module->entry_count = image.entry_count;
+    }
+    if (status == NO_ERROR) {
+        status = copy_records(&image, image.extern_count, object_extern, &module->arena, &module->externs);
+        module->extern_count = image.extern_count;
+    }
+    if (status == ERR_FILE_ACCESS) {
+        report_message(stderr, "Error: %s has a record outside its name table\n", filename);
+    }
+    close_object_file(&image);
+    return status;
+}
+
+int load_object_module(const char *filename, ObjectModule *module) {
+    const char *dot = strrchr(filename, '.');
+    char *base_name;
+    char *name;
+    int status;
+
+    module->base = 0;
+    module->instruction_count = 0;
+    module->data_count = 0;
+    module->words = NULL;
+    module->entries = NULL;
+    module->entry_count = 0;
+    module->externs = NULL;
+    module->extern_count = 0;
+    init_arena(&module->arena);
+
+    if (dot != NULL && strcmp(dot, OBJECT_EXTENSION) == 0) {
+        status = load_binary_module(filename, module);
+    } else {
+        /* The text files share the name of the .ob */
+        base_name = (dot != NULL && strcmp(dot, ".ob") == 0) ? remove_extension(filename) : my_strdup(filename);
+        if (base_name == NULL) {
+            return ERR_MEMORY_ALLOCATION;
+        }
+        name = add_file_extension(base_name, ".ob");
+        status = name != NULL ? load_text_words(name, module) : ERR_MEMORY_ALLOCATION;
+        free(name);
+        if (status == NO_ERROR) {
+            name = add_file_extension(base_name, ".ent");
+            status = name != NULL ? load_text_symbols(name, &module->arena, &module->entries, &module->entry_count)
+                                  : ERR_MEMORY_ALLOCATION;
+            free(name);
+        }
+        if (status == NO_ERROR) {
+            name = add_file_extension(base_name, ".ext");
+            status = name != NULL ? load_text_symbols(name, &module->arena, &module->externs, &module->extern_count)
+                                  : ERR_MEMORY_ALLOCATION;
+            free(name);
+        }
+        free(base_name);
+    }
+    if (status == ERR_MEMORY_ALLOCATION) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+    }
+    if (status != NO_ERROR) {
+        free_object_module(module);
+    }
+    return status;
+}
+
+void free_object_module(ObjectModule *module) {
+    free_arena(&module->arena);
+    module->words = NULL;
+    module->entries = NULL;
+    module->externs = NULL;
+}
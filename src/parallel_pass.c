@@ -0,0 +1,173 @@
+#include "parallel_pass.h"
+#include "error_handling.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/*
+ * @struct FirstPassChunk
+ * A range of source lines and the first pass state built from it alone.
+ * Counters start at zero; addresses are made final when the chunks are merged.
+ */
+typedef struct {
+    const LineBuffer *source;        /* The whole expanded source */
+    int index;                       /* Position of the chunk in the source */
+    int first;                       /* Index of the first line of the chunk */
+    int last;                        /* Index one past the last line of the chunk */
+    FirstPassResult pass;            /* Labels, IR and counters of the chunk */
+    Arena arena;                     /* Owns the chunk's symbols */
+    DiagnosticBuffer diagnostics;    /* Messages reported for the chunk */
+    int status;                      /* Error that stopped the chunk, if any */
+    int parse_error;                 /* Set if a line of the chunk did not parse */
+    int trace_group;                 /* Trace group of the thread that split the pass */
+} FirstPassChunk;
+
+static void *first_pass_chunk(void *argument) {
+    FirstPassChunk *chunk = argument;
+    DiagnosticBuffer *previous = capture_diagnostics(&chunk->diagnostics);
+    double started = trace_clock();
+    int i;
+
+    chunk->pass.memoryCounters.instructionCounter = 0;
+    chunk->pass.memoryCounters.dataCounter = 0;
+    for (i = chunk->first; i < chunk->last; i++) {
+        chunk->status = first_pass_line(&chunk->pass, get_line(chunk->source, i), get_line_number(chunk->source, i),
+                                        &chunk->parse_error);
+        if (chunk->status != NO_ERROR) {
+            break;
+        }
+    }
+
+    trace_span("first_pass_chunk", started);
+    capture_diagnostics(previous);
+    return NULL;
+}
+
+/* Entry point of a chunk thread: the chunk gets its own trace track */
+static void *first_pass_chunk_thread(void *argument) {
+    FirstPassChunk *chunk = argument;
+    char name[32];
+
+    sprintf(name, "first_pass chunk %d", chunk->index);
+    enter_trace_track(chunk->trace_group, NULL, name);
+    return first_pass_chunk(argument);
+}
+
+/* Move the chunk results into one result; returns 0 if the serial path must decide */
+static int merge_chunks(FirstPassChunk *chunks, int count, FirstPassResult *result) {
+    int ic = 100;
+    int dc = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (chunks[i].status != NO_ERROR || chunks[i].parse_error || chunks[i].diagnostics.length > 0) {
+            return 0;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        const Symbol *symbol;
+
+        for (symbol = chunks[i].pass.symbolTable.head; symbol != NULL; symbol = symbol->next) {
+            int address = symbol->address;
+
+            /* A label defined in an earlier chunk too */
+            if (find_symbol(symbol->name, &result->symbolTable) != NULL) {
+                return 0;
+            }
+            if (symbol->type != SYMBOL_EXTERN) {
+                address += symbol->is_data_line ? dc : ic;
+            }
+            if (!add_symbol(&result->symbolTable, symbol->name, address, symbol->type, symbol->is_data_line, symbol->line)) {
+                return 0;
+            }
+        }
+        if (!append_ir_program(&result->program, &chunks[i].pass.program)) {
+            return 0;
+        }
+
+        /* Prefix sums of the chunk counters */
+        ic += chunks[i].pass.memoryCounters.instructionCounter;
+        dc += chunks[i].pass.memoryCounters.dataCounter;
+    }
+
+    result->memoryCounters.instructionCounter = ic;
+    result->memoryCounters.dataCounter = dc;
+    end_first_pass(result, 0);
+    return 1;
+}
+
+FirstPassResult parallel_first_pass(const LineBuffer *source, Arena *arena, int threads) {
+    FirstPassResult result;
+    FirstPassChunk *chunks;
+    pthread_t *workers;
+    int count = source->count / MIN_LINES_PER_CHUNK;
+    double split = trace_clock();
+    int started;
+    int merged;
+    int i;
+
+    if (count > threads) {
+        count = threads;
+    }
+    if (count <= 1) {
+        return first_pass(source, arena);
+    }
+
+    chunks = malloc(sizeof(FirstPassChunk) * count);
+    workers = malloc(sizeof(pthread_t) * count);
+    if (chunks == NULL || workers == NULL) {
+        free(chunks);
+        free(workers);
+        return first_pass(source, arena);
+    }
+
+    for (i = 0; i < count; i++) {
+        chunks[i].source = source;
+        chunks[i].index = i;
+        chunks[i].first = (int)((long)source->count * i / count);
+        chunks[i].last = (int)((long)source->count * (i + 1) / count);
+        chunks[i].status = NO_ERROR;
+        chunks[i].parse_error = 0;
+        chunks[i].trace_group = current_trace_group();
+        init_arena(&chunks[i].arena);
+        init_diagnostic_buffer(&chunks[i].diagnostics);
+        begin_first_pass(&chunks[i].pass, &chunks[i].arena);
+    }
+
+    /* The first chunk runs on the calling thread */
+    for (started = 1; started < count; started++) {
+        if (pthread_create(&workers[started], NULL, first_pass_chunk_thread, &chunks[started]) != 0) {
+            break;
+        }
+    }
+    first_pass_chunk(&chunks[0]);
+    for (i = started; i < count; i++) {
+        first_pass_chunk(&chunks[i]);
+    }
+    for (i = 1; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    begin_first_pass(&result, arena);
+    merged = merge_chunks(chunks, count, &result);
+    trace_span("parallel_first_pass", split);
+
+    for (i = 0; i < count; i++) {
+        free_ir_program(&chunks[i].pass.program);
+        free_symbol_table(&chunks[i].pass.symbolTable);
+        free_diagnostic_buffer(&chunks[i].diagnostics);
+        free_arena(&chunks[i].arena);
+    }
+    free(chunks);
+    free(workers);
+
+    if (!merged) {
+        /* Let the serial pass report the problem exactly as it always has */
+        free_ir_program(&result.program);
+        free_symbol_table(&result.symbolTable);
+        return first_pass(source, arena);
+    }
+    return result;
+}
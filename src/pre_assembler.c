@@ -3,6 +3,8 @@
 #include "macro.h"
 #include "error_handling.h"
 #include "utils.h"
+#include "source.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,36 +43,69 @@ int case_insensitive_compare(const char *str1, const char *str2) {
     return *str1 == *str2;
 }
 
-int clean_file(const char *input_filename, const char *output_filename) {
-    FILE *input_file = fopen(input_filename, "r");
-    FILE *output_file;
-    char line[MAX_LINE_LENGTH];
+int clean_buffer(const char *source, size_t length, LineBuffer *output) {
+    const char *cursor = source;
+    const char *end = source + length;
+    LineView line;
+    int status = NO_ERROR;
 
-    if (input_file == NULL) {
-        printf("Error: Could not open input file %s\n", input_filename);
-        return ERR_FILE_ACCESS;
-    }
+    line.number = 0;
+    while (cursor < end) {
+        /* One sweep per line: vector skip of the indent, then memchr to the line end */
+        const char *first = skip_blanks(cursor, end);
+        const char *newline = first < end ? memchr(first, '\n', end - first) : NULL;
+        int size;
+        int i;
 
-    output_file = fopen(output_filename, "w");
-    if (output_file == NULL) {
-        printf("Error: Could not create output file %s\n", output_filename);
-        fclose(input_file);
-        return ERR_FILE_ACCESS;
-    }
+        line.start = cursor;
+        line.length = newline ? (int)(newline - cursor) + 1 : (int)(end - cursor);
+        line.number++;
+        cursor += line.length;
 
-    while (fgets(line, sizeof(line), input_file)) {
-        int i = 0;
-        while (line[i] == ' ' || line[i] == '\t') {
-            i++;
+        /* Report over-long lines instead of splitting them */
+        if (line_content_length(&line) > MAX_LINE_LENGTH - 1) {
+            report_error(ERR_LINE_TOO_LONG, line.number);
+            status = ERR_LINE_TOO_LONG;
+            continue;
         }
-        if (line[i] != ';' && line[i] != '\n' && strlen(line) > 2) {
-            fputs(line+i, output_file);
+
+        /* A full-length line keeps its text but not its line terminator */
+        size = line.length;
+        if (size > MAX_LINE_LENGTH - 1) {
+            size = MAX_LINE_LENGTH - 1;
+        }
+
+        /* Blank lines stop at the newline and comment lines at ';'; anything else is code */
+        i = (int)(first - line.start);
+        if (i > size) {
+            i = size;
+        }
+        if ((i == size || (line.start[i] != ';' && line.start[i] != '\n')) && size > 2) {
+            output->number = line.number;
+            if (!append_line_view(output, line.start + i, size - i)) {
+                return ERR_MEMORY_ALLOCATION;
+            }
         }
     }
 
-    fclose(input_file);
-    fclose(output_file);
-    return NO_ERROR;
+    return status;
+}
+
+int clean_file(const char *input_filename, LineBuffer *output) {
+    SourceFile source;
+    int status;
+    double started = trace_clock();
+
+    if (open_source(input_filename, &source) != NO_ERROR) {
+        report_diagnostic(ERR_FILE_ACCESS, 0, 0, "Could not open input file %s", input_filename);
+        return ERR_FILE_ACCESS;
+    }
+
+    /* One mapping per file; lines are taken straight from it */
+    status = clean_buffer(source.text, source.length, output);
+    close_source(&source);
+    trace_span("clean_file", started);
+    return status;
 }
 
 void strip_extra_spaces(char *destination, const char *source) {
@@ -85,158 +120,225 @@ void strip_extra_spaces(char *destination, const char *source) {
     *dst = '\0';
 }
 
-int handle_macros(const char *output_filename, const char *input_filename, struct macros *macro_head) {
-    FILE *input_file = fopen(input_filename, "r");
-    FILE *output_file;
-    char line[MAX_LINE_LENGTH];
+/* Skip the body of a rejected macro definition, up to its endmacr if it has one */
+static void skip_macro_body(const LineBuffer *input, int *index) {
+    int end = *index + 1;
 
-    if (input_file == NULL) {
-        printf("Error: Could not open input file %s\n", input_filename);
-        return ERR_FILE_ACCESS;
+    while (end < input->count && !starts_with(get_line(input, end), MACRO_END)) {
+        end++;
     }
-
-    output_file = fopen(output_filename, "w");
-    if (output_file == NULL) {
-        printf("Error: Could not create output file %s\n", output_filename);
-        fclose(input_file);
-        return ERR_FILE_ACCESS;
+    if (end < input->count) {
+        *index = end;
     }
+}
+
+int handle_macros(const LineBuffer *input, LineBuffer *output, Arena *arena) {
+    MacroTable macros;
+    int status = NO_ERROR;
+    int stop = 0;
+    double started = trace_clock();
+    int i;
 
-    while (fgets(line, sizeof(line), input_file)) {
-        
+    init_macro_table(&macros, arena);
+
+    /* A bad line is reported and the scan goes on; a macro without end or a full buffer ends it */
+    for (i = 0; i < input->count && !stop; i++) {
+        const char *line = get_line(input, i);
+        int line_number = get_line_number(input, i);
+
+        output->number = line_number;
         if (starts_with(line, MACRO_START)) {
-            if (verify_macro_name(line, macro_head)) {
-                return 1;
-            }
-            if (insert_macro(input_file, output_file, &macro_head, line)) {
-                return 1;
+            if (verify_macro_name(line, &macros, line_number)) {
+                skip_macro_body(input, &i);
+                status = 1;
+            } else if (insert_macro(input, &i, &macros, line)) {
+                status = 1;
+                stop = 1;
             }
         } else if (starts_with(line, MACRO_END)) {
-            printf("Error: endmacr without undefine macr.\n");
-            return 1;
+            report_diagnostic(ERR_MACRO_NAME_ERROR, line_number, 1, "endmacr without undefine macr");
+            status = 1;
         }
         else {
-            struct macros *macro = is_existing_macro(macro_head, line);
+            struct macros *macro = is_existing_macro(&macros, line);
             if (macro != NULL) {
-                expand_macro(macro, output_file);
-            } else {
-                fputs(line, output_file);
+                if (!expand_macro(&macros, macro, output, line_number)) {
+                    status = 1;
+                }
+            } else if (!append_line(output, line)) {
+                status = 1;
+                stop = 1;
             }
         }
     }
 
-    fclose(input_file);
-    fclose(output_file);
-    return NO_ERROR;
+    free_macro_table(&macros);
+    trace_span("handle_macros", started);
+    return status;
 }
 
-int verify_macro_name(const char *line, struct macros *macro_head) {
+int verify_macro_name(const char *line, const MacroTable *macros, int line_number) {
     char macro_name[MAX_LINE_LENGTH];
     sscanf(line, "macr %s", macro_name);
     trim_whitespace(macro_name);
 
     if (no_macro_name(line)) {
-        printf("Error: Macro name missing.\n");
+        report_diagnostic(ERR_MACRO_NAME_ERROR, line_number, 1, "Macro name missing");
         return 1;
     }
     if (extra_macro_name(line)) {
-        printf("Error: Additional character in the macro definition line.\n");
+        report_diagnostic(ERR_MACRO_NAME_ERROR, line_number, 1, "Additional character in the macro definition line");
         return 1;
     }
-    if ((is_existing_macro(macro_head, macro_name))) {
-        printf("Error: Macro name already exists.\n");
+    if ((is_existing_macro(macros, macro_name))) {
+        report_diagnostic(ERR_MACRO_NAME_ERROR, line_number, 1, "Macro name already exists: %s", macro_name);
         return 1;
     }
     if (check_if_opcode(macro_name)) {
-        printf("Error: Macro name restricted.\n");
+        report_diagnostic(ERR_MACRO_NAME_ERROR, line_number, 1, "Macro name restricted: %s", macro_name);
         return 1;
     }
     return NO_ERROR;
 }
 
-int insert_macro(FILE *input_file, FILE *output_file, struct macros **macro_head, const char *macro_definition) {
+int insert_macro(const LineBuffer *input, int *index, MacroTable *macros, const char *macro_definition) {
     char macro_name[MAX_LINE_LENGTH];
     struct macros *new_macro;
-    char line[MAX_LINE_LENGTH];
+    int first = *index + 1;
+    int end;
+    int size = 0;
+    int i;
 
     sscanf(macro_definition, "macr %s", macro_name);
     trim_whitespace(macro_name);
 
-    new_macro = create_macro_node(macro_name, macro_head);
-    
-    fgets(line, sizeof(line), input_file);
-
-    while (!(starts_with(line, MACRO_END))) {
+    new_macro = create_macro_node(macros, macro_name);
+    if (new_macro == NULL) {
+        return 1;
+    }
 
-        struct lines *new_line = malloc(sizeof(struct lines));
-        if (new_line == NULL) {
-            report_error(ERR_MEMORY_ALLOCATION, 0);
-            return 0;
-        }
-        
-        strcpy(new_line->line, line);
-        new_line->next = NULL;    
+    /* Find the closing endmacr and the size of the body, newlines included */
+    for (end = first; end < input->count && !starts_with(get_line(input, end), MACRO_END); end++) {
+        const char *line = get_line(input, end);
+        int length = strlen(line);
+        size += length + 1 + (line[length - 1] != '\n');
+    }
+    if (end >= input->count) {
+        report_diagnostic(ERR_MACRO_NAME_ERROR, get_line_number(input, *index), 1, "Macro without end: %s", macro_name);
+        return 1;
+    }
+    *index = end;
+    if (end == first) {
+        return 0;
+    }
 
-        if (new_macro->lines == NULL) {
-            /*If the list is empty, make new_line the first node*/
-            new_macro->lines = new_line;
-        }
-        else {
-            /*Traverse to the end of the list*/
-            struct lines* current = new_macro->lines;
-            while (current->next != NULL) {
-                current = current->next;
-            }
-            /*Append new_line at the end*/
-            current->next = new_line;
-        }
+    /* Copy the body once, giving every line a newline */
+    new_macro->body = arena_alloc(macros->arena, size);
+    new_macro->offsets = arena_alloc(macros->arena, sizeof(int) * (end - first));
+    if (new_macro->body == NULL || new_macro->offsets == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return 1;
+    }
+    for (i = first; i < end; i++) {
+        const char *line = get_line(input, i);
+        int length = strlen(line);
+        char *copy = new_macro->body + new_macro->body_length;
 
-        if (!(fgets(line, sizeof(line), input_file))) {
-            printf("Error: Macro without end.\n");
-            return 1;
+        memcpy(copy, line, length);
+        if (line[length - 1] != '\n') {
+            copy[length++] = '\n';
         }
+        copy[length] = '\0';
+        new_macro->offsets[new_macro->line_count++] = new_macro->body_length;
+        new_macro->body_length += length + 1;
     }
     return 0;
 }
 
-void expand_macro(const struct macros *macro, FILE *output_file) {
-    struct lines *current_line = macro->lines;
-    while (current_line != NULL) {
-        fputs(current_line->line, output_file);
-        if (current_line->line[strlen(current_line->line) - 1] != '\n') {
-            fputc('\n', output_file);
+int expand_macro(MacroTable *macros, struct macros *macro, LineBuffer *output, int line_number) {
+    const LineBuffer *lines = get_macro_expansion(macros, macro, line_number);
+
+    if (lines == NULL) {
+        return 0;
+    }
+    if (lines->count == 0) {
+        return 1;
+    }
+    return append_line_block(output, lines->text, lines->length, lines->offsets, lines->count);
+}
+
+int pre_process_buffer(const char *source, size_t length, const char *name, Arena *arena, LineBuffer *output) {
+    LineBuffer cleaned;
+    int status = NO_ERROR;
+    double started = trace_clock();
+
+    init_line_buffer(&cleaned);
+
+    status = clean_buffer(source, length, &cleaned);
+    if (status != NO_ERROR) {
+        if (name != NULL) {
+            report_message(stdout, "Error: Failed to clean file %s\n", name);
+        } else {
+            report_message(stdout, "Error: Failed to clean source\n");
+        }
+        /* Over-long lines were left out; the macros of the rest are still checked */
+        if (status == ERR_LINE_TOO_LONG) {
+            handle_macros(&cleaned, output, arena);
         }
-        current_line = current_line->next;
+    } else if (handle_macros(&cleaned, output, arena) != NO_ERROR) {
+        if (name != NULL) {
+            report_message(stdout, "Error: Failed to handle macros in file %s\n", name);
+        } else {
+            report_message(stdout, "Error: Failed to handle macros\n");
+        }
+        status = ERR_FILE_ACCESS;
     }
+
+    free_line_buffer(&cleaned);
+    trace_span("pre_process", started);
+    return status;
 }
 
-int pre_process(const char *filename, struct macros *macro_head) {
+int pre_process(const char *filename, Arena *arena, LineBuffer *output, int write_am) {
     char *as_filename = replace_file_extension(filename, ".as");
-    char *tmp_filename = replace_file_extension(filename, ".tmp");
     char *am_filename = replace_file_extension(filename, ".am");
+    LineBuffer cleaned;
     int status = NO_ERROR;
+    double started = trace_clock();
 
-    if (as_filename == NULL || tmp_filename == NULL || am_filename == NULL) {
-        printf("Error: Memory allocation failed in pre_process\n");
+    init_line_buffer(&cleaned);
+
+    if (as_filename == NULL || am_filename == NULL) {
+        report_message(stdout, "Error: Memory allocation failed in pre_process\n");
         status = ERR_MEMORY_ALLOCATION;
         goto cleanup;
     }
 
-    if (clean_file(as_filename, tmp_filename) != NO_ERROR) {
-        printf("Error: Failed to clean file %s\n", as_filename);
-        status = ERR_FILE_ACCESS;
+    status = clean_file(as_filename, &cleaned);
+    if (status != NO_ERROR) {
+        report_message(stdout, "Error: Failed to clean file %s\n", as_filename);
+        /* Over-long lines were left out; the macros of the rest are still checked */
+        if (status == ERR_LINE_TOO_LONG) {
+            handle_macros(&cleaned, output, arena);
+        }
         goto cleanup;
     }
 
-    if (handle_macros(am_filename, tmp_filename, macro_head) != NO_ERROR) {
-        printf("Error: Failed to handle macros in file %s\n", tmp_filename);
+    if (handle_macros(&cleaned, output, arena) != NO_ERROR) {
+        report_message(stdout, "Error: Failed to handle macros in file %s\n", as_filename);
         status = ERR_FILE_ACCESS;
         goto cleanup;
     }
 
+    /* The expanded source is only written to disk when requested for debugging */
+    if (write_am && !write_line_buffer(output, am_filename)) {
+        status = ERR_FILE_ACCESS;
+    }
+
 cleanup:
+    free_line_buffer(&cleaned);
     free(as_filename);
-    free(tmp_filename);
     free(am_filename);
+    trace_span("pre_process", started);
     return status;
 }
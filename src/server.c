@@ -0,0 +1,676 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "server.h"
+#include "assembler.h"
+#include "binary_table.h"
+#include "source.h"
+#include "utils.h"
+#include "error_handling.h"
+
+/* Bytes in a request header: the kind and the payload length */
+#define REQUEST_HEADER 5
+
+/* Bytes in a number of the protocol */
+#define NUMBER_LENGTH 4
+
+/* Sections of a reply: the three outputs, then the diagnostics */
+#define REPLY_SECTIONS 4
+
+/* Extensions of the output sections, in reply order */
+static const char *const OUTPUT_EXTENSIONS[REPLY_SECTIONS - 1] = {".ob", ".ent", ".ext"};
+
+/*
+ * @struct ByteBuffer
+ * A growable byte array: a request being read or a reply being built.
+ */
+typedef struct {
+    char *data;                  /* The bytes */
+    size_t length;               /* Number of bytes in use */
+    size_t capacity;             /* Number of bytes allocated */
+} ByteBuffer;
+
+/*
+ * @struct Server
+ * The listening socket shared by the workers.
+ */
+typedef struct {
+    int listener;                /* Listening socket */
+    int stopping;                /* Set once a stop request has been answered */
+    pthread_mutex_t lock;        /* Guards stopping */
+} Server;
+
+/*
+ * @struct ServerWorker
+ * A worker thread and the memory it keeps from one request to the next.
+ */
+typedef struct {
+    Server *server;              /* The server the worker accepts connections for */
+    pthread_t thread;            /* The worker thread */
+    AssemblyResult result;       /* Output of the last assembly; its buffers are reused */
+    ByteBuffer request;          /* Payload of the current request */
+    ByteBuffer reply;            /* Reply being built */
+} ServerWorker;
+
+static void init_byte_buffer(ByteBuffer *buffer) {
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+/* Make room for more bytes; returns 0 if allocation fails */
+static int reserve_bytes(ByteBuffer *buffer, size_t extra) {
+    if (buffer->length + extra > buffer->capacity) {
+        size_t new_capacity = buffer->capacity ? buffer->capacity : 256;
+        char *new_data;
+
+        while (new_capacity < buffer->length + extra) {
+            new_capacity *= 2;
+        }
+        new_data = realloc(buffer->data, new_capacity);
+        if (new_data == NULL) {
+            return 0;
+        }
+        buffer->data = new_data;
+        buffer->capacity = new_capacity;
+    }
+    return 1;
+}
+
+static int append_bytes(ByteBuffer *buffer, const char *bytes, size_t length) {
+    if (length == 0) {
+        return 1;
+    }
+    if (!reserve_bytes(buffer, length)) {
+        return 0;
+    }
+    memcpy(buffer->data + buffer->length, bytes, length);
+    buffer->length += length;
+    return 1;
+}
+
+static void put_number(unsigned char *out, unsigned long value) {
+    out[0] = (unsigned char)((value >> 24) & 0xFF);
+    out[1] = (unsigned char)((value >> 16) & 0xFF);
+    out[2] = (unsigned char)((value >> 8) & 0xFF);
+    out[3] = (unsigned char)(value & 0xFF);
+}
+
+static unsigned long get_number(const unsigned char *in) {
+    return ((unsigned long)in[0] << 24) | ((unsigned long)in[1] << 16) | ((unsigned long)in[2] << 8) | in[3];
+}
+
+static int append_number(ByteBuffer *buffer, unsigned long value) {
+    unsigned char number[NUMBER_LENGTH];
+
+    put_number(number, value);
+    return append_bytes(buffer, (const char *)number, NUMBER_LENGTH);
+}
+
+/* Write a whole buffer to a socket, retrying after short writes */
+static int send_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return 0;
+        }
+        data += written;
+        length -= written;
+    }
+    return 1;
+}
+
+/* Read exactly length bytes from a socket; returns 0 at end of stream or on error */
+static int receive_all(int fd, char *data, size_t length) {
+    while (length > 0) {
+        ssize_t received = read(fd, data, length);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return 0;
+        }
+        data += received;
+        length -= received;
+    }
+    return 1;
+}
+
+/* Fill in the address of a socket path; returns 0 if the path is too long */
+static int socket_address(const char *socket_path, struct sockaddr_un *address) {
+    if (strlen(socket_path) >= sizeof(address->sun_path)) {
+        return 0;
+    }
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, socket_path);
+    return 1;
+}
+
+const char *default_socket_path(void) {
+    static char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+
+    /* /tmp is shared by all users, so the name there carries the user id */
+    if (runtime != NULL && runtime[0] != '\0' && strlen(runtime) + strlen(DEFAULT_SOCKET_NAME) + 1 < sizeof(path)) {
+        sprintf(path, "%s/%s", runtime, DEFAULT_SOCKET_NAME);
+    } else {
+        sprintf(path, "/tmp/assembler-%lu.sock", (unsigned long)getuid());
+    }
+    return path;
+}
+
+/* Connect to a server; returns the socket, or -1 if nobody is listening */
+static int connect_server(const char *socket_path) {
+    struct sockaddr_un address;
+    int fd;
+
+    if (!socket_address(socket_path, &address)) {
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/* Append a section of .ent or .ext lines: the name and four-digit address of each symbol */
+static int append_symbols(ByteBuffer *reply, const AssembledSymbol *symbols, int count) {
+    size_t start;
+    int i;
+
+    /* The length is filled in once the lines are rendered */
+    if (!append_number(reply, 0)) {
+        return 0;
+    }
+    start = reply->length;
+    for (i = 0; i < count; i++) {
+        if (!reserve_bytes(reply, strlen(symbols[i].name) + OBJECT_LINE_MAX)) {
+            return 0;
+        }
+        reply->length += sprintf(reply->data + reply->length, "%s %04d\n", symbols[i].name, symbols[i].address);
+    }
+    put_number((unsigned char *)reply->data + start - NUMBER_LENGTH, reply->length - start);
+    return 1;
+}
+
+/* Build a reply; result is NULL when nothing was assembled */
+static int build_reply(ByteBuffer *reply, int status, const AssemblyResult *result, const DiagnosticBuffer *diagnostics) {
+    char *object = NULL;
+    size_t object_length = 0;
+    int produced = status == NO_ERROR && result != NULL;
+    int ok;
+
+    /* An empty image writes no .ob file */
+    if (produced && result->image.size > 0) {
+        object = format_binary_table(&result->image, &object_length);
+        if (object == NULL) {
+            status = ERR_MEMORY_ALLOCATION;
+            produced = 0;
+        }
+    }
+
+    reply->length = 0;
+    ok = append_number(reply, (unsigned long)status) &&
+         append_number(reply, object_length) && append_bytes(reply, object, object_length);
+    if (produced) {
+        ok = ok && append_symbols(reply, result->entries, result->entry_count) &&
+             append_symbols(reply, result->externs, result->extern_count);
+    } else {
+        ok = ok && append_number(reply, 0) && append_number(reply, 0);
+    }
+    ok = ok && append_number(reply, diagnostics->length) &&
+         append_bytes(reply, diagnostics->text, diagnostics->length);
+
+    free(object);
+    return ok;
+}
+
+/* Messages for a source that cannot be read, as assemble_file reports them */
+static void report_unreadable(const char *filename) {
+    const char *previous_source = set_diagnostic_source(filename);
+
+    report_diagnostic(ERR_FILE_ACCESS, 0, 0, "Could not open input file %s", filename);
+    report_message(stdout, "Error: Failed to clean file %s\n", filename);
+    report_message(stdout, "Error in pre-assembler stage\n");
+    set_diagnostic_source(previous_source);
+}
+
+/* Carry out the request in the worker's request buffer and build its reply; returns 0 to drop the connection */
+static int answer_request(ServerWorker *worker, int kind) {
+    DiagnosticBuffer messages;
+    DiagnosticBuffer *previous;
+    SourceFile file;
+    int status = NO_ERROR;
+    int ok;
+
+    if (kind == REQUEST_SOURCE) {
+        const char *name = worker->request.data;
+        const char *end = memchr(name, '\0', worker->request.length);
+
+        /* A source request without a name is malformed */
+        if (end == NULL) {
+            return 0;
+        }
+        end++;
+        reassemble_buffer(end, worker->request.length - (end - name), name, &worker->result);
+        return build_reply(&worker->reply, worker->result.status, &worker->result, &worker->result.diagnostics);
+    }
+
+    init_diagnostic_buffer(&messages);
+    if (kind == REQUEST_PATH) {
+        const char *path = worker->request.data;
+
+        if (open_source(path, &file) == NO_ERROR) {
+            reassemble_buffer(file.text, file.length, path, &worker->result);
+            close_source(&file);
+            return build_reply(&worker->reply, worker->result.status, &worker->result, &worker->result.diagnostics);
+        }
+        previous = capture_diagnostics(&messages);
+        report_unreadable(path);
+        capture_diagnostics(previous);
+        status = ERR_FILE_ACCESS;
+    }
+
+    /* A stop request, or a path that could not be read: nothing was assembled */
+    ok = build_reply(&worker->reply, status, NULL, &messages);
+    free_diagnostic_buffer(&messages);
+    return ok;
+}
+
+static int is_stopping(Server *server) {
+    int stopping;
+
+    pthread_mutex_lock(&server->lock);
+    stopping = server->stopping;
+    pthread_mutex_unlock(&server->lock);
+    return stopping;
+}
+
+/* Stop accepting connections; workers blocked in accept return at once */
+static void stop_serving(Server *server) {
+    pthread_mutex_lock(&server->lock);
+    server->stopping = 1;
+    pthread_mutex_unlock(&server->lock);
+    shutdown(server->listener, SHUT_RDWR);
+}
+
+/* Answer the requests of one connection until the client closes it */
+static void serve_connection(ServerWorker *worker, int fd) {
+    unsigned char header[REQUEST_HEADER];
+
+    while (receive_all(fd, (char *)header, REQUEST_HEADER)) {
+        int kind = header[0];
+        unsigned long length = get_number(header + 1);
+
+        /* A malformed request ends the connection */
+        if ((kind != REQUEST_SOURCE && kind != REQUEST_PATH && kind != REQUEST_STOP) || length > MAX_REQUEST_LENGTH) {
+            break;
+        }
+        worker->request.length = 0;
+        if (!reserve_bytes(&worker->request, length + 1) || !receive_all(fd, worker->request.data, length)) {
+            break;
+        }
+        worker->request.length = length;
+        worker->request.data[length] = '\0';
+
+        if (!answer_request(worker, kind) || !send_all(fd, worker->reply.data, worker->reply.length)) {
+            break;
+        }
+        if (kind == REQUEST_STOP) {
+            stop_serving(worker->server);
+            break;
+        }
+    }
+}
+
+/* Worker thread: serve one connection at a time until the server stops */
+static void *server_worker(void *argument) {
+    ServerWorker *worker = argument;
+
+    while (!is_stopping(worker->server)) {
+        int fd = accept(worker->server->listener, NULL, NULL);
+
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        serve_connection(worker, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+/* Bind and listen on a socket path, replacing a stale socket file; returns the socket or -1 */
+static int listen_on(const char *socket_path) {
+    struct sockaddr_un address;
+    struct stat info;
+    int fd;
+
+    if (!socket_address(socket_path, &address)) {
+        fprintf(stderr, "Error: Socket path too long: %s\n", socket_path);
+        return -1;
+    }
+
+    /* Only a socket nobody answers on is replaced; any other file is left alone */
+    fd = connect_server(socket_path);
+    if (fd >= 0) {
+        close(fd);
+        fprintf(stderr, "Error: A server is already listening on %s\n", socket_path);
+        return -1;
+    }
+    if (stat(socket_path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(socket_path);
+    }
+
+    /* The server reads files and stops on request, so only its owner may connect; nobody can before listen */
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || chmod(socket_path, 0600) != 0 ||
+                    listen(fd, SOMAXCONN) != 0)) {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot listen on %s\n", socket_path);
+    }
+    return fd;
+}
+
+int serve(const char *socket_path, int workers) {
+    ServerWorker *pool;
+    Server server;
+    int started = 0;
+    int i;
+
+    pool = malloc(sizeof(ServerWorker) * workers);
+    if (pool == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return ERR_MEMORY_ALLOCATION;
+    }
+    server.listener = listen_on(socket_path);
+    if (server.listener < 0) {
+        free(pool);
+        return ERR_FILE_ACCESS;
+    }
+    server.stopping = 0;
+    pthread_mutex_init(&server.lock, NULL);
+
+    /* A client that disconnects before its reply is sent must not end the server */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Assembling an empty source sets up the buffers every request reuses */
+    for (i = 0; i < workers; i++) {
+        pool[i].server = &server;
+        assemble_buffer("", 0, &pool[i].result);
+        init_byte_buffer(&pool[i].request);
+        init_byte_buffer(&pool[i].reply);
+    }
+    while (started < workers && pthread_create(&pool[started].thread, NULL, server_worker, &pool[started]) == 0) {
+        started++;
+    }
+
+    printf("Listening on %s with %d workers\n", socket_path, started ? started : 1);
+    fflush(stdout);
+
+    /* Serve from this thread if no worker could be started */
+    if (started == 0) {
+        server_worker(&pool[0]);
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(pool[i].thread, NULL);
+    }
+
+    close(server.listener);
+    unlink(socket_path);
+    pthread_mutex_destroy(&server.lock);
+    for (i = 0; i < workers; i++) {
+        free_assembly_result(&pool[i].result);
+        free(pool[i].request.data);
+        free(pool[i].reply.data);
+    }
+    free(pool);
+    return NO_ERROR;
+}
+
+static int send_request(int fd, int kind, const char *payload, size_t length) {
+    unsigned char header[REQUEST_HEADER];
+
+    header[0] = (unsigned char)kind;
+    put_number(header + 1, length);
+    return send_all(fd, (const char *)header, REQUEST_HEADER) && send_all(fd, payload, length);
+}
+
+/* Send a source request: the name of the file, a null byte, then its contents */
+static int send_source(int fd, const char *name, const SourceFile *source) {
+    size_t name_length = strlen(name) + 1;
+    unsigned char header[REQUEST_HEADER];
+
+    header[0] = REQUEST_SOURCE;
+    put_number(header + 1, name_length + source->length);
+    return send_all(fd, (const char *)header, REQUEST_HEADER) && send_all(fd, name, name_length) &&
+           send_all(fd, source->text, source->length);
+}
+
+/* Read a reply: the status, and the four sections back to back in one buffer */
+static int receive_reply(int fd, ByteBuffer *reply, int *status, size_t *sections) {
+    unsigned char number[NUMBER_LENGTH];
+    int i;
+
+    reply->length = 0;
+    if (!reserve_bytes(reply, 1) || !receive_all(fd, (char *)number, NUMBER_LENGTH)) {
+        return 0;
+    }
+    *status = (int)get_number(number);
+    for (i = 0; i < REPLY_SECTIONS; i++) {
+        if (!receive_all(fd, (char *)number, NUMBER_LENGTH)) {
+            return 0;
+        }
+        sections[i] = get_number(number);
+        if (!reserve_bytes(reply, sections[i]) || !receive_all(fd, reply->data + reply->length, sections[i])) {
+            return 0;
+        }
+        reply->length += sections[i];
+    }
+    return 1;
+}
+
+/* Absolute path of a file, for the server to open; returns NULL if allocation fails */
+static char *absolute_path(const char *filename) {
+    char directory[4096];
+    char *path;
+
+    if (filename[0] == '/' || getcwd(directory, sizeof(directory)) == NULL) {
+        return my_strdup(filename);
+    }
+    path = malloc(strlen(directory) + strlen(filename) + 2);
+    if (path != NULL) {
+        sprintf(path, "%s/%s", directory, filename);
+    }
+    return path;
+}
+
+/* Write one output section of a reply to its file */
+static int write_output(const char *base_filename, int output, const char *data, size_t length) {
+    char *name = add_file_extension(base_filename, OUTPUT_EXTENSIONS[output]);
+    FILE *file;
+    int ok;
+
+    if (name == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return 0;
+    }
+    file = fopen(name, "w");
+    if (file == NULL) {
+        report_message(stderr, "Error: Could not open %s for writing\n", name);
+        free(name);
+        return 0;
+    }
+    ok = fwrite(data, 1, length, file) == length;
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        report_message(stderr, "Error writing file %s\n", name);
+    }
+    free(name);
+    return ok;
+}
+
+/* Assemble one file on the server; returns its status, or -1 if the connection was lost */
+static int assemble_remote_file(int fd, const char *filename, int send_paths, ByteBuffer *reply) {
+    size_t sections[REPLY_SECTIONS];
+    DiagnosticBuffer messages;
+    SourceFile source;
+    char *as_filename;
+    char *base_filename;
+    char *dot;
+    size_t offset = 0;
+    int sent = 0;
+    int status;
+    int i;
+
+    /* Same checks and messages as assemble_file */
+    dot = strrchr(filename, '.');
+    if (dot && (strcmp(dot + 1, "as") != 0)) {
+        const char *previous_source = set_diagnostic_source(filename);
+        report_diagnostic(ERR_FILE_ACCESS, 0, 0, "Wrong File Extension");
+        set_diagnostic_source(previous_source);
+        return ERR_FILE_ACCESS;
+    }
+    as_filename = replace_file_extension(filename, ".as");
+    base_filename = remove_extension(filename);
+    if (as_filename == NULL || base_filename == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        free(as_filename);
+        free(base_filename);
+        return ERR_MEMORY_ALLOCATION;
+    }
+
+    if (send_paths) {
+        char *path = absolute_path(as_filename);
+        sent = path != NULL && send_request(fd, REQUEST_PATH, path, strlen(path));
+        free(path);
+    } else if (open_source(as_filename, &source) == NO_ERROR) {
+        sent = send_source(fd, as_filename, &source);
+        close_source(&source);
+    } else {
+        report_unreadable(as_filename);
+        free(as_filename);
+        free(base_filename);
+        return ERR_FILE_ACCESS;
+    }
+    if (!sent || !receive_reply(fd, reply, &status, sections)) {
+        free(as_filename);
+        free(base_filename);
+        return -1;
+    }
+
+    /* The diagnostics follow the three outputs */
+    messages.text = reply->data + sections[0] + sections[1] + sections[2];
+    messages.length = sections[3];
+    messages.capacity = sections[3];
+    flush_diagnostics(&messages);
+
+    for (i = 0; i < REPLY_SECTIONS - 1 && status == NO_ERROR; i++) {
+        if (sections[i] > 0 && !write_output(base_filename, i, reply->data + offset, sections[i])) {
+            status = ERR_FILE_ACCESS;
+        }
+        offset += sections[i];
+    }
+
+    free(as_filename);
+    free(base_filename);
+    return status;
+}
+
+int assemble_remote(const char *socket_path, char *const *filenames, int count, int send_paths) {
+    int *statuses = malloc(sizeof(int) * count);
+    ByteBuffer reply;
+    int status = NO_ERROR;
+    int failed = 0;
+    int fd;
+    int i;
+
+    if (statuses == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return ERR_MEMORY_ALLOCATION;
+    }
+    fd = connect_server(socket_path);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot connect to assembler server at %s\n", socket_path);
+        free(statuses);
+        return ERR_FILE_ACCESS;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    init_byte_buffer(&reply);
+
+    for (i = 0; i < count; i++) {
+        statuses[i] = assemble_remote_file(fd, filenames[i], send_paths, &reply);
+        if (statuses[i] < 0) {
+            fprintf(stderr, "Error: Lost connection to assembler server at %s\n", socket_path);
+            for (; i < count; i++) {
+                statuses[i] = ERR_FILE_ACCESS;
+            }
+        }
+    }
+    close(fd);
+    free(reply.data);
+
+    /* Summarize as assemble_files does: the first failure decides the exit status */
+    for (i = 0; i < count; i++) {
+        if (statuses[i] != NO_ERROR) {
+            if (status == NO_ERROR) {
+                status = statuses[i];
+            }
+            failed++;
+        }
+    }
+    if (count > 1) {
+        for (i = 0; i < count; i++) {
+            if (statuses[i] != NO_ERROR) {
+                fprintf(stderr, "Failed: %s (error %d)\n", filenames[i], statuses[i]);
+            }
+        }
+        fprintf(stderr, "%d of %d files assembled\n", count - failed, count);
+    }
+
+    free(statuses);
+    return status;
+}
+
+int stop_server(const char *socket_path) {
+    size_t sections[REPLY_SECTIONS];
+    ByteBuffer reply;
+    int reply_status;
+    int status = ERR_FILE_ACCESS;
+    int fd = connect_server(socket_path);
+
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot connect to assembler server at %s\n", socket_path);
+        return ERR_FILE_ACCESS;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    init_byte_buffer(&reply);
+    if (send_request(fd, REQUEST_STOP, NULL, 0) && receive_reply(fd, &reply, &reply_status, sections)) {
+        status = NO_ERROR;
+    }
+    close(fd);
+    free(reply.data);
+    return status;
+}
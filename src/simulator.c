@@ -0,0 +1,390 @@
+#include "simulator.h"
+#include "instruction_table.h"
+#include "error_handling.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Fields of an instruction word */
+#define OPCODE_SHIFT 11
+#define SOURCE_MODE_SHIFT 7
+#define TARGET_MODE_SHIFT 3
+#define MODE_MASK 0xF
+
+/* Addressing modes, one bit each as encoded */
+#define MODE_NONE 0
+#define MODE_IMMEDIATE 1
+#define MODE_DIRECT 2
+#define MODE_INDIRECT_REGISTER 4
+#define MODE_REGISTER 8
+
+/* ARE field of a word */
+#define ARE_MASK 0x7
+#define ARE_ABSOLUTE 0x4
+#define ARE_RELOCATABLE 0x2
+#define ARE_EXTERNAL 0x1
+
+/* Value fields of operand words */
+#define FIELD_SHIFT 3
+#define IMMEDIATE_MASK 0xFFF
+#define IMMEDIATE_SIGN 0x800
+#define ADDRESS_MASK 0xFFF
+#define SOURCE_REGISTER_SHIFT 6
+#define TARGET_REGISTER_SHIFT 3
+#define REGISTER_MASK 0x7
+
+/* Machine words are 15 bits wide */
+#define WORD_MASK 0x7FFF
+
+/* Slot of each mode field in INSTRUCTION_FORMS, -1 for fields with more than one bit */
+static const int MODE_SLOTS[MODE_MASK + 1] = {
+    OPERAND_SLOT_NONE, 1, 2, -1, 3, -1, -1, -1, 4, -1, -1, -1, -1, -1, -1, -1
+};
+
+/* Stop the run with a fault at an instruction */
+static DecodedInstruction *fault(Machine *machine, const DecodedInstruction *instruction, const char *reason) {
+    machine->fault = reason;
+    machine->fault_address = instruction->address;
+    return NULL;
+}
+
+/* Handler of a word that cannot run */
+static DecodedInstruction *invalid(Machine *machine, DecodedInstruction *instruction) {
+    return fault(machine, instruction, instruction->fault);
+}
+
+static DecodedInstruction *decode(Machine *machine, DecodedInstruction *instruction);
+
+/* Force the records that could include a word to be decoded again */
+static void invalidate(Machine *machine, int address) {
+    int first = address >= 2 ? address - 2 : 0;
+
+    for (; first <= address; first++) {
+        machine->decoded[first].handler = decode;
+    }
+}
+
+/* Address of a memory operand, or -1 if an indirect register points outside memory */
+static int operand_address(const Machine *machine, int mode, int operand) {
+    int address = mode == MODE_DIRECT ? operand : machine->registers[operand];
+
+    return address < MAX_MEMORY_WORDS ? address : -1;
+}
+
+/* Read an operand; returns 0 if it lies outside memory */
+static int load(const Machine *machine, int mode, int operand, unsigned int *value) {
+    int address;
+
+    switch (mode) {
+        case MODE_IMMEDIATE:
+            *value = (unsigned int)operand & WORD_MASK;
+            return 1;
+        case MODE_REGISTER:
+            *value = machine->registers[operand];
+            return 1;
+        default:
+            address = operand_address(machine, mode, operand);
+            if (address < 0) {
+                return 0;
+            }
+            *value = machine->memory[address];
+            return 1;
+    }
+}
+
+/* Write an operand; returns 0 if it lies outside memory */
+static int store(Machine *machine, int mode, int operand, unsigned int value) {
+    int address;
+
+    if (mode == MODE_REGISTER) {
+        machine->registers[operand] = (unsigned short)(value & WORD_MASK);
+        return 1;
+    }
+    address = operand_address(machine, mode, operand);
+    if (address < 0) {
+        return 0;
+    }
+    machine->memory[address] = (unsigned short)(value & WORD_MASK);
+    invalidate(machine, address);
+    return 1;
+}
+
+/* Address a jump operand leads to, or -1 if it lies outside memory */
+static int jump_target(const Machine *machine, const DecodedInstruction *instruction) {
+    return operand_address(machine, instruction->target_mode, instruction->target);
+}
+
+/* Apply a two-operand operation: target = source OP target */
+#define BINARY_HANDLER(name, expression)                                                          \
+    static DecodedInstruction *name(Machine *machine, DecodedInstruction *instruction) {           \
+        unsigned int source;                                                                      \
+        unsigned int target;                                                                      \
+                                                                                                  \
+        if (!load(machine, instruction->source_mode, instruction->source, &source) ||             \
+            !load(machine, instruction->target_mode, instruction->target, &target) ||             \
+            !store(machine, instruction->target_mode, instruction->target, (expression))) {       \
+            return fault(machine, instruction, "operand address outside memory");                 \
+        }                                                                                         \
+        return instruction->next;                                                                 \
+    }
+
+/* Apply a one-operand operation: target = OP target */
+#define UNARY_HANDLER(name, expression)                                                           \
+    static DecodedInstruction *name(Machine *machine, DecodedInstruction *instruction) {           \
+        unsigned int target;                                                                      \
+                                                                                                  \
+        if (!load(machine, instruction->target_mode, instruction->target, &target) ||             \
+            !store(machine, instruction->target_mode, instruction->target, (expression))) {       \
+            return fault(machine, instruction, "operand address outside memory");                 \
+        }                                                                                         \
+        return instruction->next;                                                                 \
+    }
+
+BINARY_HANDLER(execute_mov, source)
+BINARY_HANDLER(execute_add, source + target)
+BINARY_HANDLER(execute_sub, target - source)
+UNARY_HANDLER(execute_clr, 0)
+UNARY_HANDLER(execute_not, ~target)
+UNARY_HANDLER(execute_inc, target + 1)
+UNARY_HANDLER(execute_dec, target - 1)
+
+static DecodedInstruction *execute_cmp(Machine *machine, DecodedInstruction *instruction) {
+    unsigned int source;
+    unsigned int target;
+
+    if (!load(machine, instruction->source_mode, instruction->source, &source) ||
+        !load(machine, instruction->target_mode, instruction->target, &target)) {
+        return fault(machine, instruction, "operand address outside memory");
+    }
+    machine->zero = ((source - target) & WORD_MASK) == 0;
+    return instruction->next;
+}
+
+/* lea stores the address of its (direct) source */
+static DecodedInstruction *execute_lea(Machine *machine, DecodedInstruction *instruction) {
+    if (!store(machine, instruction->target_mode, instruction->target, (unsigned int)instruction->source)) {
+        return fault(machine, instruction, "operand address outside memory");
+    }
+    return instruction->next;
+}
+
+static DecodedInstruction *execute_jmp(Machine *machine, DecodedInstruction *instruction) {
+    int target = jump_target(machine, instruction);
+
+    if (target < 0) {
+        return fault(machine, instruction, "jump outside memory");
+    }
+    return &machine->decoded[target];
+}
+
+static DecodedInstruction *execute_bne(Machine *machine, DecodedInstruction *instruction) {
+    return machine->zero ? instruction->next : execute_jmp(machine, instruction);
+}
+
+static DecodedInstruction *execute_red(Machine *machine, DecodedInstruction *instruction) {
+    int c = getc(machine->input);
+
+    if (!store(machine, instruction->target_mode, instruction->target, (unsigned int)(c == EOF ? -1 : c))) {
+        return fault(machine, instruction, "operand address outside memory");
+    }
+    return instruction->next;
+}
+
+static DecodedInstruction *execute_prn(Machine *machine, DecodedInstruction *instruction) {
+    unsigned int value;
+
+    if (!load(machine, instruction->target_mode, instruction->target, &value)) {
+        return fault(machine, instruction, "operand address outside memory");
+    }
+    putc((int)(value & 0xFF), machine->output);
+    return instruction->next;
+}
+
+static DecodedInstruction *execute_jsr(Machine *machine, DecodedInstruction *instruction) {
+    if (machine->stack_depth == SIMULATOR_STACK_DEPTH) {
+        return fault(machine, instruction, "return address stack overflow");
+    }
+    machine->stack[machine->stack_depth++] = (int)(instruction->next - machine->decoded);
+    return execute_jmp(machine, instruction);
+}
+
+static DecodedInstruction *execute_rts(Machine *machine, DecodedInstruction *instruction) {
+    if (machine->stack_depth == 0) {
+        return fault(machine, instruction, "rts with an empty return address stack");
+    }
+    return &machine->decoded[machine->stack[--machine->stack_depth]];
+}
+
+static DecodedInstruction *execute_stop(Machine *machine, DecodedInstruction *instruction) {
+    (void)machine;
+    (void)instruction;
+    return NULL;
+}
+
+/* Handlers indexed by opcode, in the order of OPCODES */
+static const InstructionHandler HANDLERS[] = {
+    execute_mov, execute_cmp, execute_add, execute_sub,
+    execute_lea, execute_clr, execute_not, execute_inc,
+    execute_dec, execute_jmp, execute_bne, execute_red,
+    execute_prn, execute_jsr, execute_rts, execute_stop
+};
+
+/* Decode the value of one operand word; returns a reason if it cannot run, NULL if it can */
+static const char *decode_operand(unsigned short word, int mode, int register_shift, int *operand) {
+    switch (mode) {
+        case MODE_IMMEDIATE:
+            *operand = (word >> FIELD_SHIFT) & IMMEDIATE_MASK;
+            if (*operand & IMMEDIATE_SIGN) {
+                *operand -= IMMEDIATE_MASK + 1;
+            }
+            return (word & ARE_MASK) == ARE_ABSOLUTE ? NULL : "immediate operand word is not absolute";
+        case MODE_DIRECT:
+            *operand = (word >> FIELD_SHIFT) & ADDRESS_MASK;
+            if ((word & ARE_MASK) == ARE_EXTERNAL) {
+                return "unresolved external operand";
+            }
+            return (word & ARE_MASK) == ARE_RELOCATABLE ? NULL : "direct operand word is not relocatable";
+        default:
+            *operand = (word >> register_shift) & REGISTER_MASK;
+            return NULL;
+    }
+}
+
+/* Decode the instruction word at an address into its record */
+static void decode_at(Machine *machine, int address) {
+    DecodedInstruction *instruction = &machine->decoded[address];
+    unsigned short word = machine->memory[address];
+    int opcode = (word >> OPCODE_SHIFT) & MODE_MASK;
+    int source_mode = (word >> SOURCE_MODE_SHIFT) & MODE_MASK;
+    int target_mode = (word >> TARGET_MODE_SHIFT) & MODE_MASK;
+    int registers_share = (source_mode & (MODE_INDIRECT_REGISTER | MODE_REGISTER)) &&
+                          (target_mode & (MODE_INDIRECT_REGISTER | MODE_REGISTER));
+    const InstructionForm *form = NULL;
+    int length = 1;
+    const char *reason = NULL;
+
+    instruction->address = address;
+    instruction->source_mode = source_mode;
+    instruction->source = 0;
+    instruction->target_mode = target_mode;
+    instruction->target = 0;
+
+    /* Each mode field holds at most one bit, and the assembler must accept the form */
+    if (MODE_SLOTS[source_mode] >= 0 && MODE_SLOTS[target_mode] >= 0) {
+        form = &INSTRUCTION_FORMS[opcode][MODE_SLOTS[source_mode]][MODE_SLOTS[target_mode]];
+        length = form->word_count;
+    }
+    if ((word & ARE_MASK) != ARE_ABSOLUTE) {
+        reason = "not an instruction word";
+    } else if (form == NULL || !form->legal) {
+        reason = "invalid addressing modes for the opcode";
+    } else if (address + length > MAX_MEMORY_WORDS) {
+        reason = "instruction runs past the end of memory";
+    } else if (registers_share) {
+        decode_operand(machine->memory[address + 1], source_mode, SOURCE_REGISTER_SHIFT, &instruction->source);
+        decode_operand(machine->memory[address + 1], target_mode, TARGET_REGISTER_SHIFT, &instruction->target);
+    } else {
+        int next_word = address + 1;
+
+        if (source_mode != MODE_NONE) {
+            reason = decode_operand(machine->memory[next_word++], source_mode, SOURCE_REGISTER_SHIFT,
+                                    &instruction->source);
+        }
+        if (reason == NULL && target_mode != MODE_NONE) {
+            reason = decode_operand(machine->memory[next_word], target_mode, TARGET_REGISTER_SHIFT,
+                                    &instruction->target);
+        }
+    }
+
+    if (reason != NULL) {
+        instruction->handler = invalid;
+        instruction->fault = reason;
+        instruction->next = NULL;
+    } else {
+        instruction->handler = HANDLERS[opcode];
+        instruction->fault = NULL;
+        instruction->next = &machine->decoded[address + length];
+    }
+}
+
+/* Handler of a record not decoded yet (or invalidated by a store): decode it, then run it */
+static DecodedInstruction *decode(Machine *machine, DecodedInstruction *instruction) {
+    int address = (int)(instruction - machine->decoded);
+
+    decode_at(machine, address);
+    return instruction->handler(machine, instruction);
+}
+
+/* Handler of the record one past the end of memory */
+static DecodedInstruction *past_end(Machine *machine, DecodedInstruction *instruction) {
+    return fault(machine, instruction, "execution ran past the end of memory");
+}
+
+int load_machine(Machine *machine, const ObjectModule *program, FILE *input, FILE *output) {
+    int total = program->instruction_count + program->data_count;
+    int i;
+
+    if (program->extern_count > 0) {
+        report_message(stderr, "Error: The program references %d extern symbols; link it first\n",
+                       program->extern_count);
+        return ERR_PROCESSING_FAILED;
+    }
+    if (program->base < 0 || program->base + total > MAX_MEMORY_WORDS) {
+        report_message(stderr, "Error: The program does not fit in the %d-word memory\n", MAX_MEMORY_WORDS);
+        return ERR_PROCESSING_FAILED;
+    }
+
+    memset(machine->memory, 0, sizeof(machine->memory));
+    memset(machine->registers, 0, sizeof(machine->registers));
+    for (i = 0; i < total; i++) {
+        machine->memory[program->base + i] = program->words[i] & WORD_MASK;
+    }
+    machine->zero = 0;
+    machine->stack_depth = 0;
+    machine->start = program->base;
+    machine->steps = 0;
+    machine->fault = NULL;
+    machine->fault_address = 0;
+    machine->input = input;
+    machine->output = output;
+
+    /* Decode the instructions up front; any other word is decoded if execution reaches it */
+    for (i = 0; i < MAX_MEMORY_WORDS; i++) {
+        machine->decoded[i].handler = decode;
+        machine->decoded[i].address = i;
+    }
+    for (i = 0; i < program->instruction_count; i++) {
+        decode_at(machine, program->base + i);
+    }
+    machine->decoded[MAX_MEMORY_WORDS].handler = past_end;
+    machine->decoded[MAX_MEMORY_WORDS].address = MAX_MEMORY_WORDS;
+    return NO_ERROR;
+}
+
+int run_machine(Machine *machine, unsigned long step_limit) {
+    DecodedInstruction *instruction = &machine->decoded[machine->start];
+    unsigned long steps = 0;
+
+    machine->fault = NULL;
+    if (step_limit == 0) {
+        while (instruction != NULL) {
+            instruction = instruction->handler(machine, instruction);
+            steps++;
+        }
+    } else {
+        while (instruction != NULL && steps < step_limit) {
+            instruction = instruction->handler(machine, instruction);
+            steps++;
+        }
+    }
+    machine->steps += steps;
+    if (instruction != NULL) {
+        machine->start = instruction->address;
+        return SIMULATOR_STEP_LIMIT;
+    }
+    if (machine->fault != NULL) {
+        /* The faulting instruction did not complete */
+        machine->steps--;
+        return SIMULATOR_FAULT;
+    }
+    return SIMULATOR_HALTED;
+}
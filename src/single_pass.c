@@ -0,0 +1,169 @@
+#include "single_pass.h"
+#include "second_pass.h"
+#include "instruction_table.h"
+#include "error_handling.h"
+#include <stdlib.h>
+
+/* Queue work for the end of the file */
+static int add_fixup(SinglePassResult *result, FixupKind kind, int word, int name, int line_number, int column) {
+    Fixup *fixup;
+
+    if (result->fixup_count >= result->fixup_capacity) {
+        int new_capacity = result->fixup_capacity ? result->fixup_capacity * 2 : 16;
+        Fixup *temp = realloc(result->fixups, sizeof(Fixup) * new_capacity);
+        if (temp == NULL) {
+            report_error(ERR_MEMORY_ALLOCATION, 0);
+            return 0;
+        }
+        result->fixups = temp;
+        result->fixup_capacity = new_capacity;
+    }
+
+    fixup = &result->fixups[result->fixup_count++];
+    fixup->kind = kind;
+    fixup->word = word;
+    fixup->name = name;
+    fixup->line_number = line_number;
+    fixup->column = column;
+    return 1;
+}
+
+/*
+ * @struct OperandContext
+ * Where the direct operands of an instruction being encoded go.
+ */
+typedef struct {
+    SinglePassResult *result;   /* Receives the fixups */
+    const IrLine *line;         /* The instruction */
+} OperandContext;
+
+/* Leave a placeholder for a direct operand and queue it for the end of the file */
+static int queue_direct_operand(void *context, const IrOperand *operand, int index, unsigned short *word) {
+    OperandContext *operands = context;
+
+    /* The instruction's words are appended to the image after encoding */
+    *word = 0;
+    if (!add_fixup(operands->result, FIXUP_OPERAND, operands->result->image.size + index, operand->value,
+                   operands->line->line_number, operand->column)) {
+        return ERR_MEMORY_ALLOCATION;
+    }
+    return NO_ERROR;
+}
+
+/* Encode one IR line into the instruction or data image */
+static int encode_line(SinglePassResult *result, const IrLine *line) {
+    const IrProgram *program = &result->pass.program;
+    const InstructionForm *form;
+    unsigned short words[MAX_INSTRUCTION_WORDS];
+    OperandContext context;
+    int dc = result->data.size;
+    int status;
+    int i;
+
+    switch (line->kind) {
+        case IR_DATA:
+            return handle_data_directive(line, program, &result->data, &dc);
+        case IR_ENTRY:
+            return add_fixup(result, FIXUP_ENTRY, -1, line->payload, line->line_number, line->column) ? NO_ERROR : ERR_MEMORY_ALLOCATION;
+        case IR_INSTRUCTION:
+            break;
+    }
+
+    form = get_instruction_form(line);
+    context.result = result;
+    context.line = line;
+    status = form->encode(line, words, queue_direct_operand, &context);
+    for (i = 0; status == NO_ERROR && i < form->word_count; i++) {
+        if (!add_binary_word(&result->image, 100 + result->image.size, words[i])) {
+            return ERR_MEMORY_ALLOCATION;
+        }
+    }
+    return status;
+}
+
+int single_pass(const LineBuffer *source, Arena *arena, SinglePassResult *result) {
+    int index;
+    int encoded = 0;
+    int status;
+    int flag = 0;
+
+    result->fixups = NULL;
+    result->fixup_count = 0;
+    result->fixup_capacity = 0;
+    begin_first_pass(&result->pass, arena);
+    if (!init_binary_table(&result->image) | !init_binary_table(&result->data)) {
+        result->pass.errorFlag = ERR_MEMORY_ALLOCATION;
+        return result->pass.errorFlag;
+    }
+
+    for (index = 0; index < source->count; index++) {
+        status = first_pass_line(&result->pass, get_line(source, index), get_line_number(source, index), &flag);
+
+        /* Encode whatever the line added to the IR; a bad line adds nothing, so the rest can go on */
+        while (status == NO_ERROR && encoded < result->pass.program.count) {
+            status = encode_line(result, &result->pass.program.lines[encoded++]);
+        }
+        if (status != NO_ERROR && result->pass.errorFlag == NO_ERROR) {
+            result->pass.errorFlag = status;
+        }
+        if (status == ERR_MEMORY_ALLOCATION) {
+            break;
+        }
+    }
+
+    end_first_pass(&result->pass, flag);
+    return result->pass.errorFlag;
+}
+
+int resolve_fixups(SinglePassResult *result) {
+    const IrProgram *program = &result->pass.program;
+    SymbolTable *symbol_table = &result->pass.symbolTable;
+    int data_start = 100 + result->image.size;
+    int status = NO_ERROR;
+    int first_error = NO_ERROR;
+    int i;
+
+    /* Backpatch operands and apply entries in source order, reporting every unknown symbol */
+    for (i = 0; i < result->fixup_count; i++) {
+        const Fixup *fixup = &result->fixups[i];
+        const char *name = get_ir_name(program, fixup->name);
+
+        if (fixup->kind == FIXUP_ENTRY) {
+            status = handle_entry_directive(name, symbol_table, fixup->line_number, fixup->column);
+        } else {
+            BinaryWord *word = &result->image.words[fixup->word];
+            unsigned short value = 0;
+            status = encode_direct_operand(name, symbol_table, word->address, fixup->line_number, fixup->column, &value);
+            word->value = value & 0x7FFF;
+        }
+        if (status == ERR_MEMORY_ALLOCATION) {
+            return status;
+        }
+        if (status != NO_ERROR && first_error == NO_ERROR) {
+            first_error = status;
+        }
+    }
+    if (first_error != NO_ERROR) {
+        return first_error;
+    }
+
+    /* The data segment follows the code */
+    for (i = 0; i < result->data.size; i++) {
+        if (!add_binary_word(&result->image, data_start + result->data.words[i].address, result->data.words[i].value)) {
+            return ERR_MEMORY_ALLOCATION;
+        }
+        result->image.data++;
+    }
+    return NO_ERROR;
+}
+
+void free_single_pass(SinglePassResult *result) {
+    free_binary_table(&result->image);
+    free_binary_table(&result->data);
+    free(result->fixups);
+    result->fixups = NULL;
+    result->fixup_count = 0;
+    result->fixup_capacity = 0;
+    free_ir_program(&result->pass.program);
+    free_symbol_table(&result->pass.symbolTable);
+}
@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "source.h"
+#include "error_handling.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(SOURCE_NO_SIMD)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define SOURCE_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SOURCE_SSE2
+#endif
+
+/* Contents of an empty file; never freed */
+static const char empty_source[] = "";
+
+/* Read a file that cannot be mapped (a pipe, for example) into the heap */
+static int read_source(int fd, SourceFile *file) {
+    char *text = NULL;
+    size_t capacity = 0;
+    ssize_t count;
+
+    file->length = 0;
+    do {
+        if (file->length == capacity) {
+            char *new_text;
+            capacity = capacity ? capacity * 2 : 4096;
+            new_text = realloc(text, capacity);
+            if (new_text == NULL) {
+                free(text);
+                report_error(ERR_MEMORY_ALLOCATION, 0);
+                return ERR_MEMORY_ALLOCATION;
+            }
+            text = new_text;
+        }
+        count = read(fd, text + file->length, capacity - file->length);
+        if (count < 0) {
+            free(text);
+            return ERR_FILE_ACCESS;
+        }
+        file->length += count;
+    } while (count > 0);
+
+    file->text = text;
+    file->mapped = 0;
+    return NO_ERROR;
+}
+
+int open_source(const char *filename, SourceFile *file) {
+    struct stat info;
+    void *mapping;
+    int fd;
+    int status = NO_ERROR;
+
+    file->text = NULL;
+    file->length = 0;
+    file->mapped = 0;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return ERR_FILE_ACCESS;
+    }
+
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        /* An empty file has nothing to map */
+        if (info.st_size == 0) {
+            file->text = empty_source;
+            close(fd);
+            return NO_ERROR;
+        }
+        mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            file->text = mapping;
+            file->length = (size_t)info.st_size;
+            file->mapped = 1;
+            close(fd);
+            return NO_ERROR;
+        }
+    }
+
+    status = read_source(fd, file);
+    close(fd);
+    return status;
+}
+
+void close_source(SourceFile *file) {
+    if (file->mapped) {
+        munmap((void *)file->text, file->length);
+    } else if (file->text != NULL && file->text != empty_source) {
+        free((void *)file->text);
+    }
+    file->text = NULL;
+    file->length = 0;
+    file->mapped = 0;
+}
+
+void init_line_scanner(LineScanner *scanner, const char *text, size_t length) {
+    scanner->cursor = text;
+    scanner->end = text + length;
+    scanner->number = 0;
+}
+
+int next_line(LineScanner *scanner, LineView *line) {
+    const char *newline;
+
+    if (scanner->cursor >= scanner->end) {
+        return 0;
+    }
+
+    newline = memchr(scanner->cursor, '\n', scanner->end - scanner->cursor);
+    line->start = scanner->cursor;
+    line->length = newline ? (int)(newline - scanner->cursor) + 1 : (int)(scanner->end - scanner->cursor);
+    line->number = ++scanner->number;
+    scanner->cursor += line->length;
+    return 1;
+}
+
+int line_content_length(const LineView *line) {
+    int length = line->length;
+
+    if (length > 0 && line->start[length - 1] == '\n') {
+        length--;
+        if (length > 0 && line->start[length - 1] == '\r') {
+            length--;
+        }
+    }
+    return length;
+}
+
+#if defined(SOURCE_AVX2) || defined(SOURCE_SSE2)
+/* Index of the lowest set bit of a non-zero mask */
+static int lowest_bit(unsigned int mask) {
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    int bit = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+#endif
+
+const char *skip_blanks(const char *text, const char *end) {
+#if defined(SOURCE_AVX2)
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+
+    while (end - text >= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)text);
+        unsigned int blanks = (unsigned int)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(block, tab)));
+        if (blanks != 0xFFFFFFFFu) {
+            return text + lowest_bit(~blanks);
+        }
+        text += 32;
+    }
+#elif defined(SOURCE_SSE2)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+
+    while (end - text >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)text);
+        unsigned int blanks = (unsigned int)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab)));
+        if (blanks != 0xFFFFu) {
+            return text + lowest_bit(~blanks);
+        }
+        text += 16;
+    }
+#endif
+    /* Scalar fallback, also used for the tail of the buffer */
+    while (text < end && (*text == ' ' || *text == '\t')) {
+        text++;
+    }
+    return text;
+}
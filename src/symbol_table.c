@@ -3,44 +3,88 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <ctype.h>
 #include "common.h"
-#include "pre_assembler.h"
 #include "utils.h"
 
-ExternReference* extern_references = NULL;
-
-void add_extern_reference(const char *name, int address) {
-    ExternReference *new_ref = malloc(sizeof(ExternReference));
+int add_extern_reference(SymbolTable *symbol_table, const char *name, int address) {
+    ExternReference *new_ref = arena_alloc(symbol_table->arena, sizeof(ExternReference));
     if (new_ref == NULL) {
-        report_error(ERR_MEMORY_ALLOCATION, 0);
-        return;
+        return 0;
+    }
+    new_ref->name = arena_strndup(symbol_table->arena, name, strlen(name));
+    if (new_ref->name == NULL) {
+        return 0;
     }
-    new_ref->name = my_strdup(name);
     new_ref->address = address;
-    new_ref->next = extern_references;
-    extern_references = new_ref;
+    new_ref->next = symbol_table->externs;
+    symbol_table->externs = new_ref;
+    return 1;
+}
+
+const ExternReference *get_extern_references(const SymbolTable *symbol_table) {
+    return symbol_table->externs;
+}
+
+/* Place a symbol into the first free slot of its probe sequence */
+static void insert_slot(Symbol **slots, int capacity, Symbol *symbol) {
+    int mask = capacity - 1;
+    int i = (int)(symbol->hash & mask);
+
+    while (slots[i] != NULL) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = symbol;
 }
 
-const ExternReference *get_extern_references(void) {
-    return extern_references;
+/* Double the hash index, keeping the load factor at or below one half */
+static int grow_slots(SymbolTable *symbol_table) {
+    int new_capacity = symbol_table->capacity ? symbol_table->capacity * 2 : 64;
+    Symbol **new_slots = calloc(new_capacity, sizeof(Symbol *));
+    Symbol *current;
+
+    if (new_slots == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return 0;
+    }
+    for (current = symbol_table->head; current != NULL; current = current->next) {
+        insert_slot(new_slots, new_capacity, current);
+    }
+    free(symbol_table->slots);
+    symbol_table->slots = new_slots;
+    symbol_table->capacity = new_capacity;
+    return 1;
 }
 
-int count_data_symbols(const Symbol *symbol_table) {
+void init_symbol_table(SymbolTable *symbol_table, Arena *arena) {
+    symbol_table->head = NULL;
+    symbol_table->last = NULL;
+    symbol_table->slots = NULL;
+    symbol_table->capacity = 0;
+    symbol_table->count = 0;
+    symbol_table->externs = NULL;
+    symbol_table->arena = arena;
+}
+
+int count_data_symbols(const SymbolTable *symbol_table) {
     int count = 0;
-    while (symbol_table) {
-        if (symbol_table->is_data_line) {
+    const Symbol *current = symbol_table->head;
+    while (current) {
+        if (current->is_data_line) {
             count++;
         }
-        symbol_table = symbol_table->next;
+        current = current->next;
     }
     return count;
 }
 
-int add_symbol(Symbol **symbol_table, const char *name, int address, SymbolType type, int is_data_line, int line) {
+int add_symbol(SymbolTable *symbol_table, const char *name, int address, SymbolType type, int is_data_line, int line) {
     Symbol *existing_symbol;
     Symbol *new_symbol;
+    const char *start;
+    int length;
 
-    existing_symbol = find_symbol(name, *symbol_table);
+    existing_symbol = find_symbol(name, symbol_table);
     if (existing_symbol != NULL) {
         if (existing_symbol->type == SYMBOL_EXTERN && type == SYMBOL_ENTRY) {
             existing_symbol->type = SYMBOL_ENTRY;
@@ -50,70 +94,81 @@ int add_symbol(Symbol **symbol_table, const char *name, int address, SymbolType
         return 0;
     }
 
-    
+    if ((symbol_table->count + 1) * 2 > symbol_table->capacity && !grow_slots(symbol_table)) {
+        return 0;
+    }
 
-    new_symbol = malloc(sizeof(Symbol));
+    new_symbol = arena_alloc(symbol_table->arena, sizeof(Symbol));
     if (new_symbol == NULL) {
-        report_error(ERR_MEMORY_ALLOCATION, 0);
         return 0;
     }
-    new_symbol->name = my_strdup(name);
+
+    /* Store the trimmed name so lookups never have to clean it again */
+    start = trim_span(name, &length);
+    new_symbol->name = arena_strndup(symbol_table->arena, start, length);
+    if (new_symbol->name == NULL) {
+        return 0;
+    }
+
     new_symbol->address = address;
     new_symbol->type = type;
     new_symbol->is_data_line = is_data_line;
     new_symbol->line = line;
-    new_symbol->next = *symbol_table;
-    *symbol_table = new_symbol;
+    new_symbol->data = NULL;
+    new_symbol->hash = hash_name(start, length);
+    new_symbol->next = NULL;
+
+    /* Append to keep definition order for the output files */
+    if (symbol_table->last) {
+        symbol_table->last->next = new_symbol;
+    } else {
+        symbol_table->head = new_symbol;
+    }
+    symbol_table->last = new_symbol;
+    symbol_table->count++;
+    insert_slot(symbol_table->slots, symbol_table->capacity, new_symbol);
 
     return 1;
 }
 
-Symbol *find_symbol(const char *name, Symbol *symbol_table) {
-    char cleaned_symbol[MAX_LABEL_LEN + 1];
-    Symbol *current;
-    Symbol *found = NULL;
-    char cleaned_current[MAX_LABEL_LEN + 1];
+Symbol *find_symbol(const char *name, const SymbolTable *symbol_table) {
+    const char *start;
+    unsigned long hash;
+    int length;
+    int mask;
+    int i;
 
-    strncpy(cleaned_symbol, name, MAX_LABEL_LEN);
-    cleaned_symbol[MAX_LABEL_LEN] = '\0';
-    trim_whitespace(cleaned_symbol);
+    if (symbol_table->count == 0) {
+        return NULL;
+    }
 
-    current = symbol_table;
-    while (current != NULL) {
-        strncpy(cleaned_current, current->name, MAX_LABEL_LEN);
-        cleaned_current[MAX_LABEL_LEN] = '\0';
-        trim_whitespace(cleaned_current);
-        if (strcmp(cleaned_current, cleaned_symbol) == 0) {
-            found = current;
-            break;
+    start = trim_span(name, &length);
+    hash = hash_name(start, length);
+    mask = symbol_table->capacity - 1;
+
+    /* Probe until the symbol or an empty slot is found */
+    for (i = (int)(hash & mask); symbol_table->slots[i] != NULL; i = (i + 1) & mask) {
+        Symbol *current = symbol_table->slots[i];
+        if (current->hash == hash && strncmp(current->name, start, length) == 0 && current->name[length] == '\0') {
+            return current;
         }
-        current = current->next;
     }
 
-    if (found) {
-        return found;
-    } else {
-        return NULL;
-    }
+    return NULL;
 }
 
-void free_symbol_table(Symbol *symbol_table) {
-    Symbol *current = symbol_table;
-    while (current != NULL) {
-        Symbol *next = current->next;
-        free(current->name);
-        free(current);
-        current = next;
-    }
+void free_symbol_table(SymbolTable *symbol_table) {
+    free(symbol_table->slots);
+    init_symbol_table(symbol_table, symbol_table->arena);
 }
 
-void print_symbol_table(Symbol *symbol_table) {
-    Symbol *current = symbol_table;
-    printf("Full Symbol Table:\n");
+void print_symbol_table(const SymbolTable *symbol_table) {
+    const Symbol *current = symbol_table->head;
+    report_message(stdout, "Full Symbol Table:\n");
     while (current != NULL) {
-        printf("  Name: %s, Address: %d, Type: %d, Is Data: %d, Line: %d\n",
+        report_message(stdout, "  Name: %s, Address: %d, Type: %d, Is Data: %d, Line: %d\n",
                current->name, current->address, current->type, current->is_data_line, current->line);
         current = current->next;
     }
-    printf("End of Symbol Table\n");
+    report_message(stdout, "End of Symbol Table\n");
 }
@@ -0,0 +1,233 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/*
+ * @struct TraceTrack
+ * A track of the trace; written as a thread of the trace-event format,
+ * with its group as the process.
+ */
+typedef struct TraceTrack {
+    int group;                       /* Group (worker) of the track */
+    int id;                          /* Track number, unique in the trace */
+    char *group_name;                /* New name of the group, or NULL */
+    char *name;                      /* Name of the track */
+    struct TraceTrack *next;         /* Previously created track */
+} TraceTrack;
+
+/*
+ * @struct TraceEvent
+ * One recorded span.
+ */
+typedef struct {
+    const char *name;                /* Name of the span */
+    double start;                    /* Start in microseconds since tracing started */
+    double duration;                 /* Length in microseconds */
+    int group;                       /* Group of the track it was recorded on */
+    int track;                       /* Track it was recorded on */
+} TraceEvent;
+
+/* Set between start_trace and write_trace; only changed while no workers run */
+static int tracing = 0;
+static struct timespec origin;
+
+/* Recorded spans and tracks, guarded by trace_lock */
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceEvent *events = NULL;
+static int event_count = 0;
+static int event_capacity = 0;
+static TraceTrack *tracks = NULL;
+static int track_count = 0;
+
+/* Current track of each thread; unset means the default track */
+static pthread_key_t track_key;
+static pthread_once_t track_once = PTHREAD_ONCE_INIT;
+
+static void create_track_key(void) {
+    pthread_key_create(&track_key, NULL);
+}
+
+/* Copy a name for the trace; NULL stays NULL */
+static char *copy_name(const char *name) {
+    char *copy;
+
+    if (name == NULL) {
+        return NULL;
+    }
+    copy = malloc(strlen(name) + 1);
+    if (copy != NULL) {
+        strcpy(copy, name);
+    }
+    return copy;
+}
+
+int start_trace(void) {
+    if (tracing) {
+        return 0;
+    }
+    pthread_once(&track_once, create_track_key);
+    clock_gettime(CLOCK_MONOTONIC, &origin);
+    tracing = 1;
+    return 1;
+}
+
+void enter_trace_track(int group, const char *group_name, const char *track_name) {
+    TraceTrack *track;
+
+    if (!tracing) {
+        return;
+    }
+    track = malloc(sizeof(TraceTrack));
+    if (track == NULL) {
+        return;
+    }
+    track->group = group;
+    track->group_name = copy_name(group_name);
+    track->name = copy_name(track_name);
+
+    pthread_mutex_lock(&trace_lock);
+    track->id = ++track_count;
+    track->next = tracks;
+    tracks = track;
+    pthread_mutex_unlock(&trace_lock);
+
+    pthread_setspecific(track_key, track);
+}
+
+int current_trace_group(void) {
+    TraceTrack *track;
+
+    if (!tracing) {
+        return 0;
+    }
+    track = pthread_getspecific(track_key);
+    return track != NULL ? track->group : 0;
+}
+
+double trace_clock(void) {
+    struct timespec now;
+
+    if (!tracing) {
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - origin.tv_sec) * 1e6 + (now.tv_nsec - origin.tv_nsec) / 1e3;
+}
+
+void trace_span(const char *name, double started) {
+    TraceTrack *track;
+    double ended;
+
+    if (!tracing) {
+        return;
+    }
+    ended = trace_clock();
+    track = pthread_getspecific(track_key);
+
+    pthread_mutex_lock(&trace_lock);
+    if (event_count == event_capacity) {
+        int new_capacity = event_capacity ? event_capacity * 2 : 256;
+        TraceEvent *new_events = realloc(events, sizeof(TraceEvent) * new_capacity);
+        if (new_events == NULL) {
+            /* The trace loses this span; assembly goes on */
+            pthread_mutex_unlock(&trace_lock);
+            return;
+        }
+        events = new_events;
+        event_capacity = new_capacity;
+    }
+    events[event_count].name = name;
+    events[event_count].start = started;
+    events[event_count].duration = ended - started;
+    events[event_count].group = track != NULL ? track->group : 0;
+    events[event_count].track = track != NULL ? track->id : 0;
+    event_count++;
+    pthread_mutex_unlock(&trace_lock);
+}
+
+/* Write a string as a JSON string literal */
+static void write_json_string(FILE *file, const char *text) {
+    putc('"', file);
+    for (; *text != '\0'; text++) {
+        unsigned char c = (unsigned char)*text;
+        if (c == '"' || c == '\\') {
+            putc('\\', file);
+            putc(c, file);
+        } else if (c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            putc(c, file);
+        }
+    }
+    putc('"', file);
+}
+
+/* Write the name of a group or track as a metadata event */
+static void write_name(FILE *file, const char *kind, int group, int track, const char *name, int *first) {
+    fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+            *first ? "" : ",", kind, group, track);
+    write_json_string(file, name);
+    fputs("}}", file);
+    *first = 0;
+}
+
+/* Release the recorded spans and tracks */
+static void clear_trace(void) {
+    while (tracks != NULL) {
+        TraceTrack *next = tracks->next;
+        free(tracks->group_name);
+        free(tracks->name);
+        free(tracks);
+        tracks = next;
+    }
+    free(events);
+    events = NULL;
+    event_count = 0;
+    event_capacity = 0;
+    track_count = 0;
+    pthread_setspecific(track_key, NULL);
+}
+
+int write_trace(const char *filename) {
+    FILE *file;
+    const TraceTrack *track;
+    int first = 1;
+    int i;
+
+    if (!tracing) {
+        return 0;
+    }
+    tracing = 0;
+
+    file = fopen(filename, "w");
+    if (file == NULL) {
+        clear_trace();
+        return 0;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+    for (track = tracks; track != NULL; track = track->next) {
+        if (track->group_name != NULL) {
+            write_name(file, "process_name", track->group, track->id, track->group_name, &first);
+        }
+        if (track->name != NULL) {
+            write_name(file, "thread_name", track->group, track->id, track->name, &first);
+        }
+    }
+    for (i = 0; i < event_count; i++) {
+        fprintf(file, "%s\n{\"name\":", first ? "" : ",");
+        write_json_string(file, events[i].name);
+        fprintf(file, ",\"cat\":\"assembler\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                events[i].start, events[i].duration, events[i].group, events[i].track);
+        first = 0;
+    }
+    fputs("\n]}\n", file);
+
+    clear_trace();
+    return fclose(file) == 0;
+}
@@ -1,8 +1,9 @@
 #include "utils.h"
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include "common.h"
-#include "line_parser.h"
+#include "keywords.h"
 
 /* Add the given file extension to the filename */
 char* add_file_extension(const char *filename, const char *extension) {
@@ -33,15 +34,8 @@ char* add_file_extension(const char *filename, const char *extension) {
 
 /* Check if the given name is an opcode */
 int check_if_opcode(const char *name) {
-    unsigned int i;
-
-    /* Iterate over the opcode array and compare names */
-    for (i = 0; i < OP_CODE_ARRAY_SIZE; i++) {
-        if (strcmp(name, OPCODES[i].name) == 0) {
-            return 1;
-        }
-    }
-    return 0;
+    const Keyword *keyword = lookup_keyword(name, strlen(name));
+    return keyword != NULL && keyword->opcode >= 0;
 }
 
 /* Remove the extension from the given filename */
@@ -101,3 +95,28 @@ char* my_strdup(const char* str) {
     return copy;
 }
 
+const char *trim_span(const char *text, int *length) {
+    const char *end;
+
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) {
+        end--;
+    }
+    *length = end - text;
+    return text;
+}
+
+/* FNV-1a */
+unsigned long hash_name(const char *name, int length) {
+    unsigned long hash = 2166136261UL;
+    int i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
@@ -0,0 +1,576 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "object_file.h"
+#include "symbol_table.h"
+#include "line_parser.h"
+#include "arena.h"
+#include "common.h"
+#include "error_handling.h"
+#include "instruction_table.h"
+
+/*
+ * Disassembler: turns an assembled program back into source.
+ * The instruction words are decoded in one pass, in address order: the mode
+ * fields of each first word select the operand kinds from MODES, and the
+ * form in INSTRUCTION_FORMS tells whether the opcode accepts them and how
+ * many words the instruction takes; every address an operand
+ * refers to is marked for a label. The source is then printed: .extern
+ * lines, the instructions, the data (as .string where it reads as one) and
+ * the .entry lines. Labels are the entry names where there are entries, and
+ * L<address> (code) or D<address> (data) otherwise; extern operands use the
+ * names in the .ext file. Assembling the output gives back the same words.
+ * Usage: disassembler [-o FILE] <module>
+ * The module is a .ob file (with its .ent and .ext), its base name, or a .obj file.
+ */
+
+/* Address the assembler places the first word at */
+#define LOAD_BASE 100
+
+/* Fields of an instruction word */
+#define OPCODE_SHIFT 11
+#define SOURCE_MODE_SHIFT 7
+#define TARGET_MODE_SHIFT 3
+#define FIELD_MASK 0xF
+
+/* ARE field of a word */
+#define ARE_MASK 0x7
+#define ARE_ABSOLUTE 0x4
+#define ARE_RELOCATABLE 0x2
+#define ARE_EXTERNAL 0x1
+
+/* Value fields of operand words */
+#define VALUE_SHIFT 3
+#define IMMEDIATE_MASK 0xFFF
+#define IMMEDIATE_SIGN 0x800
+#define ADDRESS_MASK 0xFFF
+#define SOURCE_REGISTER_SHIFT 6
+#define TARGET_REGISTER_SHIFT 3
+#define REGISTER_MASK 0x7
+
+/* Data words are 15-bit two's complement */
+#define WORD_SIGN 0x4000
+
+/* Widest output line: MAX_LINE_LENGTH holds the line break and the terminator */
+#define LINE_WIDTH (MAX_LINE_LENGTH - 2)
+
+/* Characters of a .string line besides the label and the string: .string "" */
+#define STRING_OVERHEAD 10
+
+/* Widest data value after the first: ", -16384" */
+#define DATA_VALUE_WIDTH 8
+
+/* Kinds of operands */
+typedef enum {
+    KIND_NONE,         /* No operand */
+    KIND_INVALID,      /* A mode field that no operand encodes to */
+    KIND_IMMEDIATE,    /* #value */
+    KIND_DIRECT,       /* label */
+    KIND_INDIRECT,     /* *register */
+    KIND_REGISTER      /* register */
+} OperandKind;
+
+/*
+ * Addressing modes indexed by the mode field of an instruction word:
+ * the kind of operand, and its slot in INSTRUCTION_FORMS (-1 for a field
+ * that no operand encodes to).
+ */
+static const struct {
+    OperandKind kind;
+    int slot;
+} MODES[FIELD_MASK + 1] = {
+    {KIND_NONE, OPERAND_SLOT_NONE}, {KIND_IMMEDIATE, 1}, {KIND_DIRECT, 2}, {KIND_INVALID, -1},
+    {KIND_INDIRECT, 3}, {KIND_INVALID, -1}, {KIND_INVALID, -1}, {KIND_INVALID, -1},
+    {KIND_REGISTER, 4}, {KIND_INVALID, -1}, {KIND_INVALID, -1}, {KIND_INVALID, -1},
+    {KIND_INVALID, -1}, {KIND_INVALID, -1}, {KIND_INVALID, -1}, {KIND_INVALID, -1}
+};
+
+/*
+ * @struct DecodedOperand
+ * One operand of a decoded instruction.
+ */
+typedef struct {
+    OperandKind kind;          /* How the operand is written */
+    int value;                 /* Immediate value, register, or offset of the target word */
+    const char *external;      /* Extern the operand refers to, for an external direct operand */
+} DecodedOperand;
+
+/*
+ * @struct DecodedLine
+ * A decoded instruction, or a code word that does not decode.
+ */
+typedef struct {
+    int offset;                /* Offset of the first word in the image */
+    int length;                /* Number of words */
+    int opcode;                /* Opcode, or -1 for a word that is not an instruction */
+    DecodedOperand source;     /* Source operand */
+    DecodedOperand target;     /* Target operand */
+} DecodedLine;
+
+/*
+ * @struct WordInfo
+ * What the disassembler knows about one word of the image.
+ */
+typedef struct {
+    const char *entry;         /* Name of the entry at this address, or NULL */
+    const char *external;      /* Extern the word references, from the .ext file, or NULL */
+    int owner;                 /* Offset of the first word of its instruction */
+    int labelled;              /* An operand refers to this word */
+} WordInfo;
+
+/*
+ * @struct Disassembly
+ * State of one disassembly.
+ */
+typedef struct {
+    const ObjectModule *module;
+    WordInfo *words;           /* One per word of the image */
+    DecodedLine *lines;        /* Decoded instructions, in address order */
+    int line_count;            /* Number of decoded instructions */
+    SymbolTable externs;       /* Extern names, in order of first use */
+    Arena arena;               /* Owns the extern table and synthesized names */
+    int warnings;              /* Problems that keep the output from reassembling to the same words */
+} Disassembly;
+
+/* Sign-extend a field of the given sign bit */
+static int sign_extend(int value, int sign) {
+    return (value & sign) ? value - 2 * sign : value;
+}
+
+/* Name an extern used by an operand word, making up one if the .ext file has none */
+static const char *extern_name(Disassembly *disassembly, int offset) {
+    char name[MAX_LABEL_LEN + 1];
+    const char *external = disassembly->words[offset].external;
+
+    if (external == NULL) {
+        sprintf(name, "X%04d", disassembly->module->base + offset);
+        external = arena_strndup(&disassembly->arena, name, (int)strlen(name));
+        report_message(stderr, "Warning: External word at %04d is not listed in the .ext file, naming it %s\n",
+                       disassembly->module->base + offset, name);
+        disassembly->warnings++;
+    }
+    if (external != NULL && find_symbol(external, &disassembly->externs) == NULL &&
+        !add_symbol(&disassembly->externs, external, 0, SYMBOL_EXTERN, 0, 0)) {
+        return NULL;
+    }
+    return external;
+}
+
+/*
+ * Decode one operand word.
+ * Returns 1 if the word encodes an operand of its kind, 0 if it does not,
+ * -1 if allocation failed.
+ */
+static int decode_operand(Disassembly *disassembly, int offset, int register_shift, DecodedOperand *operand) {
+    const ObjectModule *module = disassembly->module;
+    unsigned short word = module->words[offset];
+    int total = module->instruction_count + module->data_count;
+    int address;
+
+    switch (operand->kind) {
+        case KIND_IMMEDIATE:
+            operand->value = sign_extend((word >> VALUE_SHIFT) & IMMEDIATE_MASK, IMMEDIATE_SIGN);
+            return (word & ARE_MASK) == ARE_ABSOLUTE;
+        case KIND_DIRECT:
+            if ((word & ARE_MASK) == ARE_EXTERNAL) {
+                operand->external = extern_name(disassembly, offset);
+                return operand->external != NULL ? 1 : -1;
+            }
+            address = (word >> VALUE_SHIFT) & ADDRESS_MASK;
+            operand->value = address - module->base;
+            if ((word & ARE_MASK) != ARE_RELOCATABLE || operand->value < 0 || operand->value >= total) {
+                return 0;
+            }
+            disassembly->words[operand->value].labelled = 1;
+            return 1;
+        default:
+            operand->value = (word >> register_shift) & REGISTER_MASK;
+            return 1;
+    }
+}
+
+/*
+ * Decode the instruction that starts at an offset into a line; a word that
+ * does not decode becomes a line of one word with opcode -1.
+ * Returns 1 on success, 0 if allocation failed.
+ */
+static int decode_line(Disassembly *disassembly, int offset, DecodedLine *line) {
+    const ObjectModule *module = disassembly->module;
+    unsigned short word = module->words[offset];
+    int opcode = (word >> OPCODE_SHIFT) & FIELD_MASK;
+    int source_field = (word >> SOURCE_MODE_SHIFT) & FIELD_MASK;
+    int target_field = (word >> TARGET_MODE_SHIFT) & FIELD_MASK;
+    const InstructionForm *form = NULL;
+    int next = offset + 1;
+    int valid;
+
+    line->offset = offset;
+    line->length = 1;
+    line->opcode = -1;
+    line->source.kind = MODES[source_field].kind;
+    line->source.external = NULL;
+    line->target.kind = MODES[target_field].kind;
+    line->target.external = NULL;
+
+    /* The opcode must accept the form, as the assembler would; a single operand is encoded as the target */
+    if (MODES[source_field].slot >= 0 && MODES[target_field].slot >= 0) {
+        form = &INSTRUCTION_FORMS[opcode][MODES[source_field].slot][MODES[target_field].slot];
+    }
+    valid = (word & ARE_MASK) == ARE_ABSOLUTE && form != NULL && form->legal &&
+            offset + form->word_count <= module->instruction_count;
+
+    if (valid && line->source.kind != KIND_NONE) {
+        valid = decode_operand(disassembly, next, SOURCE_REGISTER_SHIFT, &line->source);
+        /* Two register operands share one word */
+        if (form->word_count == MAX_INSTRUCTION_WORDS) {
+            next++;
+        }
+    }
+    if (valid > 0 && line->target.kind != KIND_NONE) {
+        valid = decode_operand(disassembly, next, TARGET_REGISTER_SHIFT, &line->target);
+    }
+    if (valid < 0) {
+        return 0;
+    }
+    if (valid) {
+        line->opcode = opcode;
+        line->length = form->word_count;
+    }
+    return 1;
+}
+
+/* Decode every instruction word in one pass over the code */
+static int decode_code(Disassembly *disassembly) {
+    int offset = 0;
+    int i;
+
+    while (offset < disassembly->module->instruction_count) {
+        DecodedLine *line = &disassembly->lines[disassembly->line_count++];
+
+        if (!decode_line(disassembly, offset, line)) {
+            return 0;
+        }
+        if (line->opcode < 0) {
+            report_message(stderr, "Warning: Word at %04d is not an instruction; it is written as .data\n",
+                           disassembly->module->base + offset);
+            disassembly->warnings++;
+        }
+        for (i = 0; i < line->length; i++) {
+            disassembly->words[offset + i].owner = offset;
+        }
+        offset += line->length;
+    }
+    return 1;
+}
+
+/* Write the label of a word into a buffer (at least MAX_LABEL_LEN + 1 characters) */
+static const char *label_of(const Disassembly *disassembly, int offset, char *buffer) {
+    const WordInfo *word = &disassembly->words[offset];
+
+    if (word->entry != NULL) {
+        return word->entry;
+    }
+    sprintf(buffer, "%c%04d", offset < disassembly->module->instruction_count ? 'L' : 'D',
+            disassembly->module->base + offset);
+    return buffer;
+}
+
+/* Check that a word starts a line of its own: an entry, or the target of a reference */
+static int needs_label(const Disassembly *disassembly, int offset) {
+    return disassembly->words[offset].labelled || disassembly->words[offset].entry != NULL;
+}
+
+/* Print the label of a word if it needs one, followed by a tab; returns the width printed */
+static int print_label(FILE *out, const Disassembly *disassembly, int offset) {
+    char buffer[MAX_LABEL_LEN + 1];
+    int width = 0;
+
+    if (needs_label(disassembly, offset)) {
+        width = fprintf(out, "%s:", label_of(disassembly, offset, buffer));
+    }
+    putc('\t', out);
+    return width + 1;
+}
+
+/* Print one operand as the assembler reads it */
+static void print_operand(FILE *out, const Disassembly *disassembly, const DecodedOperand *operand) {
+    char buffer[MAX_LABEL_LEN + 1];
+
+    switch (operand->kind) {
+        case KIND_IMMEDIATE:
+            fprintf(out, "#%d", operand->value);
+            break;
+        case KIND_DIRECT:
+            fputs(operand->external != NULL ? operand->external
+                                            : label_of(disassembly, disassembly->words[operand->value].owner, buffer),
+                  out);
+            break;
+        case KIND_INDIRECT:
+            fprintf(out, "*r%d", operand->value);
+            break;
+        case KIND_REGISTER:
+            fprintf(out, "r%d", operand->value);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Print a decoded instruction line */
+static void print_instruction(FILE *out, const Disassembly *disassembly, const DecodedLine *line) {
+    print_label(out, disassembly, line->offset);
+    if (line->opcode < 0) {
+        fprintf(out, ".data %d\n", sign_extend(disassembly->module->words[line->offset], WORD_SIGN));
+        return;
+    }
+    fputs(OPCODES[line->opcode].name, out);
+    if (line->source.kind != KIND_NONE) {
+        putc(' ', out);
+        print_operand(out, disassembly, &line->source);
+        putc(',', out);
+    }
+    if (line->target.kind != KIND_NONE) {
+        putc(' ', out);
+        print_operand(out, disassembly, &line->target);
+    }
+    putc('\n', out);
+}
+
+/* Check that a data word can be a character of a .string line */
+static int is_string_character(unsigned short word) {
+    return word >= ' ' && word <= '~' && word != '"' && word != ';';
+}
+
+/*
+ * Length of the string starting at a data offset: printable characters up to
+ * a terminating zero, with no label inside, and at most room characters.
+ * Returns 0 if there is none.
+ */
+static int string_length(const Disassembly *disassembly, int offset, int end, int room) {
+    int length = 0;
+
+    while (offset + length < end && is_string_character(disassembly->module->words[offset + length]) &&
+           (length == 0 || !needs_label(disassembly, offset + length))) {
+        length++;
+    }
+    if (length == 0 || length > room || offset + length == end || disassembly->module->words[offset + length] != 0 ||
+        needs_label(disassembly, offset + length)) {
+        return 0;
+    }
+    return length;
+}
+
+/* Print data lines from an offset until one reaches a stop offset, starting a line at every label */
+static void print_data(FILE *out, const Disassembly *disassembly, int *next, int stop) {
+    const ObjectModule *module = disassembly->module;
+    int end = module->instruction_count + module->data_count;
+    int offset = *next;
+
+    while (offset < stop) {
+        int width = print_label(out, disassembly, offset);
+        int length = string_length(disassembly, offset, end, LINE_WIDTH - width - STRING_OVERHEAD);
+
+        if (length > 0) {
+            fprintf(out, ".string \"");
+            for (; length > 0; length--) {
+                putc(module->words[offset++], out);
+            }
+            fprintf(out, "\"\n");
+            offset++;
+            continue;
+        }
+
+        /* Values up to the next label or string, as many as fit on the line */
+        width += fprintf(out, ".data %d", sign_extend(module->words[offset++], WORD_SIGN));
+        while (offset < end && width <= LINE_WIDTH - DATA_VALUE_WIDTH && !needs_label(disassembly, offset) &&
+               string_length(disassembly, offset, end, LINE_WIDTH - STRING_OVERHEAD - 1) == 0) {
+            width += fprintf(out, ", %d", sign_extend(module->words[offset++], WORD_SIGN));
+        }
+        putc('\n', out);
+    }
+    *next = offset;
+}
+
+/*
+ * Print the whole program. Code and data lines are interleaved so the labels
+ * of the entries are defined in the order of the .ent file, which is the
+ * order the assembler lists them in.
+ */
+static void print_source(FILE *out, const Disassembly *disassembly) {
+    const ObjectModule *module = disassembly->module;
+    int total = module->instruction_count + module->data_count;
+    const Symbol *symbol;
+    int line = 0;
+    int data = module->instruction_count;
+    int i;
+
+    fprintf(out, "; Disassembled: %d instruction words and %d data words at %04d\n",
+            module->instruction_count, module->data_count, module->base);
+    for (symbol = disassembly->externs.head; symbol != NULL; symbol = symbol->next) {
+        fprintf(out, ".extern %s\n", symbol->name);
+    }
+    for (i = 0; i < module->entry_count; i++) {
+        int offset = module->entries[i].address - module->base;
+
+        if (offset < 0 || offset >= total || disassembly->words[offset].entry != module->entries[i].name) {
+            continue;
+        }
+        if (offset < module->instruction_count) {
+            while (line < disassembly->line_count && disassembly->lines[line].offset <= offset) {
+                print_instruction(out, disassembly, &disassembly->lines[line++]);
+            }
+        } else {
+            print_data(out, disassembly, &data, offset + 1);
+        }
+    }
+    while (line < disassembly->line_count) {
+        print_instruction(out, disassembly, &disassembly->lines[line++]);
+    }
+    print_data(out, disassembly, &data, total);
+
+    for (i = 0; i < module->entry_count; i++) {
+        int offset = module->entries[i].address - module->base;
+
+        if (offset >= 0 && offset < total && disassembly->words[offset].entry == module->entries[i].name) {
+            fprintf(out, ".entry %s\n", module->entries[i].name);
+        }
+    }
+}
+
+/* Attach the entries and extern references to their words */
+static void attach_symbols(Disassembly *disassembly) {
+    const ObjectModule *module = disassembly->module;
+    int total = module->instruction_count + module->data_count;
+    int i;
+
+    for (i = 0; i < module->entry_count; i++) {
+        int offset = module->entries[i].address - module->base;
+
+        if (offset < 0 || offset >= total || disassembly->words[offset].entry != NULL) {
+            report_message(stderr, "Warning: Entry %s at %04d does not name a word of its own; it is left out\n",
+                           module->entries[i].name, module->entries[i].address);
+            disassembly->warnings++;
+        } else {
+            disassembly->words[offset].entry = module->entries[i].name;
+        }
+    }
+    for (i = 0; i < module->extern_count; i++) {
+        int offset = module->externs[i].address - module->base;
+
+        if (offset >= 0 && offset < module->instruction_count) {
+            disassembly->words[offset].external = module->externs[i].name;
+        }
+    }
+}
+
+/*
+ * Labels can only be defined at the start of an instruction: references into
+ * the middle of one are written as references to the instruction, and
+ * entries there are left out.
+ */
+static void check_labels(Disassembly *disassembly) {
+    int i;
+
+    for (i = 0; i < disassembly->module->instruction_count; i++) {
+        WordInfo *word = &disassembly->words[i];
+
+        if (word->entry != NULL && word->owner != i) {
+            report_message(stderr, "Warning: Entry %s at %04d is inside the instruction at %04d; it is left out\n",
+                           word->entry, disassembly->module->base + i, disassembly->module->base + word->owner);
+            word->entry = NULL;
+            disassembly->warnings++;
+        }
+        if (word->labelled && word->owner != i) {
+            report_message(stderr, "Warning: Reference to %04d, inside the instruction at %04d, is written as a "
+                           "reference to the instruction\n", disassembly->module->base + i,
+                           disassembly->module->base + word->owner);
+            disassembly->words[word->owner].labelled = 1;
+            disassembly->warnings++;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = NULL;
+    const char *module_name = NULL;
+    Disassembly disassembly;
+    ObjectModule module;
+    FILE *out = stdout;
+    int total;
+    int status;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (module_name == NULL) {
+            module_name = argv[i];
+        } else {
+            module_name = NULL;
+            break;
+        }
+    }
+    if (module_name == NULL) {
+        printf("Usage: %s [-o FILE] <module>\n", argv[0]);
+        return 1;
+    }
+
+    status = load_object_module(module_name, &module);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    if (module.base != LOAD_BASE) {
+        report_message(stderr, "Warning: The program starts at %04d; the assembler places it at %04d\n",
+                       module.base, LOAD_BASE);
+    }
+
+    total = module.instruction_count + module.data_count;
+    disassembly.module = &module;
+    disassembly.words = calloc(total + 1, sizeof(WordInfo));
+    disassembly.lines = malloc(sizeof(DecodedLine) * (module.instruction_count + 1));
+    disassembly.line_count = 0;
+    disassembly.warnings = 0;
+    init_arena(&disassembly.arena);
+    init_symbol_table(&disassembly.externs, &disassembly.arena);
+
+    if (disassembly.words == NULL || disassembly.lines == NULL) {
+        status = ERR_MEMORY_ALLOCATION;
+    } else {
+        for (i = 0; i < total; i++) {
+            disassembly.words[i].owner = i;
+        }
+        attach_symbols(&disassembly);
+        if (!decode_code(&disassembly)) {
+            status = ERR_MEMORY_ALLOCATION;
+        }
+    }
+    if (status == ERR_MEMORY_ALLOCATION) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+    }
+
+    if (status == NO_ERROR && output != NULL) {
+        out = fopen(output, "w");
+        if (out == NULL) {
+            report_message(stderr, "Error opening file %s for writing\n", output);
+            status = ERR_FILE_ACCESS;
+        }
+    }
+    if (status == NO_ERROR) {
+        check_labels(&disassembly);
+        print_source(out, &disassembly);
+        if (out != stdout && fclose(out) != 0) {
+            report_message(stderr, "Error writing file %s\n", output);
+            status = ERR_FILE_ACCESS;
+        }
+        if (disassembly.warnings > 0) {
+            fprintf(stderr, "%d warnings: the source may not reassemble to the same words\n", disassembly.warnings);
+        }
+    }
+
+    free_symbol_table(&disassembly.externs);
+    free_arena(&disassembly.arena);
+    free(disassembly.words);
+    free(disassembly.lines);
+    free_object_module(&module);
+    return status;
+}
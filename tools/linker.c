@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "object_file.h"
+#include "binary_table.h"
+#include "symbol_table.h"
+#include "second_pass.h"
+#include "arena.h"
+#include "utils.h"
+#include "common.h"
+#include "error_handling.h"
+
+/*
+ * Linker: merges assembled modules into one program.
+ * The instructions of every module come first, in the order given, then the
+ * data of every module in the same order, so the result keeps the layout of
+ * a .ob file. Relocatable words and entries move with their section, and
+ * every extern reference is patched with the address of the entry of that
+ * name. Unresolved and duplicate symbols are all reported before giving up.
+ * Writes NAME.ob and NAME.ent (and NAME.obj with --binary-object).
+ * Usage: linker [-o NAME] [--binary-object] <module>...
+ * A module is a .ob file (with its .ent and .ext), its base name, or a .obj file.
+ */
+
+/* Output name used when -o is not given */
+#define DEFAULT_OUTPUT "linked"
+
+/* ARE field of an operand word */
+#define ARE_MASK 0x7
+#define ARE_RELOCATABLE 0x2
+#define ARE_EXTERNAL 0x1
+
+/* Address field of a direct operand word */
+#define ADDRESS_MASK 0x1FFF
+#define ADDRESS_SHIFT 3
+
+/* Address of the first linked word */
+#define LINK_BASE 100
+
+/*
+ * @struct LinkModule
+ * A loaded module and where its sections go in the linked program.
+ */
+typedef struct {
+    const char *name;                /* The module as given on the command line */
+    ObjectModule object;             /* Its words and symbol lists */
+    int code_base;                   /* Linked address of its first instruction word */
+    int data_base;                   /* Linked address of its first data word */
+} LinkModule;
+
+/* Linked address of an address in a module, or -1 if it lies outside the module */
+static int relocate(const LinkModule *module, int address) {
+    int offset = address - module->object.base;
+
+    if (offset >= 0 && offset < module->object.instruction_count) {
+        return module->code_base + offset;
+    }
+    offset -= module->object.instruction_count;
+    if (offset >= 0 && offset < module->object.data_count) {
+        return module->data_base + offset;
+    }
+    return -1;
+}
+
+/* Copy a module's words into the linked image, moving relocatable addresses with their section */
+static int place_words(const LinkModule *module, unsigned short *words) {
+    const ObjectModule *object = &module->object;
+    int errors = 0;
+    int i;
+
+    for (i = 0; i < object->instruction_count; i++) {
+        unsigned short word = object->words[i];
+
+        if ((word & ARE_MASK) == ARE_RELOCATABLE) {
+            int target = relocate(module, (word >> ADDRESS_SHIFT) & ADDRESS_MASK);
+
+            if (target < 0) {
+                report_message(stderr, "Error: %s: word at %04d refers to %04d, outside the module\n",
+                               module->name, object->base + i, (word >> ADDRESS_SHIFT) & ADDRESS_MASK);
+                errors++;
+            } else {
+                word = (unsigned short)(((target & ADDRESS_MASK) << ADDRESS_SHIFT) | ARE_RELOCATABLE);
+            }
+        }
+        words[module->code_base - LINK_BASE + i] = word;
+    }
+    memcpy(&words[module->data_base - LINK_BASE], object->words + object->instruction_count,
+           sizeof(unsigned short) * object->data_count);
+    return errors;
+}
+
+/* Index the entries of every module by name; the symbol line records the module */
+static int index_entries(LinkModule *modules, int count, SymbolTable *entries) {
+    int errors = 0;
+    int m;
+    int i;
+
+    for (m = 0; m < count; m++) {
+        const ObjectModule *object = &modules[m].object;
+
+        for (i = 0; i < object->entry_count; i++) {
+            const AssembledSymbol *entry = &object->entries[i];
+            const Symbol *existing = find_symbol(entry->name, entries);
+            int address = relocate(&modules[m], entry->address);
+
+            if (existing != NULL) {
+                report_message(stderr, "Error: Duplicate entry %s in %s and %s\n",
+                               entry->name, modules[existing->line].name, modules[m].name);
+                errors++;
+            } else if (address < 0) {
+                report_message(stderr, "Error: %s: entry %s at %04d is outside the module\n",
+                               modules[m].name, entry->name, entry->address);
+                errors++;
+            } else if (!add_symbol(entries, entry->name, address, SYMBOL_ENTRY, 0, m)) {
+                return -1;
+            }
+        }
+    }
+    return errors;
+}
+
+/* Patch every extern reference with the address of its entry */
+static int resolve_externs(const LinkModule *modules, int count, const SymbolTable *entries, unsigned short *words) {
+    int errors = 0;
+    int m;
+    int i;
+
+    for (m = 0; m < count; m++) {
+        const ObjectModule *object = &modules[m].object;
+
+        for (i = 0; i < object->extern_count; i++) {
+            const AssembledSymbol *reference = &object->externs[i];
+            const Symbol *entry = find_symbol(reference->name, entries);
+            int at = relocate(&modules[m], reference->address);
+
+            if (at < 0 || at >= modules[m].code_base + object->instruction_count ||
+                (words[at - LINK_BASE] & ARE_MASK) != ARE_EXTERNAL) {
+                report_message(stderr, "Error: %s: reference to %s at %04d is not an external operand word\n",
+                               modules[m].name, reference->name, reference->address);
+                errors++;
+            } else if (entry == NULL) {
+                report_message(stderr, "Error: Unresolved symbol %s referenced by %s at %04d\n",
+                               reference->name, modules[m].name, reference->address);
+                errors++;
+            } else {
+                words[at - LINK_BASE] = (unsigned short)(((entry->address & ADDRESS_MASK) << ADDRESS_SHIFT) |
+                                                         ARE_RELOCATABLE);
+            }
+        }
+    }
+    return errors;
+}
+
+/* Write the linked program: NAME.ob, NAME.ent and, if asked for, NAME.obj */
+static int write_program(const char *output, const unsigned short *words, int instruction_count, int data_count,
+                         const SymbolTable *entries, int binary_object) {
+    BinaryTable table;
+    char *ob_filename = add_file_extension(output, ".ob");
+    char *obj_filename = add_file_extension(output, OBJECT_EXTENSION);
+    int ok;
+    int i;
+
+    ok = ob_filename != NULL && obj_filename != NULL && init_binary_table(&table);
+    for (i = 0; ok && i < instruction_count + data_count; i++) {
+        ok = add_binary_word(&table, LINK_BASE + i, words[i]);
+    }
+    if (ok) {
+        table.data = data_count;
+        ok = write_binary_table_to_file(&table, ob_filename, LINK_BASE, data_count) &&
+             write_entry_file(output, entries) &&
+             (!binary_object || write_object_file(&table, entries, obj_filename));
+        free_binary_table(&table);
+    }
+    free(ob_filename);
+    free(obj_filename);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = DEFAULT_OUTPUT;
+    LinkModule *modules = malloc(sizeof(LinkModule) * argc);
+    unsigned short *words = NULL;
+    SymbolTable entries;
+    Arena arena;
+    int binary_object = 0;
+    int instruction_count = 0;
+    int data_count = 0;
+    int count = 0;
+    int loaded = 0;
+    int errors = 0;
+    int status = NO_ERROR;
+    int i;
+
+    if (modules == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return ERR_MEMORY_ALLOCATION;
+    }
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--binary-object") == 0) {
+            binary_object = 1;
+        } else {
+            modules[count++].name = argv[i];
+        }
+    }
+    if (count == 0) {
+        printf("Usage: %s [-o NAME] [--binary-object] <module>...\n", argv[0]);
+        free(modules);
+        return 1;
+    }
+
+    /* Load every module and size the linked sections */
+    for (loaded = 0; loaded < count; loaded++) {
+        status = load_object_module(modules[loaded].name, &modules[loaded].object);
+        if (status != NO_ERROR) {
+            break;
+        }
+        instruction_count += modules[loaded].object.instruction_count;
+        data_count += modules[loaded].object.data_count;
+    }
+
+    if (status == NO_ERROR) {
+        int code_base = LINK_BASE;
+        int data_base = LINK_BASE + instruction_count;
+
+        /* Instructions of all modules first, then their data, in command line order */
+        for (i = 0; i < count; i++) {
+            modules[i].code_base = code_base;
+            modules[i].data_base = data_base;
+            code_base += modules[i].object.instruction_count;
+            data_base += modules[i].object.data_count;
+        }
+        if (data_base > MAX_MEMORY_WORDS) {
+            report_message(stderr, "Warning: The linked program ends at %d, past the %d-word memory\n",
+                           data_base, MAX_MEMORY_WORDS);
+        }
+        words = malloc(sizeof(unsigned short) * (instruction_count + data_count + 1));
+        if (words == NULL) {
+            report_error(ERR_MEMORY_ALLOCATION, 0);
+            status = ERR_MEMORY_ALLOCATION;
+        }
+    }
+
+    init_arena(&arena);
+    init_symbol_table(&entries, &arena);
+    if (status == NO_ERROR) {
+        errors = index_entries(modules, count, &entries);
+        if (errors < 0) {
+            report_error(ERR_MEMORY_ALLOCATION, 0);
+            status = ERR_MEMORY_ALLOCATION;
+        }
+    }
+    if (status == NO_ERROR) {
+        for (i = 0; i < count; i++) {
+            errors += place_words(&modules[i], words);
+        }
+        errors += resolve_externs(modules, count, &entries, words);
+        if (errors > 0) {
+            fprintf(stderr, "%d link errors, nothing written\n", errors);
+            status = ERR_PROCESSING_FAILED;
+        }
+    }
+    if (status == NO_ERROR && !write_program(output, words, instruction_count, data_count, &entries, binary_object)) {
+        status = ERR_FILE_ACCESS;
+    }
+
+    for (i = 0; i < loaded; i++) {
+        free_object_module(&modules[i].object);
+    }
+    free_symbol_table(&entries);
+    free_arena(&arena);
+    free(words);
+    free(modules);
+    return status;
+}
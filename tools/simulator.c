@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simulator.h"
+#include "object_file.h"
+#include "common.h"
+#include "error_handling.h"
+
+/*
+ * Simulator: runs an assembled program on the target machine.
+ * The program is loaded at its own addresses and starts at its first word;
+ * red reads characters from standard input and prn writes them to standard
+ * output. A program with extern references must be linked first.
+ * Usage: simulator [--max-steps=N] [--stats] <program>
+ * The program is a .ob file, its base name, or a .obj file.
+ * --max-steps stops a program that has not halted after N instructions;
+ * --stats prints the instruction count and the registers when it ends.
+ */
+
+/* Print the instruction count, the registers and the Z flag */
+static void print_state(const Machine *machine) {
+    int i;
+
+    fprintf(stderr, "%lu instructions executed\n", machine->steps);
+    for (i = 0; i < SIMULATOR_REGISTERS; i++) {
+        fprintf(stderr, "r%d=%05o%s", i, machine->registers[i], i + 1 < SIMULATOR_REGISTERS ? " " : "");
+    }
+    fprintf(stderr, " Z=%d\n", machine->zero);
+}
+
+int main(int argc, char *argv[]) {
+    const char *program_name = NULL;
+    unsigned long step_limit = 0;
+    ObjectModule program;
+    Machine *machine;
+    int stats = 0;
+    int status;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--max-steps=", 12) == 0) {
+            step_limit = strtoul(argv[i] + 12, NULL, 10);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = 1;
+        } else if (program_name == NULL) {
+            program_name = argv[i];
+        } else {
+            program_name = NULL;
+            break;
+        }
+    }
+    if (program_name == NULL) {
+        printf("Usage: %s [--max-steps=N] [--stats] <program>\n", argv[0]);
+        return 1;
+    }
+
+    machine = malloc(sizeof(Machine));
+    if (machine == NULL) {
+        report_error(ERR_MEMORY_ALLOCATION, 0);
+        return ERR_MEMORY_ALLOCATION;
+    }
+    status = load_object_module(program_name, &program);
+    if (status == NO_ERROR) {
+        status = load_machine(machine, &program, stdin, stdout);
+        free_object_module(&program);
+    }
+
+    if (status == NO_ERROR) {
+        switch (run_machine(machine, step_limit)) {
+            case SIMULATOR_FAULT:
+                fflush(stdout);
+                report_message(stderr, "Error: %s at %04d\n", machine->fault, machine->fault_address);
+                status = ERR_PROCESSING_FAILED;
+                break;
+            case SIMULATOR_STEP_LIMIT:
+                fflush(stdout);
+                report_message(stderr, "Error: No stop after %lu instructions, at %04d\n",
+                               machine->steps, machine->start);
+                status = ERR_PROCESSING_FAILED;
+                break;
+            default:
+                break;
+        }
+        fflush(stdout);
+        if (stats) {
+            print_state(machine);
+        }
+    }
+    free(machine);
+    return status;
+}